@@ -0,0 +1,362 @@
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "GraphMol/RWMol.h"
+#include "GraphMol/MolOps.h"
+#include "Backend.hpp"
+#include "InteractionCollection.hpp"
+#include "MoleculeContext.hpp"
+#include "Pipeline.hpp"
+#include "ScratchArena.hpp"
+#include "SparseMesh.hpp"
+#include "Transformer.hpp"
+
+/**
+ * An atom of the synthetic fragment: element, formal charge, aromaticity and position (in Angstrom)
+ */
+struct FragmentAtom {
+    int atomicNum;
+    int charge;
+    bool aromatic;
+    double x, y, z;
+};
+
+/**
+ * A bond of the synthetic fragment
+ */
+struct FragmentBond {
+    unsigned int begin, end;
+    RDKit::Bond::BondType type;
+};
+
+/**
+ * The synthetic fragment the benchmark molecules are tiled with: a zwitterionic 4-(aminomethyl)phenylacetate with
+ * explicit hydrogens and a zinc ion close to its carboxylate, so that every interaction of the collection has matches
+ * (hydrophobic carbons, acceptor and donor groups, ionic groups, metal and aromatic ring)
+ */
+static const FragmentAtom fragmentAtoms[] = {
+        {6,  0,  true,  1.390,  0.000,  0.000}, // 0-5: aromatic ring
+        {6,  0,  true,  0.695,  1.204,  0.000},
+        {6,  0,  true,  -0.695, 1.204,  0.000},
+        {6,  0,  true,  -1.390, 0.000,  0.000},
+        {6,  0,  true,  -0.695, -1.204, 0.000},
+        {6,  0,  true,  0.695,  -1.204, 0.000},
+        {6,  0,  false, 2.900,  0.000,  0.000}, // 6-7: aminomethyl
+        {7,  1,  false, 3.500,  1.380,  0.000},
+        {6,  0,  false, -2.900, 0.000,  0.000}, // 8-11: carboxymethyl
+        {6,  0,  false, -3.550, 1.370,  0.000},
+        {8,  0,  false, -2.920, 2.430,  0.000},
+        {8,  -1, false, -4.820, 1.320,  0.000},
+        {30, 2,  false, -5.100, 3.600,  0.000}, // 12: zinc ion
+        {1,  0,  false, 1.235,  2.139,  0.000}, // 13-23: hydrogens
+        {1,  0,  false, -1.235, 2.139,  0.000},
+        {1,  0,  false, -1.235, -2.139, 0.000},
+        {1,  0,  false, 1.235,  -2.139, 0.000},
+        {1,  0,  false, 3.250,  -0.520, 0.890},
+        {1,  0,  false, 3.250,  -0.520, -0.890},
+        {1,  0,  false, 4.530,  1.330,  0.000},
+        {1,  0,  false, 3.170,  1.900,  0.830},
+        {1,  0,  false, 3.170,  1.900,  -0.830},
+        {1,  0,  false, -3.250, -0.520, 0.890},
+        {1,  0,  false, -3.250, -0.520, -0.890}
+};
+
+static const FragmentBond fragmentBonds[] = {
+        {0,  1,  RDKit::Bond::AROMATIC},
+        {1,  2,  RDKit::Bond::AROMATIC},
+        {2,  3,  RDKit::Bond::AROMATIC},
+        {3,  4,  RDKit::Bond::AROMATIC},
+        {4,  5,  RDKit::Bond::AROMATIC},
+        {5,  0,  RDKit::Bond::AROMATIC},
+        {0,  6,  RDKit::Bond::SINGLE},
+        {6,  7,  RDKit::Bond::SINGLE},
+        {3,  8,  RDKit::Bond::SINGLE},
+        {8,  9,  RDKit::Bond::SINGLE},
+        {9,  10, RDKit::Bond::DOUBLE},
+        {9,  11, RDKit::Bond::SINGLE},
+        {1,  13, RDKit::Bond::SINGLE},
+        {2,  14, RDKit::Bond::SINGLE},
+        {4,  15, RDKit::Bond::SINGLE},
+        {5,  16, RDKit::Bond::SINGLE},
+        {6,  17, RDKit::Bond::SINGLE},
+        {6,  18, RDKit::Bond::SINGLE},
+        {7,  19, RDKit::Bond::SINGLE},
+        {7,  20, RDKit::Bond::SINGLE},
+        {7,  21, RDKit::Bond::SINGLE},
+        {8,  22, RDKit::Bond::SINGLE},
+        {8,  23, RDKit::Bond::SINGLE}
+};
+
+static constexpr size_t fragmentSize = sizeof(fragmentAtoms) / sizeof(fragmentAtoms[0]);
+
+/**
+ * The distance between the centers of two neighbouring fragments (in Angstrom)
+ */
+static constexpr double fragmentSpacing = 8.0;
+
+/**
+ * The largest number of set voxels a mesh can have to be sintetized (every voxel becomes an RDKit atom)
+ */
+static constexpr size_t maxSintetizedVoxels = 4000000;
+
+/**
+ * This function builds a synthetic molecule of (about) the requested size: copies of the fragment, each one randomly
+ * rotated, are placed on a cubic lattice (the layout is deterministic, so runs are comparable)
+ * @param numAtoms The requested number of atoms (rounded up to a whole number of fragments)
+ * @return The synthetic molecule, with a single 3D conformer
+ */
+static std::unique_ptr<RDKit::RWMol> buildMolecule(size_t numAtoms) {
+    const size_t fragments = (numAtoms + fragmentSize - 1) / fragmentSize;
+    const auto side = static_cast<size_t>(ceil(cbrt(static_cast<double>(fragments))));
+
+    auto molecule = std::make_unique<RDKit::RWMol>();
+    auto conformer = std::make_unique<RDKit::Conformer>(fragments * fragmentSize);
+
+    std::mt19937 generator(42);
+    std::normal_distribution<double> normal(0, 1);
+    std::uniform_real_distribution<double> jitter(-0.5, 0.5);
+
+    for (size_t f = 0; f < fragments; ++f) {
+        /* Random rotation, from a uniformly distributed unit quaternion */
+        double qw = normal(generator), qx = normal(generator), qy = normal(generator), qz = normal(generator);
+        double norm = sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+        qw /= norm, qx /= norm, qy /= norm, qz /= norm;
+        const double rotation[3][3] = {
+                {1 - 2 * (qy * qy + qz * qz), 2 * (qx * qy - qz * qw),     2 * (qx * qz + qy * qw)},
+                {2 * (qx * qy + qz * qw),     1 - 2 * (qx * qx + qz * qz), 2 * (qy * qz - qx * qw)},
+                {2 * (qx * qz - qy * qw),     2 * (qy * qz + qx * qw),     1 - 2 * (qx * qx + qy * qy)}
+        };
+        RDGeom::Point3D center(static_cast<double>(f % side) * fragmentSpacing + jitter(generator),
+                               static_cast<double>(f / side % side) * fragmentSpacing + jitter(generator),
+                               static_cast<double>(f / side / side) * fragmentSpacing + jitter(generator));
+
+        const auto offset = static_cast<unsigned int>(f * fragmentSize);
+        for (const FragmentAtom &fragmentAtom: fragmentAtoms) {
+            unsigned int atomId = molecule->addAtom();
+            RDKit::Atom *atom = molecule->getAtomWithIdx(atomId);
+            atom->setAtomicNum(fragmentAtom.atomicNum);
+            atom->setFormalCharge(fragmentAtom.charge);
+            atom->setIsAromatic(fragmentAtom.aromatic);
+            atom->setNoImplicit(true);
+
+            const double position[3] = {fragmentAtom.x, fragmentAtom.y, fragmentAtom.z};
+            RDGeom::Point3D pos = center;
+            pos.x += rotation[0][0] * position[0] + rotation[0][1] * position[1] + rotation[0][2] * position[2];
+            pos.y += rotation[1][0] * position[0] + rotation[1][1] * position[1] + rotation[1][2] * position[2];
+            pos.z += rotation[2][0] * position[0] + rotation[2][1] * position[1] + rotation[2][2] * position[2];
+            conformer->setAtomPos(atomId, pos);
+        }
+        for (const FragmentBond &fragmentBond: fragmentBonds) {
+            unsigned int numBonds = molecule->addBond(offset + fragmentBond.begin, offset + fragmentBond.end,
+                                                      fragmentBond.type);
+            if (fragmentBond.type == RDKit::Bond::AROMATIC)
+                molecule->getBondWithIdx(numBonds - 1)->setIsAromatic(true);
+        }
+    }
+
+    /* Perceive rings and aromaticity, as the molecules read from file are */
+    RDKit::MolOps::sanitizeMol(*molecule);
+
+    conformer->set3D(true);
+    molecule->addConformer(conformer.release(), true);
+    return molecule;
+}
+
+/**
+ * The outcome of a measure: number of repetitions and overall elapsed time (in seconds)
+ */
+struct Measure {
+    size_t reps;
+    double seconds;
+};
+
+/**
+ * This function repeats a task until the overall elapsed time reaches a minimum (at least once), the scratch arena
+ * is reset before each repetition as the pipeline does before each molecule
+ * @param minTime The minimum overall elapsed time (in seconds)
+ * @param task The task to measure
+ * @return The measure
+ */
+template<typename F>
+static Measure measure(double minTime, F &&task) {
+    Measure result{0, 0};
+    timespec startTime, endTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    do {
+        ScratchArena::local().reset();
+        task();
+        result.reps++;
+        clock_gettime(CLOCK_MONOTONIC, &endTime);
+        result.seconds = Pipeline::elapsedTime(startTime, endTime);
+    } while (result.seconds < minTime);
+    return result;
+}
+
+/**
+ * This function prints a row of the report (tab separated)
+ * @param name The benchmark name
+ * @param backend The backend name
+ * @param atoms The number of atoms of the molecule
+ * @param grain The grain of the meshes
+ * @param m The measure
+ * @param voxels The number of voxels processed by a repetition
+ * @param matches The number of pattern matches processed by a repetition
+ */
+static void report(const std::string &name, const char *backend, size_t atoms, int grain, const Measure &m,
+                   size_t voxels, size_t matches) {
+    double perRep = m.seconds / static_cast<double>(m.reps);
+    std::cout << name << "\t" << backend << "\t" << atoms << "\t" << grain << "\t" << m.reps << "\t"
+              << perRep * 1000 << "\t" << static_cast<double>(voxels) / perRep << "\t"
+              << static_cast<double>(matches) / perRep << std::endl;
+}
+
+/**
+ * This function parses a comma separated list of positive integers
+ * @param list The list
+ * @param values The output values
+ * @return False if the list is not valid
+ */
+static bool parseList(const std::string &list, std::vector<long> &values) {
+    values.clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        char *end;
+        long value = strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || value < 1) return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    /* Get benchmark options */
+    std::vector<long> sizes = {100, 1000, 10000, 50000};
+    std::vector<long> grains = {1, 3, 6};
+    std::vector<Backend::Type> backends;
+    for (Backend::Type type: {Backend::SERIAL, Backend::OMP, Backend::CUDA})
+        if (Backend::isAvailable(type)) backends.push_back(type);
+    double minTime = 0.5;
+    bool validOptions = args.size() % 2 == 0;
+    for (size_t i = 0; validOptions && i < args.size(); i += 2) {
+        if (args[i] == "--sizes") validOptions = parseList(args[i + 1], sizes);
+        else if (args[i] == "--grains") validOptions = parseList(args[i + 1], grains);
+        else if (args[i] == "--backends") {
+            backends.clear();
+            std::stringstream stream(args[i + 1]);
+            std::string name;
+            while (validOptions && std::getline(stream, name, ',')) {
+                try {
+                    backends.push_back(Backend::parse(name));
+                    validOptions = Backend::isAvailable(backends.back());
+                } catch (const std::invalid_argument &) {
+                    validOptions = false;
+                }
+            }
+            validOptions = validOptions && !backends.empty();
+        } else if (args[i] == "--min-time") {
+            char *end;
+            minTime = strtod(args[i + 1].c_str(), &end);
+            validOptions = *end == '\0' && minTime >= 0;
+        } else validOptions = false;
+    }
+    if (!validOptions) {
+        std::cout << "Usage:\tProLIF_Coloring_bench [options]" << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "      \t--sizes <n,...>\t\tnumber of atoms of the synthetic molecules"
+                  << " (default 100,1000,10000,50000)" << std::endl;
+        std::cout << "      \t--grains <g,...>\tvoxels per Angstrom of the meshes (default 1,3,6)" << std::endl;
+        std::cout << "      \t--backends <b,...>\tbackends to compare, auto|serial|omp|cuda"
+                  << " (default all the built ones)" << std::endl;
+        std::cout << "      \t--min-time <seconds>\tminimum measured time of each benchmark (default 0.5)"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    /* Interactions are built once, as the pipeline does */
+    InteractionCollection::list_t interactions = InteractionCollection::buildList();
+
+    std::cout << "benchmark\tbackend\tatoms\tgrain\treps\tms/rep\tvoxels/s\tmatches/s" << std::endl;
+    for (long size: sizes) {
+        std::unique_ptr<RDKit::RWMol> molecule = buildMolecule(static_cast<size_t>(size));
+        MoleculeContext context(*molecule);
+        const size_t atoms = context.getNumAtoms();
+
+        for (long longGrain: grains) {
+            const auto grain = static_cast<int>(longGrain);
+
+            std::unique_ptr<MoleculeMesh> moleculeMesh = Transformer::discretize(context, 5, grain);
+            const MoleculeMesh &mesh = *moleculeMesh;
+            const size_t boxVoxels = static_cast<size_t>(mesh.dim_x) * mesh.dim_y * mesh.dim_z;
+            const size_t setVoxels = mesh.getVoxelCount();
+
+            /* Synthesis, the throughput is given in set voxels (the atoms of the synthesized molecule) */
+            Measure m{};
+            if (setVoxels <= maxSintetizedVoxels) {
+                m = measure(minTime, [&]() { Transformer::sintetize(mesh); });
+                report("sintetize", "-", atoms, grain, m, setVoxels, 0);
+
+                SparseMesh sparseMesh(mesh);
+                m = measure(minTime, [&]() { Transformer::sintetize(sparseMesh); });
+                report("sintetize-sparse", "-", atoms, grain, m, setVoxels, 0);
+            } else {
+                std::cout << "sintetize\t-\t" << atoms << "\t" << grain << "\tskipped (" << setVoxels
+                          << " set voxels)" << std::endl;
+            }
+
+            for (Backend::Type type: backends) {
+                Backend::select(type);
+                const char *backend = Backend::name(type);
+
+                /* Discretization, the throughput is given in voxels of the mesh box */
+                m = measure(minTime, [&]() { Transformer::discretize(context, 5, grain); });
+                report("discretize", backend, atoms, grain, m, boxVoxels, 0);
+
+                /* Mesh operations, on an aligned and on an unaligned (shifted-word) displacement */
+                MoleculeMesh target(mesh.dim_x, mesh.dim_y, mesh.dim_z, mesh.globalDisplacement,
+                                    mesh.internalDisplacement, mesh.grain);
+                m = measure(minTime, [&]() { target.add(mesh, 0, 0, 0); });
+                report("addMeshes", backend, atoms, grain, m, boxVoxels, 0);
+                m = measure(minTime, [&]() { target.add(mesh, 5, 1, 1); });
+                report("addMeshes-shifted", backend, atoms, grain, m, boxVoxels, 0);
+                m = measure(minTime, [&]() { target.sub(mesh, 0, 0, 0); });
+                report("subMeshes", backend, atoms, grain, m, boxVoxels, 0);
+                m = measure(minTime, [&]() { target.sub(mesh, 5, 1, 1); });
+                report("subMeshes-shifted", backend, atoms, grain, m, boxVoxels, 0);
+
+                /* Interactions, the first call of a newly built interaction also performs the substructure
+                 * matching (cold), the following ones reuse the cached matches */
+                InteractionCollection::list_t coldInteractions = InteractionCollection::buildList();
+                MoleculeMesh interactionMesh(mesh.dim_x, mesh.dim_y, mesh.dim_z, mesh.globalDisplacement,
+                                             mesh.internalDisplacement, mesh.grain);
+                for (size_t i = 0; i < interactions.size(); ++i) {
+                    const std::string &desc = interactions[i].first;
+
+                    m = measure(0, [&]() {
+                        interactionMesh.clear();
+                        coldInteractions[i].second->getInteraction(context, interactionMesh, *moleculeMesh);
+                    });
+                    const size_t matches = coldInteractions[i].second->getMatchCount(context);
+                    report(desc + "-cold", backend, atoms, grain, m, boxVoxels, matches);
+
+                    m = measure(minTime, [&]() {
+                        interactionMesh.clear();
+                        interactions[i].second->getInteraction(context, interactionMesh, *moleculeMesh);
+                    });
+                    report(desc, backend, atoms, grain, m, boxVoxels, matches);
+                }
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+#ifndef PROLIF_COLORING_BACKEND
+#define PROLIF_COLORING_BACKEND
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+/**
+ * This class keeps the process-wide selection of the implementation (backend) the mesh operations and the
+ * interactions run on. All the backends the library has been built with coexist, so they can be switched at runtime
+ * (and compared in the same process); the automatic selection runs small problems serially, where the fork/join
+ * overhead of a parallel backend is larger than the work itself, and large ones on the parallel backend
+ */
+class Backend {
+public:
+    /**
+     * The available backends
+     *      - AUTO: SERIAL below a work threshold, the parallel backend of the build above it
+     *      - SERIAL: cpu based, single threaded implementation (always built)
+     *      - OMP: cpu based, openmp multithreaded implementation (built with USEOMP)
+     *      - CUDA: gpu based, cuda implementation (built with USECUDA)
+     */
+    enum Type {
+        AUTO,
+        SERIAL,
+        OMP,
+        CUDA
+    };
+
+    /**
+     * The default work threshold (in x-rows) from which the automatic selection runs the parallel backend
+     */
+    static constexpr size_t defaultAutoRows = 1 << 14;
+
+private:
+    /**
+     * The selected backend
+     */
+    static std::atomic<Type> selected;
+
+    /**
+     * The work threshold (in x-rows) of the automatic selection
+     */
+    static std::atomic<size_t> autoRows;
+
+    /**
+     * True on the threads processing molecules concurrently with other ones (see WorkerScope)
+     */
+    static thread_local bool concurrentWorker;
+
+public:
+    /**
+     * This class marks the calling thread, for its lifetime, as one of the workers of a pool (batch, stream) that
+     * process molecules concurrently: the operations of such a thread never start an openmp team, since every
+     * worker would start one as large as the cpu, oversubscribing it
+     */
+    class WorkerScope {
+        bool previous;
+
+    public:
+        /**
+         * This constructor marks the calling thread as a worker
+         * @param concurrent False if the worker runs alone (the thread is then left unmarked)
+         */
+        explicit WorkerScope(bool concurrent = true) : previous(concurrentWorker) {
+            concurrentWorker = previous || concurrent;
+        }
+
+        ~WorkerScope() {
+            concurrentWorker = previous;
+        }
+
+        WorkerScope(const WorkerScope &) = delete;
+
+        WorkerScope &operator=(const WorkerScope &) = delete;
+    };
+
+    /**
+     * This function returns if a backend has been built into the library
+     * @param type The backend
+     * @return True if the backend can be selected
+     */
+    static bool isAvailable(Type type);
+
+    /**
+     * This function selects the backend of the whole process, it throws if the backend is not available
+     * @param type The backend
+     * @param autoThreshold The work threshold (in x-rows) from which the automatic selection runs the parallel backend
+     */
+    static void select(Type type, size_t autoThreshold = defaultAutoRows);
+
+    /**
+     * This function returns the selected backend
+     * @return
+     */
+    static Type getSelected() {
+        return selected.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * This function returns the backend an operation has to run on, the serial one instead of openmp on the
+     * workers of a pool (see WorkerScope)
+     * @param rows The work of the operation, as the number of x-rows it writes
+     * @return The selected backend, or the resolved automatic one (never AUTO)
+     */
+    static Type resolve(size_t rows);
+
+    /**
+     * This function returns the number of x-rows of the window of a spherical pattern, the work estimate of stamping
+     * a pattern of an interaction
+     * @param radius The radius of the pattern
+     * @param grain The number of voxels per unit of length
+     * @return The number of x-rows of the pattern window
+     */
+    static size_t patternRows(double radius, int grain) {
+        auto edge = static_cast<size_t>(2 * std::ceil(radius * grain) + 1);
+        return edge * edge;
+    }
+
+    /**
+     * This function returns the name of a backend
+     * @param type The backend
+     * @return The name (auto, serial, omp, cuda)
+     */
+    static const char *name(Type type);
+
+    /**
+     * This function returns the backend of a given name, it throws if the name is unknown
+     * @param name The name (auto, serial, omp, cuda)
+     * @return The backend
+     */
+    static Type parse(const std::string &name);
+};
+
+#endif //PROLIF_COLORING_BACKEND
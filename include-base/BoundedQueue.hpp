@@ -0,0 +1,74 @@
+#ifndef PROLIF_COLORING_BOUNDED_QUEUE
+#define PROLIF_COLORING_BOUNDED_QUEUE
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * This class defines a blocking FIFO queue with a maximum capacity, used to connect the stages of a pipeline:
+ * producers block while the queue is full, so the number of in-flight items never exceeds the capacity
+ * @tparam T The type of the queued items
+ */
+template<typename T>
+class BoundedQueue {
+private:
+    std::deque<T> items;
+    const size_t capacity;
+    bool closed = false;
+
+    std::mutex mutex;
+    std::condition_variable notFull, notEmpty;
+
+public:
+    /**
+     * This constructor initialize an empty queue
+     * @param capacity The maximum number of queued items
+     */
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+    /**
+     * This function appends an item, waiting until the queue has room for it
+     * @param item The item to append
+     * @return False if the queue has been closed (the item is discarded), True otherwise
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * This function extracts the oldest item, waiting until one is available
+     * @param item The extracted item
+     * @return False if the queue has been closed and no item is left, True otherwise
+     */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * This function closes the queue: no more items are accepted, the queued ones can still be extracted
+     */
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
+
+#endif //PROLIF_COLORING_BOUNDED_QUEUE
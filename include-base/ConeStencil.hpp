@@ -0,0 +1,96 @@
+#ifndef PROLIF_COLORING_CONE_STENCIL
+#define PROLIF_COLORING_CONE_STENCIL
+
+#include <utility>
+#include "Geometry/point.h"
+#include "Mesh.hpp"
+#include "SpanStencil.hpp"
+
+/**
+ * This class rasterizes the pattern of a single-angle interaction: the voxels of a sphere (centered on a centroid)
+ * whose direction from p2 makes an angle with p2 --> p1 in [min_angle, max_angle].
+ * Angles are never computed: the cosine of the angle is compared against the precomputed cos(min/max angle) bounds
+ * through squared dot products, and rows are clipped to the half-space the cone lies in before voxels are tested.
+ * Voxels are first classified by cells of #cellEdge^3 voxels (coarse to fine): a cell whose whole angular range lies
+ * inside (or outside) the bounds is set (or skipped) at once, only the voxels of the mixed cells along the cone
+ * surface are tested one by one
+ */
+class ConeStencil {
+private:
+    /**
+     * The edge of the cells voxels are classified by, in voxels
+     */
+    static constexpr int cellEdge = 4;
+
+    /**
+     * The minimum grain cells are classified at
+     */
+    static constexpr int minCellGrain = 6;
+
+    /**
+     * The spherical pattern the cone is cut from
+     */
+    const SpanStencil &sphere;
+
+    /**
+     * The discrete center of the pattern window
+     */
+    const int scaledMaskCenter;
+
+    /**
+     * The number of voxels per unit of length
+     */
+    const int grain;
+
+    /**
+     * cos(min_angle), cos(max_angle) and their squares
+     */
+    const double cos_min, cos_max, cos_min_sq, cos_max_sq;
+
+    /**
+     * Switches that disable the bounds every angle satisfies (min_angle <= 0, max_angle >= PI)
+     */
+    const bool check_min, check_max;
+
+    /**
+     * The angle bounds, for the classification of cells
+     */
+    const double min_angle, max_angle;
+
+    /**
+     * The pattern generation kernel, see build()
+     * @param grain The number of voxels per unit of length (a compile-time constant for specialized grains)
+     */
+    template<typename G>
+    void buildKernel(const RDGeom::Point3D &center, const RDGeom::Point3D &p1, const RDGeom::Point3D &p2,
+                     SpanStencil &stencil, G grain) const;
+
+public:
+    /**
+     * This constructor precomputes the angle bounds of the pattern
+     * @param angle The pair <reference_min_angle, reference_max_angle>
+     * @param distance The radius of the pattern sphere
+     * @param grain The number of voxels per unit of length
+     */
+    ConeStencil(std::pair<double, double> angle, double distance, int grain = GRAIN);
+
+    /**
+     * This function returns the discrete center of the pattern window
+     * @return
+     */
+    inline int getCenter() const {
+        return scaledMaskCenter;
+    }
+
+    /**
+     * This function generates the pattern of a match, previous runs of the stencil are discarded
+     * @param center The centroid the pattern sphere is centered on
+     * @param p1 The first centroid of interaction
+     * @param p2 The second centroid of interaction (the cone apex)
+     * @param stencil The output pattern, its window is the sphere one
+     */
+    void build(const RDGeom::Point3D &center, const RDGeom::Point3D &p1, const RDGeom::Point3D &p2,
+               SpanStencil &stencil) const;
+};
+
+#endif //PROLIF_COLORING_CONE_STENCIL
@@ -0,0 +1,155 @@
+#ifndef PROLIF_COLORING_COUNT_MESH
+#define PROLIF_COLORING_COUNT_MESH
+
+#include <vector>
+#include <cstdint>
+#include "Geometry/point.h"
+#include "Mesh.hpp"
+#include "SpanStencil.hpp"
+
+/**
+ * This class defines a reference-counted discrete space: each voxel counts the patterns (or spheres) covering it,
+ * so that a pattern can be removed as well as added. The set voxels (count > 0) are kept up to date in a discrete
+ * space of the same size, which can be used as any other MoleculeMesh
+ */
+class CountMesh {
+public:
+    /**
+     * The type of the voxel count
+     */
+    typedef uint16_t count_t;
+
+private:
+    /**
+     * The data structure that contains the voxel counts
+     */
+    std::vector<count_t> counts;
+
+    /**
+     * The discrete space of the voxels covered at least once
+     */
+    MoleculeMesh mesh;
+
+    /**
+     * This function adds a value to the counts of the voxels [begin, end) of an x-row,
+     * setting (unsetting) the voxels whose count leaves (reaches) 0
+     * @param y Y discrete coordinate of the row
+     * @param z Z discrete coordinate of the row
+     * @param begin The first voxel of the run
+     * @param end The voxel past the last one of the run
+     * @param delta +1 to add a covering, -1 to remove it
+     */
+    void addRun(int y, int z, int begin, int end, int delta);
+
+    /**
+     * This function adds a value to the counts of the voxels of a pattern, clipped onto the space
+     */
+    void addStencil(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z, int delta);
+
+    /**
+     * This function adds a value to the counts of the voxels of a sphere, clipped onto the space
+     * (the voxels are the ones MoleculeMesh::stampSpheres sets)
+     */
+    void addSphere(double center_x, double center_y, double center_z, double radius, int delta);
+
+public:
+    /**
+     * The 3D sizes of the discrete space
+     */
+    const int dim_x, dim_y, dim_z;
+
+    /**
+     * This constructor initialize the discrete space with no voxel covered
+     * @param p_dim_x X dimension of the space
+     * @param p_dim_y Y dimension of the space
+     * @param p_dim_z Z dimension of the space
+     * @param globalDisplacement Global displacement of the space
+     * @param internalDisplacement Internal displacement of data
+     * @param grain The number of voxels per unit of length of the space
+     */
+    CountMesh(int p_dim_x, int p_dim_y, int p_dim_z, const RDGeom::Point3D &globalDisplacement,
+              int internalDisplacement, int grain = GRAIN) :
+            counts(static_cast<size_t>(p_dim_x) * p_dim_y * p_dim_z),
+            mesh(p_dim_x, p_dim_y, p_dim_z, globalDisplacement, internalDisplacement, grain),
+            dim_x(p_dim_x),
+            dim_y(p_dim_y),
+            dim_z(p_dim_z) {}
+
+    /**
+     * This function returns the discrete space of the voxels covered at least once
+     * @return
+     */
+    inline const MoleculeMesh &getMesh() const {
+        return mesh;
+    }
+
+    /**
+     * This function returns the number of patterns covering a voxel
+     * @param x X discrete coordinates
+     * @param y Y discrete coordinates
+     * @param z Z discrete coordinates
+     * @return The count at (X,Y,Z) discrete position in space
+     */
+    inline count_t at(int x, int y, int z) const {
+        return counts[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y) + x];
+    }
+
+    /**
+     * This function returns the number of bytes the space is made of (counts and set voxels)
+     * @return
+     */
+    inline size_t getMemoryUsage() const {
+        return counts.size() * sizeof(count_t) + mesh.getMemoryUsage();
+    }
+
+    /**
+     * This function adds a pattern to the space, as MoleculeMesh::stamp does
+     * @param stencil The pattern
+     * @param displ_x The X displacement we want the pattern to be placed
+     * @param displ_y The Y displacement we want the pattern to be placed
+     * @param displ_z The Z displacement we want the pattern to be placed
+     */
+    inline void stamp(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z) {
+        addStencil(stencil, displ_x, displ_y, displ_z, 1);
+    }
+
+    /**
+     * This function removes a pattern previously added at the same displacement
+     * @param stencil The pattern
+     * @param displ_x The X displacement the pattern has been placed
+     * @param displ_y The Y displacement the pattern has been placed
+     * @param displ_z The Z displacement the pattern has been placed
+     */
+    inline void unstamp(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z) {
+        addStencil(stencil, displ_x, displ_y, displ_z, -1);
+    }
+
+    /**
+     * This function adds a sphere to the space, as MoleculeMesh::stampSpheres does
+     * @param center_x X coordinate of the sphere center, in the discrete reference system of the space
+     * @param center_y Y coordinate of the sphere center, in the discrete reference system of the space
+     * @param center_z Z coordinate of the sphere center, in the discrete reference system of the space
+     * @param radius The radius of the sphere, in voxels
+     */
+    inline void stampSphere(double center_x, double center_y, double center_z, double radius) {
+        addSphere(center_x, center_y, center_z, radius, 1);
+    }
+
+    /**
+     * This function removes a sphere previously added at the same center
+     * @param center_x X coordinate of the sphere center, in the discrete reference system of the space
+     * @param center_y Y coordinate of the sphere center, in the discrete reference system of the space
+     * @param center_z Z coordinate of the sphere center, in the discrete reference system of the space
+     * @param radius The radius of the sphere, in voxels
+     */
+    inline void unstampSphere(double center_x, double center_y, double center_z, double radius) {
+        addSphere(center_x, center_y, center_z, radius, -1);
+    }
+
+    /**
+     * This function removes all the coverings of the space
+     */
+    void clear();
+};
+
+#endif //PROLIF_COLORING_COUNT_MESH
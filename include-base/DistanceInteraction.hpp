@@ -16,6 +16,42 @@ private:
      */
     const double distance;
 
+
+    /**
+     * This function calculates the voxels of the interaction-centroids of the matches, the ones the serial
+     * getInteraction() centers its patterns at
+     * @param context The molecule, prepared for the conformer to use
+     * @param matches The matches of the interaction
+     * @param interactionMask The support-mesh of the interaction
+     * @param seeds The voxels of the centroids, 3 coordinates per centroid
+     */
+    void seedVoxels(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                    const MoleculeMesh &interactionMask, std::pmr::vector<int> &seeds) const;
+
+    /**
+     * The distance transform implementation of getInteraction(), see DistanceTransform
+     */
+    bool getInteractionTransform(const std::pmr::vector<int> &seeds, MoleculeMesh &interactionMask,
+                                 MoleculeMesh &subtractionMask);
+
+    /**
+     * The serial implementation of getInteraction(), see Backend
+     */
+    bool getInteractionSerial(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                              MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
+    /**
+     * The OpenMP implementation of getInteraction(), see Backend
+     */
+    bool getInteractionOmp(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                           MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
+    /**
+     * The CUDA implementation of getInteraction(), see Backend
+     */
+    bool getInteractionCuda(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                            MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
 public:
     /**
      * This constructor extends the Interaction class constructor by receiving also the reference distance value
@@ -25,10 +61,19 @@ public:
     DistanceInteraction(const std::string &smart, double distance) : Interaction(smart), distance(distance) {};
 
     /**
-     * This function overrides the Interaction class one
+     * This function overrides the Interaction class one, it runs on the engine resolved for its matches (see
+     * DistanceTransform) and on the backend resolved for the rows of the patterns of its matches (or of the field)
      */
-    bool getInteraction(const RDKit::ROMol *molecule, MoleculeMesh &interactionMask,
+    bool getInteraction(const MoleculeContext &context, MoleculeMesh &interactionMask,
                         MoleculeMesh &subtractionMask) override;
+
+    /**
+     * This function overrides the Interaction class one, the patterns are the ones the serial getInteraction()
+     * stamps
+     */
+    void placeMatches(const MoleculeContext &context, const std::vector<RDKit::MatchVectType> &matches,
+                      const std::vector<size_t> &sites, const MoleculeMesh &interactionMask,
+                      std::vector<MatchStamp> &stamps) override;
 };
 
 #endif //PROLIF_COLORING_DISTANCE_INTERACTION
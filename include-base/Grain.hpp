@@ -0,0 +1,84 @@
+#ifndef PROLIF_COLORING_GRAIN
+#define PROLIF_COLORING_GRAIN
+
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * The default number of voxels per unit of length (it can be set at configure time, and overridden at runtime)
+ */
+#ifndef GRAIN
+#define GRAIN 3
+#endif
+
+/**
+ * This class dispatches a runtime grain (the number of voxels per unit of length) to the kernels that depend on it:
+ * common grains are passed as compile-time constants, so that the hot loops keep their constant-folded
+ * multiplications and divisions, any other grain is passed as a plain int to the generic kernel
+ */
+class Grain {
+private:
+    /**
+     * This function returns if a grain is one of the common ones (1, 2, 3, 4, 6, 8)
+     */
+    static constexpr bool isCommon(int grain) {
+        return grain == 1 || grain == 2 || grain == 3 || grain == 4 || grain == 6 || grain == 8;
+    }
+
+public:
+    /**
+     * The type of a compile-time grain, it converts to its int value
+     */
+    template<int G>
+    using fixed_t = std::integral_constant<int, G>;
+
+    /**
+     * This function throws if a grain is not a valid number of voxels per unit of length
+     * @param grain The grain to check
+     * @return The grain
+     */
+    static int check(int grain) {
+        if (grain < 1) throw std::invalid_argument("grain must be a positive number of voxels per unit of length");
+        return grain;
+    }
+
+    /**
+     * This function returns if a grain has a compile-time specialized kernel
+     * @param grain The grain
+     * @return True if the grain is one of 1, 2, 3, 4, 6, 8 (or the configured default one)
+     */
+    static constexpr bool isSpecialized(int grain) {
+        return isCommon(grain) || grain == GRAIN;
+    }
+
+    /**
+     * This function calls a kernel with the given grain, as a compile-time constant if the grain is specialized
+     * @param grain The grain
+     * @param kernel A generic callable taking the grain, it is instantiated once per specialized grain and once for
+     * the generic (int) one, every instantiation must return the same type
+     * @return What the kernel returns
+     */
+    template<typename F>
+    static auto dispatch(int grain, F &&kernel) {
+        switch (grain) {
+            case 1:
+                return kernel(fixed_t<1>());
+            case 2:
+                return kernel(fixed_t<2>());
+            case 3:
+                return kernel(fixed_t<3>());
+            case 4:
+                return kernel(fixed_t<4>());
+            case 6:
+                return kernel(fixed_t<6>());
+            case 8:
+                return kernel(fixed_t<8>());
+            default:
+                if constexpr (!isCommon(GRAIN))
+                    if (grain == GRAIN) return kernel(fixed_t<GRAIN>());
+                return kernel(check(grain));
+        }
+    }
+};
+
+#endif //PROLIF_COLORING_GRAIN
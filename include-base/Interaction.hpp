@@ -1,30 +1,109 @@
 #ifndef PROLIF_COLORING_INTERACTION
 #define PROLIF_COLORING_INTERACTION
 
+#include <memory>
 #include <string>
 #include <Mesh.hpp>
 #include <GraphMol/SmilesParse/SmilesParse.h>
 #include <GraphMol/Substruct/SubstructMatch.h>
+#include "MatchCache.hpp"
+#include "Metrics.hpp"
+#include "MoleculeContext.hpp"
 
 /**
  * This is the abstract class that defines the methods needed to calculate an interaction by an input molecule
  */
 class Interaction {
+public:
+    /**
+     * The pattern of a single match, placed onto a support-mesh (see placeMatches())
+     */
+    struct MatchStamp {
+        /**
+         * The runs of the pattern (null if the match has no pattern), either shared by all the matches or
+         * pointing to the own runs of the match
+         */
+        const SpanStencil *stencil = nullptr;
+
+        /**
+         * The own runs of the match, for patterns that depend on the match geometry
+         */
+        SpanStencil runs{0, 0, 0};
+
+        /**
+         * The displacement of the pattern onto the support-mesh
+         */
+        int displ_x = 0, displ_y = 0, displ_z = 0;
+    };
+
 protected:
     /**
      * The continuous molecule definition of the match pattern required by interaction
      */
-    RDKit::ROMol *matchMol;
+    std::unique_ptr<RDKit::ROMol> matchMol;
+
+    /**
+     * The matches of the match-pattern on the last seen molecule topologies
+     */
+    MatchCache matchCache;
 
     /**
      * This function return all the matches between input molecule and match-pattern molecule
-     * @param molecule The input molecule
+     * (molecules sharing the topology of an already matched one reuse its matches),
+     * the atom ids of a match are indices into the coordinate block of the context
+     * @param context The input prepared molecule
      * @return All matches between input molecule and match-pattern molecule
      */
-    std::vector<RDKit::MatchVectType> *findMatch(const RDKit::ROMol *molecule) {
-        auto *res = new std::vector<RDKit::MatchVectType>();
-        RDKit::SubstructMatch(*molecule, *matchMol, *res);
-        return res;
+    MatchCache::matches_t findMatch(const MoleculeContext &context) {
+        Metrics::Timer timer(Metrics::MATCH);
+        MatchCache::matches_t matches = matchCache.find(context.molecule, *matchMol);
+        Metrics::count(Metrics::MATCHES, matches->size());
+        return matches;
+    }
+
+    /**
+     * This function finds the matches of the match-pattern and runs a kernel of getInteraction() on them,
+     * accounting the time of the kernel and the voxels it sets into the metrics
+     * @param context The reference input continuous molecule, prepared for a conformer
+     * @param interactionMask The output discrete space definition of interaction acting space
+     * @param kernel The kernel, called with the matches
+     * @return What the kernel returns
+     */
+    template<typename K>
+    bool stampMatches(const MoleculeContext &context, MoleculeMesh &interactionMask, K &&kernel) {
+        MatchCache::matches_t matches = findMatch(context);
+        if (!Metrics::isEnabled()) return kernel(matches);
+
+        /* Voxels unset by the subtraction were set by the kernel as well */
+        Metrics &metrics = Metrics::local();
+        size_t startVoxels = interactionMask.getVoxelCount();
+        size_t startSubtracted = metrics.counters[Metrics::VOXELS_SUBTRACTED];
+        bool succeed;
+        {
+            Metrics::Timer timer(Metrics::STAMP);
+            succeed = kernel(matches);
+        }
+        metrics.counters[Metrics::VOXELS_STAMPED] += interactionMask.getVoxelCount() - startVoxels +
+                                                     metrics.counters[Metrics::VOXELS_SUBTRACTED] - startSubtracted;
+        return succeed;
+    }
+
+    /**
+     * This function resolves the leading atoms of every match into indices of the coordinate block of the context,
+     * matches with less atoms than required are skipped
+     * @param matches The matches of the match-pattern
+     * @param positions The number of leading atoms of a match to resolve
+     * @param atomIds The output atom ids, #positions consecutive ids per resolved match
+     */
+    static void resolveMatches(const std::vector<RDKit::MatchVectType> &matches, size_t positions,
+                               std::pmr::vector<int> &atomIds) {
+        atomIds.clear();
+        atomIds.reserve(matches.size() * positions);
+        for (const RDKit::MatchVectType &match: matches) {
+            if (match.size() < positions) continue;
+            for (size_t i = 0; i < positions; ++i)
+                atomIds.push_back(match[i].second);
+        }
     }
 
     /**
@@ -32,18 +111,53 @@ protected:
      * @param smart The input SMART definition for interaction match-pattern
      */
     explicit Interaction(const std::string &smart) {
-        matchMol = RDKit::SmartsToMol(smart);
+        matchMol.reset(RDKit::SmartsToMol(smart));
     }
 
 public:
+    virtual ~Interaction() = default;
+
+    /**
+     * This function returns the number of matches of the match-pattern into a molecule
+     * (the matches are cached, so it does not repeat the substructure matching of getInteraction())
+     * @param context The input prepared molecule
+     * @return The number of matches
+     */
+    size_t getMatchCount(const MoleculeContext &context) {
+        return findMatch(context)->size();
+    }
+
+    /**
+     * This function returns the matches of the match-pattern into a molecule (cached as for getInteraction())
+     * @param context The input prepared molecule
+     * @return All matches between input molecule and match-pattern molecule
+     */
+    MatchCache::matches_t getMatches(const MoleculeContext &context) {
+        return findMatch(context);
+    }
+
+    /**
+     * This function generates the patterns of some matches, placed onto a support-mesh as getInteraction() would
+     * stamp them, so that each one can be stamped and removed on its own (e.g. by the incremental update of the
+     * interactions over the frames of a trajectory, see TrajectoryMesh)
+     * @param context The reference input continuous molecule, prepared for a conformer
+     * @param matches The matches of the match-pattern into the molecule
+     * @param sites The indices of the matches whose pattern has to be generated
+     * @param interactionMask The support-mesh the patterns are placed onto
+     * @param stamps The output patterns, one per match (only the ones of #sites are written)
+     */
+    virtual void placeMatches(const MoleculeContext &context, const std::vector<RDKit::MatchVectType> &matches,
+                              const std::vector<size_t> &sites, const MoleculeMesh &interactionMask,
+                              std::vector<MatchStamp> &stamps) = 0;
+
     /**
      * This function calculate the discrete space the interaction is acting on
-     * @param molecule The reference input continuous molecule
+     * @param context The reference input continuous molecule, prepared for a conformer
      * @param interactionMask The output discrete space definition of interaction acting space
      * @param subtractionMask A input discrete space definition of a subtraction mask for the interaction space
      * @return False if no interaction has been found, True otherwise
      */
-    virtual bool getInteraction(const RDKit::ROMol *molecule,
+    virtual bool getInteraction(const MoleculeContext &context,
                                 MoleculeMesh &interactionMask,
                                 MoleculeMesh &subtractionMask) = 0;
 };
@@ -1,6 +1,7 @@
 #ifndef PROLIF_COLORING_INTERACTION_COLLECTION
 #define PROLIF_COLORING_INTERACTION_COLLECTION
 
+#include <memory>
 #include <vector>
 #include <string>
 #include "Interaction.hpp"
@@ -10,11 +11,16 @@
  */
 class InteractionCollection {
 public:
+    /**
+     * The type of the list-map: Interaction-ID <--> Interaction type (the list owns the interactions)
+     */
+    typedef std::vector<std::pair<std::string, std::unique_ptr<Interaction>>> list_t;
+
     /**
      * This function defines a list of Interaction type and return a list-map that associate each interaction to an id
      * @return A list-map: Interaction-ID <--> Interaction type
      */
-    static std::vector<std::pair<std::string, Interaction *>> buildList();
+    static list_t buildList();
 };
 
 #endif //PROLIF_COLORING_INTERACTION_COLLECTION
@@ -0,0 +1,133 @@
+#ifndef PROLIF_COLORING_LABEL_MESH
+#define PROLIF_COLORING_LABEL_MESH
+
+#include <vector>
+#include <cstdint>
+#include "Geometry/point.h"
+#include "Mesh.hpp"
+
+/**
+ * This class defines a discrete space in which each voxel holds a label: the bitmask of the channels
+ * (e.g. the interactions) acting on it, so that many discrete spaces can be described by a single data structure
+ */
+class LabelMesh {
+public:
+    /**
+     * The type of the voxel label (bit i set if channel i acts on the voxel)
+     */
+    typedef uint16_t label_t;
+
+    /**
+     * The maximum number of channels a label can describe
+     */
+    static constexpr int maxChannels = 16;
+
+private:
+    /**
+     * The data structure that contains the voxel labels
+     */
+    std::vector<label_t> labels;
+
+    /**
+     * The bitmask of the channels merged so far
+     */
+    label_t channels = 0;
+
+public:
+    /**
+     * The 3D sizes of the discrete space
+     */
+    const int dim_x, dim_y, dim_z;
+
+    /**
+     * The displacement this discrete space have in relation to a "global" one
+     */
+    RDGeom::Point3D globalDisplacement;
+
+    /**
+     * The displacement data have internally in this discrete space
+     */
+    int internalDisplacement;
+
+    /**
+     * The number of voxels per unit of length of the space
+     */
+    int grain;
+
+    /**
+     * This constructor initialize the discrete space with no label set
+     * @param p_dim_x X dimension of the space
+     * @param p_dim_y Y dimension of the space
+     * @param p_dim_z Z dimension of the space
+     * @param globalDisplacement Global displacement of the space
+     * @param internalDisplacement Internal displacement of data
+     * @param grain The number of voxels per unit of length of the space
+     */
+    LabelMesh(int p_dim_x, int p_dim_y, int p_dim_z, const RDGeom::Point3D &globalDisplacement,
+              int internalDisplacement, int grain = GRAIN) :
+            dim_x(p_dim_x),
+            dim_y(p_dim_y),
+            dim_z(p_dim_z),
+            globalDisplacement(globalDisplacement),
+            internalDisplacement(internalDisplacement),
+            grain(grain) {
+        labels = std::vector<label_t>(static_cast<size_t>(dim_x) * dim_y * dim_z);
+    }
+
+    /**
+     * This function returns the label at a specific discrete position of the space
+     * @param x X discrete coordinates
+     * @param y Y discrete coordinates
+     * @param z Z discrete coordinates
+     * @return The label at (X,Y,Z) discrete position in space
+     */
+    inline label_t at(int x, int y, int z) const {
+        return labels[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y) + x];
+    }
+
+    /**
+     * This function returns the labels of the space
+     * @return
+     */
+    inline const label_t *getData() const {
+        return labels.data();
+    }
+
+    /**
+     * This function returns the number of bytes the space is made of
+     * @return
+     */
+    inline size_t getMemoryUsage() const {
+        return labels.size() * sizeof(label_t);
+    }
+
+    /**
+     * This function returns the bitmask of the channels merged into the space
+     * @return
+     */
+    inline label_t getChannels() const {
+        return channels;
+    }
+
+    /**
+     * This function sets a channel on every voxel set in a discrete space (of the same size of this one)
+     * @param mesh The discrete space of the channel
+     * @param channel The channel index
+     */
+    void merge(const MoleculeMesh &mesh, int channel);
+
+    /**
+     * This function clears all channels of every voxel set in a discrete space (of the same size of this one)
+     * @param mask The subtraction discrete space
+     */
+    void sub(const MoleculeMesh &mask);
+
+    /**
+     * This function extracts the discrete space of a single channel
+     * @param channel The channel index
+     * @return The discrete space of the voxels the channel acts on
+     */
+    MoleculeMesh extract(int channel) const;
+};
+
+#endif //PROLIF_COLORING_LABEL_MESH
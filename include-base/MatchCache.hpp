@@ -0,0 +1,91 @@
+#ifndef PROLIF_COLORING_MATCH_CACHE
+#define PROLIF_COLORING_MATCH_CACHE
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <GraphMol/GraphMol.h>
+#include <GraphMol/Substruct/SubstructMatch.h>
+
+/**
+ * This class keeps the matches of a pattern on the most recently seen molecule topologies, so that poses, frames and
+ * conformers of the same molecule (same atoms, in the same order, and same bonds) are matched only once.
+ * The cache is bounded (least recently used topologies are evicted) and safe to be shared between threads
+ */
+class MatchCache {
+public:
+    /**
+     * The matches of a pattern on a molecule, shared between the cache and its users
+     */
+    typedef std::shared_ptr<const std::vector<RDKit::MatchVectType>> matches_t;
+
+private:
+    /**
+     * A cached topology: its full signature (to tell apart hash collisions) and its matches
+     */
+    struct Entry {
+        std::pmr::vector<int64_t> signature;
+        matches_t matches;
+        std::list<uint64_t>::iterator recent;
+    };
+
+    /**
+     * The maximum number of cached topologies
+     */
+    const size_t capacity;
+
+    /**
+     * The mutex guarding the cached topologies
+     */
+    std::mutex mutex;
+
+    /**
+     * The cached topologies: topology hash <--> entry
+     */
+    std::unordered_map<uint64_t, Entry> entries;
+
+    /**
+     * The topology hashes, most recently used first
+     */
+    std::list<uint64_t> recents;
+
+public:
+    /**
+     * This constructor initialize an empty cache
+     * @param capacity The maximum number of cached topologies
+     */
+    explicit MatchCache(size_t capacity = 64) : capacity(capacity) {}
+
+    /**
+     * This function returns the topology signature of a molecule: atom types (element, charge, isotope,
+     * aromaticity, hydrogens, degree, radicals, chirality) and bonds (ends, type, aromaticity) in atom order,
+     * which is everything a SMARTS pattern can match on
+     * @param molecule The molecule
+     * @param resource The memory resource the signature is allocated from
+     * @return The topology signature
+     */
+    static std::pmr::vector<int64_t> topology(const RDKit::ROMol &molecule,
+                                              std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /**
+     * This function returns the hash of a topology signature
+     * @param signature The topology signature
+     * @return The topology hash
+     */
+    static uint64_t hash(const std::pmr::vector<int64_t> &signature);
+
+    /**
+     * This function returns the matches of a pattern on a molecule, they are computed only if the topology of the
+     * molecule is not cached
+     * @param molecule The input molecule
+     * @param pattern The match-pattern molecule (the same one for every call on this cache)
+     * @return All matches between input molecule and match-pattern molecule
+     */
+    matches_t find(const RDKit::ROMol &molecule, const RDKit::ROMol &pattern);
+};
+
+#endif //PROLIF_COLORING_MATCH_CACHE
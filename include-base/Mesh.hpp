@@ -2,11 +2,13 @@
 #define PROLIF_COLORING_MESH
 
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
 #include "Geometry/point.h"
-
-#ifndef GRAIN
-#define GRAIN 3
-#endif
+#include "SpanStencil.hpp"
+#include "Grain.hpp"
+#include "Backend.hpp"
 
 /**
  * This class defines the model for the discrete molecule
@@ -15,8 +17,41 @@ class MoleculeMesh {
 public:
     /**
      * The type of data the discrete space is based on
+     * (each data word packs a run of 64 consecutive voxels of the same x-row, one bit per voxel)
+     */
+    typedef uint64_t data_t;
+
+    /**
+     * The number of voxels packed into a single data word
      */
-    typedef int data_t;
+    static constexpr int wordBits = 64;
+
+    /**
+     * This class is a reference to a single voxel bit, it allows to keep the bool-like read/write
+     * semantics of a plain data reference over the packed data structure
+     */
+    class VoxelRef {
+    private:
+        data_t *word;
+        data_t mask;
+
+    public:
+        VoxelRef(data_t *word, data_t mask) : word(word), mask(mask) {}
+
+        inline operator bool() const {
+            return (*word & mask) != 0;
+        }
+
+        inline VoxelRef &operator=(bool value) {
+            if (value) *word |= mask;
+            else *word &= ~mask;
+            return *this;
+        }
+
+        inline VoxelRef &operator=(const VoxelRef &other) {
+            return *this = static_cast<bool>(other);
+        }
+    };
 
 private:
     /**
@@ -24,12 +59,65 @@ private:
      */
     std::vector<data_t> voxels;
 
+    /**
+     * The serial implementation of addMeshes(), see Backend
+     */
+    static void addMeshesSerial(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
+                                int displ_x, int displ_y, int displ_z,
+                                int data_dim_x, int data_dim_y, int data_dim_z,
+                                int add_dim_x, int add_dim_y, int add_dim_z);
+
+    /**
+     * The OpenMP implementation of addMeshes(), see Backend
+     */
+    static void addMeshesOmp(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
+                             int displ_x, int displ_y, int displ_z,
+                             int data_dim_x, int data_dim_y, int data_dim_z,
+                             int add_dim_x, int add_dim_y, int add_dim_z);
+
+    /**
+     * The serial implementation of subMeshes(), see Backend
+     */
+    static void subMeshesSerial(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
+                                int displ_x, int displ_y, int displ_z,
+                                int data_dim_x, int data_dim_y, int data_dim_z,
+                                int sub_dim_x, int sub_dim_y, int sub_dim_z);
+
+    /**
+     * The OpenMP implementation of subMeshes(), see Backend
+     */
+    static void subMeshesOmp(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
+                             int displ_x, int displ_y, int displ_z,
+                             int data_dim_x, int data_dim_y, int data_dim_z,
+                             int sub_dim_x, int sub_dim_y, int sub_dim_z);
+
+    /**
+     * The serial implementation of stampSpheres(), see Backend
+     */
+    static void stampSpheresSerial(MoleculeMesh::data_t *data,
+                                   const double *centers_x, const double *centers_y, const double *centers_z,
+                                   size_t n_spheres, double radius,
+                                   int data_dim_x, int data_dim_y, int data_dim_z);
+
+    /**
+     * The OpenMP implementation of stampSpheres(), see Backend
+     */
+    static void stampSpheresOmp(MoleculeMesh::data_t *data,
+                                const double *centers_x, const double *centers_y, const double *centers_z,
+                                size_t n_spheres, double radius,
+                                int data_dim_x, int data_dim_y, int data_dim_z);
+
 public:
     /**
      * The 3D sizes of the discrete space
      */
     const int dim_x, dim_y, dim_z;
 
+    /**
+     * The number of data words each x-row of the space is packed into
+     */
+    const int words_x;
+
     /**
      * The displacement this discrete space have in relation to a "global" one
      * (this is useful if we have to manage independently multiple discrete spaces all related to each other)
@@ -42,6 +130,11 @@ public:
      */
     int internalDisplacement;
 
+    /**
+     * The number of voxels per unit of length of the space
+     */
+    int grain;
+
     /**
      * This constructor initialize the discrete space
      * @param p_dim_x X dimension of the space
@@ -49,15 +142,18 @@ public:
      * @param p_dim_z Z dimension of the space
      * @param globalDisplacement Global displacement of the space
      * @param internalDisplacement Internal displacement of data
+     * @param grain The number of voxels per unit of length of the space
      */
     MoleculeMesh(int p_dim_x, int p_dim_y, int p_dim_z, const RDGeom::Point3D &globalDisplacement,
-                 int internalDisplacement) :
+                 int internalDisplacement, int grain = GRAIN) :
             dim_x(p_dim_x),
             dim_y(p_dim_y),
             dim_z(p_dim_z),
+            words_x(MoleculeMesh::rowWords(p_dim_x)),
             globalDisplacement(globalDisplacement),
-            internalDisplacement(internalDisplacement) {
-        voxels = std::vector<data_t>(dim_x * dim_y * dim_z);
+            internalDisplacement(internalDisplacement),
+            grain(grain) {
+        voxels = std::vector<data_t>(static_cast<size_t>(words_x) * dim_y * dim_z);
     }
 
     /**
@@ -70,13 +166,21 @@ public:
             MoleculeMesh(p_dim_x, p_dim_y, p_dim_z, {0, 0, 0}, 0) {}
 
     /**
-     * This function returns the number of data the space contains
+     * This function returns the number of data words the space contains
      * @return
      */
-    inline size_t getDataSize() {
+    inline size_t getDataSize() const {
         return voxels.size();
     }
 
+    /**
+     * This function returns the number of bytes the space is made of
+     * @return
+     */
+    inline size_t getMemoryUsage() const {
+        return voxels.size() * sizeof(data_t);
+    }
+
     /**
      * This function returns the data of the space
      * @return
@@ -85,6 +189,32 @@ public:
         return voxels.data();
     }
 
+    /**
+     * This function returns the data of the space (read-only)
+     * @return
+     */
+    inline const data_t *getData() const {
+        return voxels.data();
+    }
+
+    /**
+     * This function returns the number of set voxels of the space
+     * @return
+     */
+    inline size_t getVoxelCount() const {
+        size_t count = 0;
+        for (data_t word: voxels)
+            count += __builtin_popcountll(word);
+        return count;
+    }
+
+    /**
+     * This function unsets all the voxels of the space (so that it can be reused)
+     */
+    inline void clear() {
+        std::fill(voxels.begin(), voxels.end(), 0);
+    }
+
     /**
      * This function returns the data at a specific discrete position of the space
      * @param x X discrete coordinates
@@ -92,10 +222,82 @@ public:
      * @param z Z discrete coordinates
      * @return The data at (X,Y,Z) discrete position in space
      */
-    inline data_t &at(int x, int y, int z) {
+    inline VoxelRef at(int x, int y, int z) {
         return MoleculeMesh::ref(voxels.data(), x, y, z, dim_x, dim_y, dim_z);
     }
 
+    /**
+     * This function returns the data at a specific discrete position of the space (read-only)
+     * @param x X discrete coordinates
+     * @param y Y discrete coordinates
+     * @param z Z discrete coordinates
+     * @return The data at (X,Y,Z) discrete position in space
+     */
+    inline bool at(int x, int y, int z) const {
+        return (MoleculeMesh::row(voxels.data(), y, z, words_x, dim_y)[x / wordBits] >> (x % wordBits)) & 1;
+    }
+
+    /**
+     * This function returns the number of data words needed to pack an x-row of the given size
+     * @param dim_x The X dimension of the space
+     * @return The number of data words per x-row
+     */
+    inline static int rowWords(const int dim_x) {
+        return (dim_x + wordBits - 1) / wordBits;
+    }
+
+    /**
+     * This function returns the packed x-row at a specific discrete (Y,Z) position of a space data structure
+     * @param data The space data structure
+     * @param y Y discrete coordinates
+     * @param z Z discrete coordinates
+     * @param words_x The number of data words per x-row
+     * @param dim_y The Y dimension of space data structure
+     * @return The first data word of the x-row
+     */
+    inline static data_t *row(MoleculeMesh::data_t *data, int y, int z, const int words_x, const int dim_y) {
+        return data + static_cast<size_t>(words_x) * (static_cast<size_t>(z) * dim_y + y);
+    }
+
+    inline static const data_t *row(const MoleculeMesh::data_t *data, int y, int z, const int words_x,
+                                    const int dim_y) {
+        return data + static_cast<size_t>(words_x) * (static_cast<size_t>(z) * dim_y + y);
+    }
+
+    /**
+     * This function returns the mask of the bits of a data word that fall in the voxel range [begin, end)
+     * @param word The index of the data word in the x-row
+     * @param begin The first voxel of the range
+     * @param end The voxel past the last one of the range
+     * @return The mask of the voxels of the range inside the word
+     */
+    inline static data_t rangeMask(int word, int begin, int end) {
+        int lo = begin - word * wordBits;
+        int hi = end - word * wordBits;
+        if (lo < 0) lo = 0;
+        if (hi > wordBits) hi = wordBits;
+        if (lo >= hi) return 0;
+        data_t upper = hi == wordBits ? ~data_t(0) : (data_t(1) << hi) - 1;
+        return upper & ~((data_t(1) << lo) - 1);
+    }
+
+    /**
+     * This function returns 64 consecutive voxels of a packed x-row starting from any (even unaligned) voxel,
+     * voxels outside the row are read as empty
+     * @param row The packed x-row
+     * @param offset The first voxel to read (may be negative)
+     * @param words_x The number of data words of the x-row
+     * @return The data word holding voxels [offset, offset + 64)
+     */
+    inline static data_t fetchWord(const MoleculeMesh::data_t *row, int offset, const int words_x) {
+        int word = offset >= 0 ? offset / wordBits : -((wordBits - 1 - offset) / wordBits);
+        int shift = offset - word * wordBits;
+        data_t lo = (word >= 0 && word < words_x) ? row[word] : 0;
+        if (shift == 0) return lo;
+        data_t hi = (word + 1 >= 0 && word + 1 < words_x) ? row[word + 1] : 0;
+        return (lo >> shift) | (hi << (wordBits - shift));
+    }
+
     /**
      * This function defines how space data structure is managed in relation of spatial access
      * @param data The space data structure
@@ -107,9 +309,10 @@ public:
      * @param dim_z the Z dimension of space data structure
      * @return The data at (X,Y,Z) discrete position in input space data structure
      */
-    inline static data_t &ref(MoleculeMesh::data_t *data, int x, int y, int z,
-                              const int dim_x, const int dim_y, const int /*dim_z*/) {
-        return data[dim_x * (z * dim_y + y) + x];
+    inline static VoxelRef ref(MoleculeMesh::data_t *data, int x, int y, int z,
+                               const int dim_x, const int dim_y, const int /*dim_z*/) {
+        return {MoleculeMesh::row(data, y, z, MoleculeMesh::rowWords(dim_x), dim_y) + x / wordBits,
+                data_t(1) << (x % wordBits)};
     }
 
     /**
@@ -119,7 +322,7 @@ public:
      * @param displ_y The Y displacement we want the input space to be placed
      * @param displ_z The Z displacement we want the input space to be placed
      */
-    inline void add(MoleculeMesh &addend, int displ_x, int displ_y, int displ_z) {
+    inline void add(const MoleculeMesh &addend, int displ_x, int displ_y, int displ_z) {
         MoleculeMesh::addMeshes(getData(), addend.getData(),
                                 displ_x, displ_y, displ_z,
                                 dim_x, dim_y, dim_z,
@@ -133,15 +336,117 @@ public:
      * @param displ_y The Y displacement we want the input space to be placed
      * @param displ_z The Z displacement we want the input space to be placed
      */
-    inline void sub(MoleculeMesh &addend, int displ_x, int displ_y, int displ_z) {
+    inline void sub(const MoleculeMesh &addend, int displ_x, int displ_y, int displ_z) {
         MoleculeMesh::subMeshes(getData(), addend.getData(),
                                 displ_x, displ_y, displ_z,
                                 dim_x, dim_y, dim_z,
                                 addend.dim_x, addend.dim_y, addend.dim_z);
     }
 
+    /**
+     * This function allow to integrate a sparse pattern performing a boolean addition to the class managed space,
+     * only the runs of the pattern are visited, each one as a contiguous fill of its x-row
+     * @param stencil The pattern we want to integrate
+     * @param displ_x The X displacement we want the pattern to be placed
+     * @param displ_y The Y displacement we want the pattern to be placed
+     * @param displ_z The Z displacement we want the pattern to be placed
+     */
+    inline void stamp(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z) {
+        MoleculeMesh::stampSpans(getData(), stencil.spans.data(), stencil.spans.size(),
+                                 displ_x, displ_y, displ_z,
+                                 dim_x, dim_y, dim_z);
+    }
+
+    /**
+     * This function allow to integrate a sparse pattern only into the rows z_begin <= Z < z_end of the space
+     * (rows with different Z never share data words, so disjoint ranges of rows can be integrated concurrently)
+     * @param stencil The pattern we want to integrate
+     * @param displ_x The X displacement we want the pattern to be placed
+     * @param displ_y The Y displacement we want the pattern to be placed
+     * @param displ_z The Z displacement we want the pattern to be placed
+     * @param z_begin The first row of the space that can be modified
+     * @param z_end The row past the last one that can be modified
+     */
+    inline void stamp(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z, int z_begin, int z_end) {
+        std::pair<const SpanStencil::Span *, const SpanStencil::Span *> runs =
+                stencil.slab(z_begin - displ_z, z_end - displ_z);
+        MoleculeMesh::stampSpans(getData(), runs.first, static_cast<size_t>(runs.second - runs.first),
+                                 displ_x, displ_y, displ_z,
+                                 dim_x, dim_y, dim_z);
+    }
+
+    /**
+     * This function allow to integrate a set of spheres (e.g. the atoms of a molecule) performing a boolean addition,
+     * a voxel is set if its distance from a sphere center is <= radius
+     * @param centers_x X coordinates of the sphere centers, in the discrete reference system of the space
+     * @param centers_y Y coordinates of the sphere centers, in the discrete reference system of the space
+     * @param centers_z Z coordinates of the sphere centers, in the discrete reference system of the space
+     * @param n_spheres The number of spheres
+     * @param radius The radius of the spheres, in voxels
+     */
+    inline void stampSpheres(const double *centers_x, const double *centers_y, const double *centers_z,
+                             size_t n_spheres, double radius) {
+        MoleculeMesh::stampSpheres(getData(), centers_x, centers_y, centers_z, n_spheres, radius,
+                                   dim_x, dim_y, dim_z);
+    }
+
+    /**
+     * This function returns the run of voxels of an x-row that fall inside a sphere: the run is estimated
+     * analytically and its ends are settled by the exact voxel test (x - center_x)^2 + y_res + z_res <= ds,
+     * so that the run is the same a voxel-by-voxel scan of [lo, hi) would find
+     * @param center_x X coordinate of the sphere center
+     * @param y_res The squared Y distance of the row from the sphere center
+     * @param z_res The squared Z distance of the row from the sphere center
+     * @param ds The squared radius of the sphere
+     * @param lo The first voxel of the row that can be part of the run
+     * @param hi The voxel past the last one of the row that can be part of the run
+     * @param begin The output first voxel of the run
+     * @param end The output voxel past the last one of the run
+     * @return False if the run is empty
+     */
+    inline static bool sphereRun(double center_x, double y_res, double z_res, double ds, int lo, int hi,
+                                 int &begin, int &end) {
+        auto inside = [&](int x) {
+            double dx = x - center_x;
+            double x_res = dx * dx;
+            return x_res + y_res + z_res <= ds;
+        };
+
+        double half = std::sqrt(std::max(ds - y_res - z_res, 0.0));
+        int b = static_cast<int>(std::ceil(center_x - half));
+        int e = static_cast<int>(std::floor(center_x + half));
+
+        // The voxels inside the sphere are contiguous, so only the ends of the estimate have to be settled
+        while (b > lo && inside(b - 1)) b--;
+        while (b <= e && !inside(b)) b++;
+        while (e < hi - 1 && inside(e + 1)) e++;
+        while (e >= b && !inside(e)) e--;
+
+        begin = std::max(b, lo);
+        end = std::min(e + 1, hi);
+        return begin < end;
+    }
+
+    /**
+     * This function sets all the voxels [begin, end) of a packed x-row
+     * @param row The packed x-row
+     * @param begin The first voxel to set
+     * @param end The voxel past the last one to set
+     */
+    inline static void fillRow(MoleculeMesh::data_t *row, int begin, int end) {
+        if (begin >= end) return;
+        int bw = begin / wordBits;
+        int ew = (end - 1) / wordBits;
+        row[bw] |= rangeMask(bw, begin, end);
+        for (int w = bw + 1; w < ew; ++w)
+            row[w] = ~data_t(0);
+        row[ew] |= rangeMask(ew, begin, end);
+    }
+
     /**
      * This function defines how the logical addition between two discrete spaces has to performed
+     * (data are packed x-rows, so the operation is performed as shifted-word OR),
+     * it runs on the host backend resolved for the rows of the addend (CUDA resolves to the serial one)
      * @param data The base data on which the function integrate addend
      * @param to_add The addend data
      * @param displ_x The X displacement we want addend to be placed
@@ -154,13 +459,15 @@ public:
      * @param add_dim_y The addend data Y dimension
      * @param add_dim_z The addend data Z dimension
      */
-    static void addMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_add,
+    static void addMeshes(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
                           int displ_x, int displ_y, int displ_z,
                           int data_dim_x, int data_dim_y, int data_dim_z,
                           int add_dim_x, int add_dim_y, int add_dim_z);
 
     /**
      * This function defines how the logical subtraction between two discrete spaces has to performed
+     * (data are packed x-rows, so the operation is performed as shifted-word AND-NOT),
+     * it runs on the host backend resolved for the rows of the subtrahend (CUDA resolves to the serial one)
      * @param data The base data on which the function integrate addend
      * @param to_add The addend data
      * @param displ_x The X displacement we want addend to be placed
@@ -173,10 +480,63 @@ public:
      * @param sub_dim_y The addend data Y dimension
      * @param sub_dim_z The addend data Z dimension
      */
-    static void subMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_subtract,
+    static void subMeshes(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
                           int displ_x, int displ_y, int displ_z,
                           int data_dim_x, int data_dim_y, int data_dim_z,
                           int sub_dim_x, int sub_dim_y, int sub_dim_z);
+
+    /**
+     * The CUDA implementation of addMeshes(), see Backend: the data are device pointers, so the CUDA kernels call it
+     * directly instead of the dispatcher (which may resolve to a host backend)
+     */
+    static void addMeshesCuda(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
+                              int displ_x, int displ_y, int displ_z,
+                              int data_dim_x, int data_dim_y, int data_dim_z,
+                              int add_dim_x, int add_dim_y, int add_dim_z);
+
+    /**
+     * The CUDA implementation of subMeshes(), see Backend: the data are device pointers, so the CUDA kernels call it
+     * directly instead of the dispatcher
+     */
+    static void subMeshesCuda(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
+                              int displ_x, int displ_y, int displ_z,
+                              int data_dim_x, int data_dim_y, int data_dim_z,
+                              int sub_dim_x, int sub_dim_y, int sub_dim_z);
+
+    /**
+     * This function defines how a sparse pattern has to be integrated into a discrete space
+     * @param data The base data on which the function integrate the pattern
+     * @param spans The runs of the pattern
+     * @param n_spans The number of runs of the pattern
+     * @param displ_x The X displacement we want the pattern to be placed
+     * @param displ_y The Y displacement we want the pattern to be placed
+     * @param displ_z The Z displacement we want the pattern to be placed
+     * @param data_dim_x The base data X dimension
+     * @param data_dim_y The base data Y dimension
+     * @param data_dim_z The base data Z dimension
+     */
+    static void stampSpans(MoleculeMesh::data_t *data, const SpanStencil::Span *spans, size_t n_spans,
+                           int displ_x, int displ_y, int displ_z,
+                           int data_dim_x, int data_dim_y, int data_dim_z);
+
+    /**
+     * This function defines how a set of spheres has to be integrated into a discrete space
+     * (each sphere is filled as one run per x-row, see sphereRun),
+     * it runs on the backend resolved for the rows of the spheres
+     * @param data The base data on which the function integrate the spheres
+     * @param centers_x X coordinates of the sphere centers
+     * @param centers_y Y coordinates of the sphere centers
+     * @param centers_z Z coordinates of the sphere centers
+     * @param n_spheres The number of spheres
+     * @param radius The radius of the spheres, in voxels
+     * @param data_dim_x The base data X dimension
+     * @param data_dim_y The base data Y dimension
+     * @param data_dim_z The base data Z dimension
+     */
+    static void stampSpheres(MoleculeMesh::data_t *data,
+                             const double *centers_x, const double *centers_y, const double *centers_z,
+                             size_t n_spheres, double radius,
+                             int data_dim_x, int data_dim_y, int data_dim_z);
 };
 
 #endif //PROLIF_COLORING_MESH
@@ -0,0 +1,122 @@
+#ifndef PROLIF_COLORING_MESH_IO
+#define PROLIF_COLORING_MESH_IO
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Mesh.hpp"
+#include "LabelMesh.hpp"
+#include "OccupancyMap.hpp"
+
+/**
+ * This class allow to save and load a MoleculeMesh in a compact binary format (.grid), written straight from the
+ * mesh data without any intermediate molecule.
+ *
+ * The file is made of a fixed header followed by the voxel payload (all values little-endian):
+ *      char[4]  magic "PLCG"
+ *      uint32   format version
+ *      int32    dim_x, dim_y, dim_z
+ *      float64  globalDisplacement x, y, z
+ *      int32    internalDisplacement
+ *      int32    grain (voxels per unit of length)
+ *      uint32   payload encoding (0: packed bits, 1: run-length)
+ *      uint64   payload size in bytes
+ *
+ * Packed bits payload: the mesh data words (uint64), each x-row packed into ceil(dim_x / 64) words,
+ * voxel x of a row is bit (x % 64) of word (x / 64), rows ordered by z then y.
+ * Run-length payload: uint32 lengths of alternating empty/set voxel runs (starting with an empty one) over the
+ * voxels ordered by z, then y, then x.
+ *
+ * A voxel (x, y, z) is centered at: (x - internalDisplacement) / grain + globalDisplacement.x (same for y, z)
+ *
+ * Meshes can also be exported to the volumetric formats read by molecular viewers (MRC/CCP4 maps and OpenDX grids),
+ * with voxel spacing 1 / grain and origin at the center of voxel (0, 0, 0), grain is the one of the saved mesh.
+ */
+class MeshIO {
+public:
+    /**
+     * The available payload encodings
+     */
+    enum Encoding : uint32_t {
+        PACKED_BITS = 0,
+        RUN_LENGTH = 1
+    };
+
+    /**
+     * This function saves a mesh in the binary format, using the smaller of the two encodings
+     * @param mesh The mesh to save
+     * @param path The output file path (the grain stored is the mesh one)
+     * @return The number of bytes written
+     */
+    static size_t writeBinary(const MoleculeMesh &mesh, const std::string &path);
+
+    /**
+     * This function loads a mesh saved in the binary format
+     * @param path The input file path
+     * @param grain If not null, it receives the number of voxels per unit of length of the mesh
+     * @return The loaded mesh (at the grain stored in the file)
+     * @throws std::runtime_error if the file cannot be read or is not a valid grid file
+     */
+    static std::unique_ptr<MoleculeMesh> readBinary(const std::string &path, int *grain = nullptr);
+
+    /**
+     * This function saves a mesh as an MRC/CCP4 map (mode 0, voxel values 0/1)
+     * @param mesh The mesh to save
+     * @param path The output file path
+     * @return The number of bytes written
+     */
+    static size_t writeMRC(const MoleculeMesh &mesh, const std::string &path);
+
+    /**
+     * This function saves a set of meshes as a single multi-channel MRC/CCP4 map (mode 1), each voxel value is the
+     * bitmask of the channels containing it (bit i set if the voxel is set in the i-th mesh),
+     * channel names are stored in the map labels
+     * @param channels The list-map: channel name <--> channel mesh (all meshes must share dims and displacements)
+     * @param path The output file path
+     * @return The number of bytes written
+     */
+    static size_t writeMRC(const std::vector<std::pair<std::string, const MoleculeMesh *>> &channels,
+                           const std::string &path);
+
+    /**
+     * This function saves a labeled mesh as a single multi-channel MRC/CCP4 map (mode 1), each voxel value is its label,
+     * channel names are stored in the map labels
+     * @param mesh The labeled mesh to save
+     * @param names The channel names (the i-th name describes bit i of the labels)
+     * @param path The output file path
+     * @return The number of bytes written
+     */
+    static size_t writeMRC(const LabelMesh &mesh, const std::vector<std::string> &names, const std::string &path);
+
+    /**
+     * This function saves a mesh as an OpenDX scalar grid (voxel values 0/1)
+     * @param mesh The mesh to save
+     * @param path The output file path
+     * @return The number of bytes written
+     */
+    static size_t writeDX(const MoleculeMesh &mesh, const std::string &path);
+
+    /**
+     * This function saves an occupancy map as an MRC/CCP4 density map (mode 2), each voxel value is the fraction of
+     * the frames covering it, the number of frames is stored in the map labels
+     * @param map The occupancy map to save
+     * @param frames The number of frames accumulated into the map
+     * @param path The output file path
+     * @return The number of bytes written
+     */
+    static size_t writeMRC(const OccupancyMap &map, size_t frames, const std::string &path);
+
+    /**
+     * This function saves an occupancy map as an OpenDX scalar grid, each voxel value is the fraction of the frames
+     * covering it
+     * @param map The occupancy map to save
+     * @param frames The number of frames accumulated into the map
+     * @param path The output file path
+     * @return The number of bytes written
+     */
+    static size_t writeDX(const OccupancyMap &map, size_t frames, const std::string &path);
+};
+
+#endif //PROLIF_COLORING_MESH_IO
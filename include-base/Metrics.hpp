@@ -0,0 +1,229 @@
+#ifndef PROLIF_COLORING_METRICS
+#define PROLIF_COLORING_METRICS
+
+#include <atomic>
+#include <cstddef>
+#include <ctime>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * This class collects the instrumentation of the processing of a molecule: the time spent in each stage and the
+ * counters of the work done. Every thread accumulates into its own instance (see local()), the pipeline clears it
+ * before each molecule and copies it into the results, batches merge the instances of all their molecules.
+ * The instrumentation is off by default, and while off timers and counters are no-ops
+ */
+class Metrics {
+public:
+    /**
+     * The timed stages, the time of a stage excludes the one of the stages nested into it
+     *      - DISCRETIZE: discretization of the molecule (and its mask model)
+     *      - MATCH: substructure matching of the match-patterns
+     *      - STENCIL: generation of the patterns of the interactions
+     *      - STAMP: integration of the patterns into the interaction meshes
+     *      - SUBTRACT: subtraction of the molecule from the interaction meshes
+     *      - SINTETIZE: generation of the molecules of set voxels (PDB output)
+     *      - WRITE: output files
+     */
+    enum Stage {
+        DISCRETIZE,
+        MATCH,
+        STENCIL,
+        STAMP,
+        SUBTRACT,
+        SINTETIZE,
+        WRITE,
+        N_STAGES
+    };
+
+    /**
+     * The counters
+     *      - MATCHES: matches of the match-patterns found
+     *      - STENCILS_BUILT: patterns generated (spherical, conic and ring ones)
+     *      - VOXELS_STAMPED: voxels set by the integration of the patterns
+     *      - VOXELS_SUBTRACTED: voxels unset by the subtraction of the molecule
+     *      - BYTES_WRITTEN: size of the output files
+     *      - PEAK_MESH_BYTES: largest memory held at once by the meshes of a molecule
+     */
+    enum Counter {
+        MATCHES,
+        STENCILS_BUILT,
+        VOXELS_STAMPED,
+        VOXELS_SUBTRACTED,
+        BYTES_WRITTEN,
+        PEAK_MESH_BYTES,
+        N_COUNTERS
+    };
+
+    /**
+     * The instrumentation of a single interaction
+     */
+    struct InteractionEntry {
+        std::string name;
+        double seconds = 0;
+        size_t matches = 0;
+        size_t voxelsStamped = 0;
+        size_t voxelsSubtracted = 0;
+    };
+
+    /**
+     * The seconds spent in each stage, and the number of times each stage has been entered
+     */
+    double seconds[N_STAGES] = {};
+    size_t calls[N_STAGES] = {};
+
+    /**
+     * The counters values
+     */
+    size_t counters[N_COUNTERS] = {};
+
+    /**
+     * The instrumentation of each interaction, in calculation order
+     */
+    std::vector<InteractionEntry> interactions;
+
+private:
+    /**
+     * If True the instrumentation is collected
+     */
+    static std::atomic<bool> enabled;
+
+    /**
+     * The seconds spent in the stages nested into the innermost running timer
+     */
+    double nestedSeconds = 0;
+
+public:
+    /**
+     * This function enables (or disables) the instrumentation of the whole process
+     * @param enable True to collect the instrumentation
+     */
+    static void setEnabled(bool enable) {
+        enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    /**
+     * This function returns if the instrumentation is collected
+     * @return
+     */
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * This function returns the instrumentation of the calling thread
+     * @return The instrumentation of the calling thread
+     */
+    static Metrics &local();
+
+    /**
+     * This function adds a value to a counter of the calling thread
+     * @param counter The counter
+     * @param value The value to add
+     */
+    static void count(Counter counter, size_t value) {
+        if (isEnabled()) local().counters[counter] += value;
+    }
+
+    /**
+     * This function raises a counter of the calling thread to a value, if it is larger
+     * @param counter The counter
+     * @param value The candidate value
+     */
+    static void peak(Counter counter, size_t value) {
+        if (!isEnabled()) return;
+        size_t &current = local().counters[counter];
+        if (value > current) current = value;
+    }
+
+    /**
+     * This function resets all stages and counters
+     */
+    void clear();
+
+    /**
+     * This function accumulates another instrumentation into this one (peak counters keep the largest value,
+     * interactions with the same name are summed)
+     * @param other The instrumentation to accumulate
+     */
+    void merge(const Metrics &other);
+
+    /**
+     * This function returns the total seconds spent in all stages
+     * @return
+     */
+    double getTotalSeconds() const;
+
+    /**
+     * This function writes the instrumentation as a JSON object
+     * @param out The output stream
+     * @param indent The indentation of the object members
+     */
+    void writeJSON(std::ostream &out, int indent = 2) const;
+
+    /**
+     * This function returns the name of a stage
+     * @param stage The stage
+     * @return The name used in the JSON output
+     */
+    static const char *name(Stage stage);
+
+    /**
+     * This function returns the name of a counter
+     * @param counter The counter
+     * @return The name used in the JSON output
+     */
+    static const char *name(Counter counter);
+
+    /**
+     * This function writes a string as a JSON string literal
+     * @param out The output stream
+     * @param value The string
+     */
+    static void writeJSONString(std::ostream &out, const std::string &value);
+
+    /**
+     * This class accounts the lifetime of a scope to a stage of the calling thread, the time of timers nested
+     * into it is accounted to their own stages only
+     */
+    class Timer {
+    private:
+        Metrics *metrics;
+        Stage stage;
+        timespec startTime;
+        double outerNestedSeconds;
+
+    public:
+        explicit Timer(Stage stage);
+
+        ~Timer();
+
+        Timer(const Timer &) = delete;
+
+        Timer &operator=(const Timer &) = delete;
+    };
+
+    /**
+     * This class records the lifetime of the calculation of an interaction, and the matches and voxels counted
+     * meanwhile, as an interaction entry of the calling thread
+     */
+    class InteractionScope {
+    private:
+        Metrics *metrics;
+        const std::string &name;
+        timespec startTime;
+        size_t startMatches, startStamped, startSubtracted;
+
+    public:
+        explicit InteractionScope(const std::string &name);
+
+        ~InteractionScope();
+
+        InteractionScope(const InteractionScope &) = delete;
+
+        InteractionScope &operator=(const InteractionScope &) = delete;
+    };
+};
+
+#endif //PROLIF_COLORING_METRICS
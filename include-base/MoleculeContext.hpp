@@ -0,0 +1,72 @@
+#ifndef PROLIF_COLORING_MOLECULE_CONTEXT
+#define PROLIF_COLORING_MOLECULE_CONTEXT
+
+#include <memory_resource>
+#include <vector>
+#include <GraphMol/GraphMol.h>
+
+/**
+ * This class defines a molecule conformer prepared for discretization and interactions calculation:
+ * the atom coordinates are extracted once into a structure-of-arrays block (x[], y[], z[] indexed by atom id),
+ * shared by the discretization and by every interaction, so that none of them has to copy the conformer
+ */
+class MoleculeContext {
+public:
+    /**
+     * The molecule the context is prepared for (its topology is used for the pattern matching)
+     */
+    const RDKit::ROMol &molecule;
+
+    /**
+     * The conformer the coordinates are extracted from (-1 means the default one)
+     */
+    const int confId;
+
+    /**
+     * The atom coordinates, the i-th entry of each array belongs to the atom of id i
+     */
+    std::pmr::vector<double> x, y, z;
+
+    /**
+     * This constructor extracts the atom coordinates of a conformer of the molecule
+     * @param molecule The input molecule (it must outlive the context)
+     * @param confId The conformer of the molecule to use (-1 means the default one)
+     * @param resource The memory resource the coordinates are allocated from (e.g. the ScratchArena of the molecule)
+     */
+    explicit MoleculeContext(const RDKit::ROMol &molecule, int confId = -1,
+                             std::pmr::memory_resource *resource = std::pmr::get_default_resource()) :
+            molecule(molecule), confId(confId), x(resource), y(resource), z(resource) {
+        const std::vector<RDGeom::Point3D> &positions = molecule.getConformer(confId).getPositions();
+        x.resize(positions.size());
+        y.resize(positions.size());
+        z.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); ++i) {
+            x[i] = positions[i].x;
+            y[i] = positions[i].y;
+            z[i] = positions[i].z;
+        }
+    }
+
+    MoleculeContext(const MoleculeContext &) = delete;
+
+    MoleculeContext &operator=(const MoleculeContext &) = delete;
+
+    /**
+     * This function returns the number of atoms of the context
+     * @return
+     */
+    inline size_t getNumAtoms() const {
+        return x.size();
+    }
+
+    /**
+     * This function returns the position of an atom
+     * @param atomId The atom id
+     * @return The position of the atom
+     */
+    inline RDGeom::Point3D getAtomPos(int atomId) const {
+        return RDGeom::Point3D(x[atomId], y[atomId], z[atomId]);
+    }
+};
+
+#endif //PROLIF_COLORING_MOLECULE_CONTEXT
@@ -0,0 +1,67 @@
+#ifndef PROLIF_COLORING_MOLECULE_READER
+#define PROLIF_COLORING_MOLECULE_READER
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include "GraphMol/GraphMol.h"
+#include "GraphMol/FileParsers/MolSupplier.h"
+
+/**
+ * This class reads, one record at a time, the molecules of a multi-model .pdb or a multi-record .sdf file,
+ * so that only the record being parsed is kept in memory whatever the size of the file
+ */
+class MoleculeReader {
+private:
+    /**
+     * The input format, chosen by file extension (.sdf/.mol are read as SDF, anything else as PDB)
+     */
+    bool sdf;
+
+    /**
+     * The PDB input stream
+     */
+    std::ifstream pdbStream;
+
+    /**
+     * The SDF record supplier
+     */
+    std::unique_ptr<RDKit::SDMolSupplier> sdfSupplier;
+
+    /**
+     * The number of records read so far
+     */
+    size_t records = 0;
+
+    /**
+     * This function reads the next MODEL/ENDMDL block of the PDB stream (or the whole file if it has no models)
+     * @param block The text of the read block
+     * @return False if no other block is available, True otherwise
+     */
+    bool nextPDBBlock(std::string &block);
+
+public:
+    /**
+     * This constructor opens the input file
+     * @param path The path of the input file
+     * @throws std::runtime_error if the file cannot be opened
+     */
+    explicit MoleculeReader(const std::string &path);
+
+    /**
+     * This function reads the next record of the input file
+     * @param molecule The parsed molecule (null if the record could not be parsed)
+     * @return False if no other record is available, True otherwise
+     */
+    bool next(std::unique_ptr<RDKit::ROMol> &molecule);
+
+    /**
+     * This function returns the number of records read so far
+     * @return
+     */
+    inline size_t getRecordCount() const {
+        return records;
+    }
+};
+
+#endif //PROLIF_COLORING_MOLECULE_READER
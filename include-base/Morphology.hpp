@@ -0,0 +1,163 @@
+#ifndef PROLIF_COLORING_MORPHOLOGY
+#define PROLIF_COLORING_MORPHOLOGY
+
+#include <cstdint>
+#include <vector>
+#include "Mesh.hpp"
+
+/**
+ * This class defines the morphological operations of a MoleculeMesh with a spherical structuring element (the voxels
+ * within a radius from the center one): dilation, erosion, opening and closing.
+ * Instead of stamping one inflated sphere per set voxel, the sphere is decomposed into x-runs, one per (y, z) offset
+ * within the radius: every x-row of the mesh is widened once per run length by shifted-word ORs (ANDs for an
+ * erosion), and each row of the result combines the widened rows at the offsets of the runs, a packed word at a time.
+ * Larger radii, whose runs outnumber the cost of a voxel of a distance transform, threshold the exact squared
+ * euclidean distance transform of the mesh instead (see DistanceTransform): the distances along x are read straight
+ * from the packed words of each x-row, the ones along y and z are the separable lower-envelope passes.
+ * The voxels out of the mesh are empty: a dilation drops the voxels it would set out of the mesh, an erosion clears
+ * the voxels within the radius from the mesh boundary
+ */
+class Morphology {
+public:
+    /**
+     * An x-run of the sphere: the voxels of the row at a (y, z) offset from the center within the radius
+     */
+    struct Run {
+        /**
+         * The Y and Z offsets of the row from the center
+         */
+        int dy, dz;
+
+        /**
+         * The index of the run length (half of it, the center excluded) into the lengths of the sphere
+         */
+        int level;
+    };
+
+private:
+    /**
+     * The estimated work of the distance transform of a voxel, in passes over a packed word
+     */
+    static constexpr size_t transformCost = 12;
+
+    /**
+     * The serial implementation of transform() by distance transform, see Backend
+     */
+    static void transformSerial(MoleculeMesh &mesh, double scaledRadius, bool erode);
+
+    /**
+     * The OpenMP implementation of transform() by distance transform, see Backend
+     */
+    static void transformOmp(MoleculeMesh &mesh, double scaledRadius, bool erode);
+
+    /**
+     * The serial implementation of transform() by widened rows, see Backend
+     */
+    static void combineSerial(MoleculeMesh &mesh, const std::vector<Run> &runs, const std::vector<int> &widths,
+                              bool erode);
+
+    /**
+     * The OpenMP implementation of transform() by widened rows, see Backend
+     */
+    static void combineOmp(MoleculeMesh &mesh, const std::vector<Run> &runs, const std::vector<int> &widths,
+                           bool erode);
+
+    /**
+     * This function dilates or erodes a mesh, on the backend resolved for the rows of the mesh, by widened rows or
+     * by distance transform (whichever has the lower estimated work): the seeds of the transform are the set voxels
+     * (dilation) or the empty ones, out of the mesh too (erosion), and the voxels set are the ones within the radius
+     * from a seed (dilation) or beyond it (erosion)
+     * @param mesh The mesh, replaced by the result
+     * @param scaledRadius The radius of the structuring element, in voxels
+     * @param erode If True the mesh is eroded, otherwise it is dilated
+     */
+    static void transform(MoleculeMesh &mesh, double scaledRadius, bool erode);
+
+public:
+    /**
+     * This function dilates a mesh: the voxels within a radius from a set voxel are set
+     * @param mesh The mesh, replaced by the result
+     * @param radius The radius of the structuring element, in units of length
+     */
+    static void dilate(MoleculeMesh &mesh, double radius);
+
+    /**
+     * This function erodes a mesh: the voxels within a radius from an empty voxel are cleared
+     * @param mesh The mesh, replaced by the result
+     * @param radius The radius of the structuring element, in units of length
+     */
+    static void erode(MoleculeMesh &mesh, double radius);
+
+    /**
+     * This function opens a mesh (an erosion followed by a dilation): the parts of the mesh a sphere of the radius
+     * cannot fit into are cleared
+     * @param mesh The mesh, replaced by the result
+     * @param radius The radius of the structuring element, in units of length
+     */
+    static void open(MoleculeMesh &mesh, double radius);
+
+    /**
+     * This function closes a mesh (a dilation followed by an erosion): the gaps and crevices a sphere of the radius
+     * cannot enter are set
+     * @param mesh The mesh, replaced by the result
+     * @param radius The radius of the structuring element, in units of length
+     */
+    static void close(MoleculeMesh &mesh, double radius);
+
+    /**
+     * This function decomposes a sphere into its x-runs
+     * @param scaledRadius The radius, in voxels
+     * @param runs The x-runs of the sphere, one per (y, z) offset
+     * @param widths The distinct half lengths of the runs (the levels of the runs)
+     */
+    static void sphereRuns(double scaledRadius, std::vector<Run> &runs, std::vector<int> &widths);
+
+    /**
+     * This function widens an x-row: each voxel takes the OR (AND for an erosion) of the voxels of the row within a
+     * distance from it, the voxels out of the row being empty
+     * @param row The mesh row
+     * @param out The widened row (the padding bits past the row may be set by a dilation)
+     * @param words_x The number of data words of the row
+     * @param width The distance, in voxels
+     * @param erode If True the voxels are ANDed, otherwise ORed
+     */
+    static void widenRow(const MoleculeMesh::data_t *row, MoleculeMesh::data_t *out, int words_x, int width,
+                         bool erode);
+
+    /**
+     * This function combines the widened rows at the offsets of the x-runs of a sphere into an x-row of a mesh,
+     * the rows out of the mesh being empty
+     * @param widened The widened rows of the mesh, one mesh data block per level
+     * @param mesh The mesh the result is written into
+     * @param runs The x-runs of the sphere
+     * @param y Y discrete coordinate of the row
+     * @param z Z discrete coordinate of the row
+     * @param erode If True the widened rows are ANDed, otherwise ORed
+     */
+    static void combineRow(const MoleculeMesh::data_t *widened, MoleculeMesh &mesh, const std::vector<Run> &runs,
+                           int y, int z, bool erode);
+
+    /**
+     * This function calculates the squared distances along x of the voxels of an x-row from the nearest seed of the
+     * row, scanning the packed words of the row
+     * @param row The mesh row
+     * @param dim_x The number of voxels of the row
+     * @param erode If True the seeds are the empty voxels and the ones out of the row, otherwise the set voxels
+     * @param ds The squared radius, in voxels (farther distances are left at infinity)
+     * @param f The squared distances of the dim_x voxels of the row
+     * @return False if the row has no seeds (all the distances are infinity)
+     */
+    static bool seedRow(const MoleculeMesh::data_t *row, int dim_x, bool erode, double ds, int32_t *f);
+
+    /**
+     * This function packs the result of a dilation or an erosion into an x-row of a mesh
+     * @param f The squared distances of the dim_x voxels of the row
+     * @param row The mesh row, overwritten
+     * @param dim_x The number of voxels of the row
+     * @param erode If True the voxels beyond the radius are set, otherwise the ones within it
+     * @param ds The squared radius, in voxels
+     */
+    static void writeRow(const int32_t *f, MoleculeMesh::data_t *row, int dim_x, bool erode, double ds);
+};
+
+#endif //PROLIF_COLORING_MORPHOLOGY
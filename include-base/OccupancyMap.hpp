@@ -0,0 +1,178 @@
+#ifndef PROLIF_COLORING_OCCUPANCY_MAP
+#define PROLIF_COLORING_OCCUPANCY_MAP
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include "Geometry/point.h"
+#include "Mesh.hpp"
+#include "LabelMesh.hpp"
+#include "SparseMesh.hpp"
+
+/**
+ * This class defines the occupancy of a discrete space over the frames of a trajectory (or the poses of an ensemble):
+ * each voxel counts the frames whose mesh sets it, so that count / frames is the fraction of frames the voxel is
+ * covered in.
+ * Meshes of any frame are aligned on the common lattice of their grain (voxel (x, y, z) of a mesh is lattice point
+ * (x - internalDisplacement + globalDisplacement.x * grain, ...), since global displacements are whole units of
+ * length), and the map grows to the union of the boxes of the meshes added
+ */
+class OccupancyMap {
+public:
+    /**
+     * The type of the voxel count (wide enough for the frames of long trajectories)
+     */
+    typedef uint32_t count_t;
+
+private:
+    /**
+     * The data structure that contains the voxel counts (x-rows ordered by z then y)
+     */
+    std::vector<count_t> counts;
+
+    /**
+     * The 3D sizes of the map
+     */
+    int dim_x = 0, dim_y = 0, dim_z = 0;
+
+    /**
+     * The lattice point of voxel (0, 0, 0) of the map
+     */
+    int origin_x = 0, origin_y = 0, origin_z = 0;
+
+    /**
+     * This function returns the lattice point of voxel 0 of a discrete space along an axis
+     */
+    static inline int latticeOrigin(double globalDisplacement, int internalDisplacement, int grain) {
+        return static_cast<int>(lround(globalDisplacement * grain)) - internalDisplacement;
+    }
+
+    /**
+     * This function grows the map (keeping its counts) so that it contains a box of lattice points
+     * @param begin_x The first X lattice point of the box
+     * @param begin_y The first Y lattice point of the box
+     * @param begin_z The first Z lattice point of the box
+     * @param size_x The X size of the box
+     * @param size_y The Y size of the box
+     * @param size_z The Z size of the box
+     */
+    void fit(int begin_x, int begin_y, int begin_z, int size_x, int size_y, int size_z);
+
+    /**
+     * This function grows the map so that it contains a discrete space, and returns the offset of the voxels of
+     * the space into the map, any discrete space type (MoleculeMesh, SparseMesh, LabelMesh) is accepted
+     */
+    template<typename Mesh>
+    void fit(const Mesh &mesh, int &offset_x, int &offset_y, int &offset_z);
+
+    /**
+     * This function returns the counts of an x-row of the map
+     */
+    inline count_t *row(int y, int z) {
+        return &counts[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y)];
+    }
+
+public:
+    /**
+     * The number of voxels per unit of length of the map (and of the meshes it accumulates)
+     */
+    const int grain;
+
+    /**
+     * This constructor initialize an empty map
+     * @param grain The number of voxels per unit of length of the meshes to accumulate
+     */
+    explicit OccupancyMap(int grain = GRAIN) : grain(grain) {}
+
+    /**
+     * This function adds a frame mesh to the map, counting one for each of its set voxels
+     * @param mesh The mesh, at the grain of the map
+     * @throws std::runtime_error if the mesh grain is not the one of the map
+     */
+    void add(const MoleculeMesh &mesh);
+
+    /**
+     * This function adds a sparse frame mesh to the map, counting one for each of its set voxels
+     * @param mesh The mesh, at the grain of the map
+     * @throws std::runtime_error if the mesh grain is not the one of the map
+     */
+    void add(const SparseMesh &mesh);
+
+    /**
+     * This function adds a channel of a labeled frame mesh to the map, counting one for each voxel having it
+     * @param mesh The labeled mesh, at the grain of the map
+     * @param channel The channel (label bit) to count
+     * @throws std::runtime_error if the mesh grain is not the one of the map
+     */
+    void add(const LabelMesh &mesh, int channel);
+
+    /**
+     * This function adds the counts of another map (covering other frames) to this one
+     * @param other The map to merge, at the grain of this one
+     * @throws std::runtime_error if the grains differ
+     */
+    void merge(const OccupancyMap &other);
+
+    /**
+     * This function returns the number of frames covering a voxel
+     * @param x X discrete coordinates (in the map)
+     * @param y Y discrete coordinates (in the map)
+     * @param z Z discrete coordinates (in the map)
+     * @return The count at (X,Y,Z) discrete position in the map
+     */
+    inline count_t at(int x, int y, int z) const {
+        return counts[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y) + x];
+    }
+
+    /**
+     * This function returns the counts of the map (x-rows ordered by z then y)
+     * @return
+     */
+    inline const count_t *getData() const {
+        return counts.data();
+    }
+
+    /**
+     * These functions return the 3D sizes of the map (they grow as meshes are added)
+     * @return
+     */
+    inline int getDimX() const {
+        return dim_x;
+    }
+
+    inline int getDimY() const {
+        return dim_y;
+    }
+
+    inline int getDimZ() const {
+        return dim_z;
+    }
+
+    /**
+     * This function returns the position of the center of voxel (0, 0, 0) of the map
+     * @return
+     */
+    inline RDGeom::Point3D getOrigin() const {
+        return {static_cast<double>(origin_x) / grain,
+                static_cast<double>(origin_y) / grain,
+                static_cast<double>(origin_z) / grain};
+    }
+
+    /**
+     * This function returns if no mesh has been added to the map yet
+     * @return
+     */
+    inline bool empty() const {
+        return counts.empty();
+    }
+
+    /**
+     * This function returns the number of bytes the map is made of
+     * @return
+     */
+    inline size_t getMemoryUsage() const {
+        return counts.size() * sizeof(count_t);
+    }
+};
+
+#endif //PROLIF_COLORING_OCCUPANCY_MAP
@@ -0,0 +1,384 @@
+#ifndef PROLIF_COLORING_PIPELINE
+#define PROLIF_COLORING_PIPELINE
+
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+#include "GraphMol/GraphMol.h"
+#include "Mesh.hpp"
+#include "LabelMesh.hpp"
+#include "SparseMesh.hpp"
+#include "OccupancyMap.hpp"
+#include "InteractionCollection.hpp"
+#include "MoleculeReader.hpp"
+#include "MoleculeContext.hpp"
+#include "Metrics.hpp"
+
+/**
+ * This class defines the processing steps of a molecule (discretization, interactions calculation, output)
+ * and the streaming pipeline that runs them concurrently over all the records of an input file
+ */
+class Pipeline {
+public:
+    /**
+     * The available output formats of discrete molecules and interactions
+     *      - PDB: one hydrogen atom per set voxel (.pdb)
+     *      - GRID: compact binary voxel grid, see MeshIO (.grid)
+     *      - MRC: MRC/CCP4 map (.mrc)
+     *      - DX: OpenDX grid (.dx)
+     *      - MRC_CHANNELS: MRC/CCP4 map of the molecule and a single multi-channel map of all interactions (.mrc)
+     */
+    enum OutputFormat {
+        PDB,
+        GRID,
+        MRC,
+        DX,
+        MRC_CHANNELS
+    };
+
+    /**
+     * The available models of the discrete molecule, the mask subtracted from the interactions
+     *      - VDW: spheres of the standard atom radius around the atoms
+     *      - SAS: solvent-accessible, the atom spheres dilated by the probe radius
+     *      - SES: solvent-excluded, the atom spheres closed by the probe radius (the crevices the probe cannot
+     *        enter are filled)
+     */
+    enum MaskModel {
+        VDW,
+        SAS,
+        SES
+    };
+
+    /**
+     * The processing options of a molecule
+     */
+    struct Options {
+        /**
+         * The output format of discrete molecules and interactions
+         */
+        OutputFormat format;
+
+        /**
+         * If True all interactions are merged into a single labeled mesh (one channel per interaction)
+         * and the molecule is subtracted once, instead of producing one mesh per interaction
+         */
+        bool labeled;
+
+        /**
+         * If True every conformer of a molecule is processed, otherwise only the default one
+         */
+        bool allConformers;
+
+        /**
+         * If True (and every conformer is processed) the conformers are the frames of a trajectory: the meshes of a
+         * conformer are updated from the ones of the previous conformer, stamping again only the atoms and the
+         * matches that moved (see TrajectoryMesh)
+         */
+        bool incremental;
+
+        /**
+         * If True the interaction meshes are kept as sparse meshes once calculated, so that the memory held by
+         * the results scales with the volume of the interactions instead of the volume of the molecule box
+         */
+        bool sparse;
+
+        /**
+         * The number of voxels per unit of length of the discrete molecule and interactions
+         */
+        int grain;
+
+        /**
+         * The model of the discrete molecule subtracted from the interactions (and saved as the molecule)
+         */
+        MaskModel mask;
+
+        /**
+         * The radius of the solvent probe of the SAS and SES models, in units of length
+         */
+        double probeRadius;
+
+        /**
+         * This constructor initialize the default options
+         * (PDB output, one dense mesh per interaction, default conformer, default grain, van der Waals mask)
+         */
+        Options() : format(PDB), labeled(false), allConformers(false), incremental(false), sparse(false),
+                    grain(GRAIN), mask(VDW), probeRadius(1.4) {}
+    };
+
+    /**
+     * The discrete results of a processed molecule
+     */
+    struct Result {
+        /**
+         * The name of the molecule, used to identify its output files
+         */
+        std::string name;
+
+        /**
+         * The conformer the results are calculated on (-1 means the default one)
+         */
+        int confId = -1;
+
+        /**
+         * The discrete molecule
+         */
+        std::unique_ptr<MoleculeMesh> moleculeMesh;
+
+        /**
+         * The discrete interactions found on the molecule: Interaction-ID <--> interaction-mesh
+         */
+        std::vector<std::pair<std::string, std::unique_ptr<MoleculeMesh>>> interactionMeshes;
+
+        /**
+         * The discrete interactions found on the molecule, in sparse form (sparse mode only, interactionMeshes is
+         * left empty): Interaction-ID <--> interaction-mesh
+         */
+        std::vector<std::pair<std::string, std::unique_ptr<SparseMesh>>> sparseMeshes;
+
+        /**
+         * The labeled mesh of all interactions (labeled mode only, interactionMeshes is left empty)
+         */
+        std::unique_ptr<LabelMesh> labelMesh;
+
+        /**
+         * The names of the labeled mesh channels (the i-th name describes bit i of the labels)
+         */
+        std::vector<std::string> labelNames;
+
+        /**
+         * The instrumentation of the calculation of the results (empty if metrics are not collected, see Metrics)
+         */
+        Metrics metrics;
+    };
+
+    /**
+     * The occupancy of the discrete molecule and interactions over the frames of an ensemble (the conformers of a
+     * molecule, or the records of a multi-model input), frames are added by the workers into their own occupancy
+     * and the occupancies of the workers are merged at the end
+     */
+    struct Occupancy {
+        /**
+         * The number of frames added
+         */
+        size_t frames = 0;
+
+        /**
+         * The occupancy of the discrete molecule
+         */
+        OccupancyMap moleculeMap;
+
+        /**
+         * The occupancy of the discrete interactions: Interaction-ID <--> occupancy map (one per interaction,
+         * in the order of the interaction list)
+         */
+        std::vector<std::pair<std::string, OccupancyMap>> interactionMaps;
+
+        /**
+         * This constructor initialize an empty occupancy of the interactions
+         * @param interactions The interactions to accumulate
+         * @param grain The number of voxels per unit of length of the frames
+         */
+        Occupancy(const InteractionCollection::list_t &interactions, int grain);
+
+        /**
+         * This function adds the discrete results of a frame (any of their forms: dense, sparse or labeled)
+         * @param result The discrete results of the frame
+         */
+        void add(const Result &result);
+
+        /**
+         * This function adds the frames of another occupancy of the same interactions
+         * @param other The occupancy to merge
+         */
+        void merge(const Occupancy &other);
+    };
+
+    /**
+     * This function returns the seconds elapsed between two timestamps
+     */
+    static double elapsedTime(const timespec &startTime, const timespec &endTime);
+
+    /**
+     * This function discretizes a molecule and calculates all the interactions on it
+     * @param molecule The input molecule
+     * @param interactions The interactions to calculate
+     * @param options The processing options
+     * @param verbose If True the progress of each step is printed
+     * @param confId The conformer of the molecule to use (-1 means the default one)
+     * @return The discrete results
+     */
+    static std::unique_ptr<Result> compute(const RDKit::ROMol &molecule, const InteractionCollection::list_t &interactions,
+                                           const Options &options = Options(), bool verbose = false,
+                                           int confId = -1);
+
+    /**
+     * This function discretizes a molecule and calculates all the interactions on it, for every conformer if
+     * required by options (matches are computed once, since conformers share the molecule topology)
+     * @param molecule The input molecule
+     * @param interactions The interactions to calculate
+     * @param options The processing options
+     * @param verbose If True the progress of each step is printed
+     * @return The discrete results, one per processed conformer
+     */
+    static std::vector<std::unique_ptr<Result>> computeAll(const RDKit::ROMol &molecule,
+                                                           const InteractionCollection::list_t &interactions,
+                                                           const Options &options = Options(), bool verbose = false);
+
+    /**
+     * This function saves the discrete results of a molecule
+     * @param result The discrete results
+     * @param outDir The directory the discrete molecule and interactions are saved into
+     * @param options The processing options
+     * @param verbose If True the progress of each step is printed
+     */
+    static void write(const Result &result, const std::string &outDir, const Options &options = Options(),
+                      bool verbose = false);
+
+    /**
+     * This function saves the discrete results of all the processed conformers of a molecule, results of a
+     * conformer (unless it is the default one) are saved into <outDir>conf_<id>/
+     * if metrics are collected, the instrumentation of the molecule is saved into <outDir>metrics.json
+     * (the metrics of the calling thread are cleared, and collect the output of the molecule)
+     * @param results The discrete results
+     * @param outDir The directory the discrete molecules and interactions are saved into
+     * @param options The processing options
+     * @param verbose If True the progress of each step is printed
+     * @return The instrumentation of the calculation and the output of the molecule
+     */
+    static Metrics writeAll(const std::vector<std::unique_ptr<Result>> &results, const std::string &outDir,
+                            const Options &options = Options(), bool verbose = false);
+
+    /**
+     * This function saves the instrumentation of a batch of molecules as a JSON file
+     * @param metrics The merged instrumentation of the processed molecules
+     * @param processed The number of processed molecules
+     * @param failed The number of molecules that could not be processed
+     * @param elapsed The wall-clock seconds spent on the batch
+     * @param path The path of the JSON file
+     */
+    static void writeMetricsSummary(const Metrics &metrics, size_t processed, size_t failed, double elapsed,
+                                    const std::string &path);
+
+    /**
+     * This function processes all the records of an input file as a streaming pipeline:
+     * reader --> [queue] --> compute workers --> [queue] --> writer
+     * the queues are bounded, so memory usage does not depend on the number of records of the input file,
+     * results of the i-th record are saved into <outRoot><i>_<name>/, the metrics summary (if metrics are collected)
+     * into <outRoot>metrics_summary.json
+     * @param reader The input records reader
+     * @param interactions The interactions to calculate (shared between all workers)
+     * @param outRoot The directory the results are saved into
+     * @param options The processing options
+     * @param numWorkers The number of compute workers (0 means one per hardware thread)
+     * @param queueCapacity The maximum number of molecules waiting between two stages
+     * @return The number of records that could not be processed
+     */
+    static size_t stream(MoleculeReader &reader, const InteractionCollection::list_t &interactions,
+                         const std::string &outRoot, const Options &options = Options(),
+                         unsigned int numWorkers = 0, size_t queueCapacity = 16);
+
+    /**
+     * This function accumulates the occupancy of the conformers of a molecule (every conformer is a frame),
+     * conformers are processed concurrently by a set of workers
+     * @param molecule The input molecule
+     * @param interactions The interactions to calculate (shared between all workers)
+     * @param options The processing options (every conformer is processed, each one on its own)
+     * @param numWorkers The number of workers (0 means one per hardware thread)
+     * @return The occupancy of the molecule and of the interactions
+     */
+    static Occupancy accumulate(const RDKit::ROMol &molecule, const InteractionCollection::list_t &interactions,
+                                const Options &options = Options(), unsigned int numWorkers = 0);
+
+    /**
+     * This function accumulates the occupancy of all the records of an input file (every processed conformer of
+     * every record is a frame, records are aligned on a common lattice and are not saved one by one),
+     * as a streaming pipeline: reader --> [queue] --> compute workers, each one adding its frames into its own
+     * occupancy, the occupancies are merged once the input is over and saved into <outRoot>occupancy/
+     * @param reader The input records reader
+     * @param interactions The interactions to calculate (shared between all workers)
+     * @param outRoot The directory the occupancy maps are saved into
+     * @param options The processing options
+     * @param numWorkers The number of compute workers (0 means one per hardware thread)
+     * @param queueCapacity The maximum number of molecules waiting to be processed
+     * @return The number of records that could not be processed
+     */
+    static size_t accumulate(MoleculeReader &reader, const InteractionCollection::list_t &interactions,
+                             const std::string &outRoot, const Options &options = Options(),
+                             unsigned int numWorkers = 0, size_t queueCapacity = 16);
+
+    /**
+     * This function saves an occupancy as density maps, Molecule and one per interaction found in any frame
+     * (OpenDX grids for the DX output format, MRC/CCP4 maps otherwise)
+     * @param occupancy The occupancy to save
+     * @param outDir The directory the maps are saved into
+     * @param format The output format
+     * @param verbose If True the progress of each step is printed
+     */
+    static void writeOccupancy(const Occupancy &occupancy, const std::string &outDir, OutputFormat format,
+                               bool verbose = false);
+
+private:
+    /**
+     * The padding of the discrete molecule around its atoms, in units of length
+     */
+    static constexpr int meshPadding = 5;
+
+    /**
+     * This function returns the padding of the discrete molecule of a mask model: the probe of the SAS and SES
+     * models must not reach the mesh boundary, or the erosion of the SES would clear the voxels it reaches
+     * @param options The processing options
+     * @return The padding, in units of length
+     */
+    static int maskPadding(const Options &options);
+
+    /**
+     * This function turns the discrete molecule (atom spheres) into the one of the mask model of the options
+     * @param mesh The discrete molecule, replaced by the mask
+     * @param options The processing options
+     */
+    static void applyMask(MoleculeMesh &mesh, const Options &options);
+
+    /**
+     * This function discretizes every conformer of a molecule and calculates all the interactions on it,
+     * updating the meshes of a conformer from the ones of the previous conformer (see TrajectoryMesh)
+     * @param molecule The input molecule
+     * @param interactions The interactions to calculate
+     * @param options The processing options
+     * @param verbose If True the progress of each step is printed
+     * @return The discrete results, one per conformer
+     */
+    static std::vector<std::unique_ptr<Result>> computeIncremental(const RDKit::ROMol &molecule,
+                                                                   const InteractionCollection::list_t &interactions,
+                                                                   const Options &options, bool verbose);
+
+    /**
+     * This function calculates all the interactions of a discrete molecule into a single labeled mesh
+     * @param context The input molecule, prepared for the conformer to use
+     * @param interactions The interactions to calculate (the i-th one is channel i)
+     * @param result The discrete results holding the discrete molecule
+     * @param verbose If True the progress of each step is printed
+     */
+    static void computeLabeled(const MoleculeContext &context, const InteractionCollection::list_t &interactions,
+                               Result &result, bool verbose);
+
+    /**
+     * This function saves the sparse interaction meshes of the discrete results
+     * @param result The discrete results
+     * @param outDir The directory the discrete interactions are saved into
+     * @param format The output format
+     * @param verbose If True the progress of each step is printed
+     */
+    static void writeSparse(const Result &result, const std::string &outDir, OutputFormat format, bool verbose);
+
+    /**
+     * This function saves the labeled mesh of the discrete results
+     * @param result The discrete results
+     * @param outDir The directory the discrete interactions are saved into
+     * @param format The output format
+     * @param verbose If True the progress of each step is printed
+     */
+    static void writeLabeled(const Result &result, const std::string &outDir, OutputFormat format, bool verbose);
+};
+
+#endif //PROLIF_COLORING_PIPELINE
@@ -0,0 +1,96 @@
+#ifndef PROLIF_COLORING_RBSP_INTERACTION
+#define PROLIF_COLORING_RBSP_INTERACTION
+
+#include <GraphMol/GraphMol.h>
+#include <Interaction.hpp>
+#include "RingStencil.hpp"
+
+/**
+ * This class extends Interaction class
+ * Defines a type of interaction in which the space the interaction is acting on is where the centroid of a partner
+ * aromatic ring can be placed to stack with a ring of the molecule:
+ *      - distance(point_in_space, ring_centroid) <= reference_distance
+ *      - reference_min_angle <= angle(ring_plane, partner_plane) <= reference_max_angle
+ *      - reference_min_normal_to_centroid_angle <= angle(ring_normal, ring_centroid --> point_in_space)
+ *        <= reference_max_normal_to_centroid_angle (for the ring or the partner normal)
+ *      - (optional) the intersection of the two ring planes is near one of the centroids
+ * the partner orientation is free, see RingStencil
+ */
+class RestrictedBasePIStackingInteraction : public Interaction {
+private:
+    /**
+     * Reference distance, min/max angles and intersection radius
+     */
+    const double distance,
+            min_angle_ring, max_angle_ring,
+            min_angle_cent, max_angle_cent,
+            intersect_radius;
+
+    /**
+     * Switch that enables the ring planes intersection restriction
+     */
+    bool intersect;
+
+    /**
+     * The serial implementation of getInteraction(), see Backend
+     */
+    bool getInteractionSerial(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                              MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
+    /**
+     * The OpenMP implementation of getInteraction(), see Backend
+     */
+    bool getInteractionOmp(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                           MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
+    /**
+     * The CUDA implementation of getInteraction(), see Backend
+     */
+    bool getInteractionCuda(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                            MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
+public:
+
+    /**
+     * This constructor extends the Interaction class constructor by receiving also
+     * the reference distance, angles and intersection restriction
+     * @param distance The reference distance between ring centroids
+     * @param angle The pair <reference_min_angle, reference_max_angle> between ring planes
+     * @param normal_to_centroid_angle The pair <reference_min_angle, reference_max_angle> between a ring normal
+     * and the centroids vector
+     * @param pi_ring The input SMART definition of the aromatic ring (atoms in ring order)
+     * @param intersect If True the ring planes intersection has to be near one of the centroids
+     * @param intersect_radius The reference distance between the ring planes intersection and a centroid
+     */
+    RestrictedBasePIStackingInteraction(
+            const double distance,
+            const std::pair<double, double> angle,
+            const std::pair<double, double> normal_to_centroid_angle,
+            const std::string &pi_ring,
+            bool intersect = false,
+            double intersect_radius = 1.5) : Interaction(pi_ring),
+                                             distance(distance),
+                                             min_angle_ring(angle.first),
+                                             max_angle_ring(angle.second),
+                                             min_angle_cent(normal_to_centroid_angle.first),
+                                             max_angle_cent(normal_to_centroid_angle.second),
+                                             intersect_radius(intersect_radius),
+                                             intersect(intersect) {};
+
+    /**
+     * This function overrides the Interaction class one, it runs on the backend resolved for the rows of the
+     * patterns of its matches
+     */
+    bool getInteraction(const MoleculeContext &context, MoleculeMesh &interactionMask,
+                        MoleculeMesh &subtractionMask) override;
+
+    /**
+     * This function overrides the Interaction class one, the patterns are the ones the serial getInteraction()
+     * stamps
+     */
+    void placeMatches(const MoleculeContext &context, const std::vector<RDKit::MatchVectType> &matches,
+                      const std::vector<size_t> &sites, const MoleculeMesh &interactionMask,
+                      std::vector<MatchStamp> &stamps) override;
+};
+
+#endif //PROLIF_COLORING_RBSP_INTERACTION
@@ -0,0 +1,120 @@
+#ifndef PROLIF_COLORING_RING_STENCIL
+#define PROLIF_COLORING_RING_STENCIL
+
+#include <utility>
+#include "Geometry/point.h"
+#include "GraphMol/Substruct/SubstructMatch.h"
+#include "Mesh.hpp"
+#include "MoleculeContext.hpp"
+#include "SpanStencil.hpp"
+
+/**
+ * This class rasterizes the pattern of a pi-stacking interaction around an aromatic ring: the voxels of a sphere
+ * (centered on the ring centroid) where the centroid of a partner ring can be placed.
+ * Be n the ring normal, u the vector from the ring centroid to a voxel and theta the angle between n and u
+ * (folded into [0, 90], ring normals have no orientation), the partner ring orientation is not known, so a voxel is
+ * set if some partner orientation satisfies each restriction:
+ *      - ring-plane angle in [min_plane, max_plane] and normal-to-centroid angle in [min_cent, max_cent]
+ *        (for n or for the partner normal), that is theta in [min_cent, max_cent] or
+ *        theta in [max(min_plane - max_cent, min_cent - max_plane), max_plane + max_cent]
+ *      - if intersect is enabled, with the partner normal in the plane of n and u, the intersection line of the
+ *        two ring planes passes within intersect_radius of one of the two centroids
+ * Angles are never computed: theta bounds are compared through squared dot products (cos^2 bounds).
+ * Voxels are first classified by cells of #cellEdge^3 voxels (coarse to fine): a cell whose whole theta range lies
+ * outside both intervals is skipped at once (or set at once if it lies inside one of them and intersect is disabled),
+ * only the voxels of the mixed cells are tested one by one
+ */
+class RingStencil {
+private:
+    /**
+     * The edge of the cells voxels are classified by, in voxels
+     */
+    static constexpr int cellEdge = 4;
+
+    /**
+     * The minimum grain cells are classified at
+     */
+    static constexpr int minCellGrain = 6;
+
+    /**
+     * The spherical pattern the rings field is cut from
+     */
+    const SpanStencil &sphere;
+
+    /**
+     * The discrete center of the pattern window
+     */
+    const int scaledMaskCenter;
+
+    /**
+     * The number of voxels per unit of length
+     */
+    const int grain;
+
+    /**
+     * The two theta intervals as [cos^2(max), cos^2(min)] bounds (an empty interval has lower > upper bound)
+     */
+    double band_lower[2], band_upper[2];
+
+    /**
+     * The two theta intervals as angles, for the classification of cells
+     */
+    double theta_lower[2], theta_upper[2];
+
+    /**
+     * Intersection restriction switch and parameters (cotangents of the ring-plane angle bounds)
+     */
+    const bool intersect;
+    const double intersect_radius;
+    double cot_min_plane, cot_max_plane, sin_max_plane;
+    bool bounded_min_plane;
+
+    /**
+     * The pattern generation kernel, see build()
+     * @param grain The number of voxels per unit of length (a compile-time constant for specialized grains)
+     */
+    template<typename G>
+    void buildKernel(const RDGeom::Point3D &normal, SpanStencil &stencil, G grain) const;
+
+public:
+    /**
+     * This constructor precomputes the angle bounds of the pattern
+     * @param distance The maximum distance between ring centroids
+     * @param plane_angle The pair <min, max> of the angle between ring planes
+     * @param normal_to_centroid_angle The pair <min, max> of the angle between a ring normal and the centroids vector
+     * @param intersect If True the ring planes intersection has to pass near the centroids
+     * @param intersect_radius The maximum distance between the ring planes intersection and a centroid
+     * @param grain The number of voxels per unit of length
+     */
+    RingStencil(double distance, std::pair<double, double> plane_angle,
+                std::pair<double, double> normal_to_centroid_angle,
+                bool intersect, double intersect_radius, int grain = GRAIN);
+
+    /**
+     * This function returns the discrete center of the pattern window
+     * @return
+     */
+    inline int getCenter() const {
+        return scaledMaskCenter;
+    }
+
+    /**
+     * This function calculates centroid and unit normal (Newell's method) of a ring
+     * @param context The prepared molecule
+     * @param match The ring atoms, in ring order
+     * @param centroid The output ring centroid
+     * @param normal The output ring unit normal
+     * @return False if the ring is degenerate (less than 3 atoms or no normal), True otherwise
+     */
+    static bool ringFrame(const MoleculeContext &context, const RDKit::MatchVectType &match,
+                          RDGeom::Point3D &centroid, RDGeom::Point3D &normal);
+
+    /**
+     * This function generates the pattern of a ring, previous runs of the stencil are discarded
+     * @param normal The ring unit normal
+     * @param stencil The output pattern, its window is the sphere one (centered on the ring centroid)
+     */
+    void build(const RDGeom::Point3D &normal, SpanStencil &stencil) const;
+};
+
+#endif //PROLIF_COLORING_RING_STENCIL
@@ -0,0 +1,100 @@
+#ifndef PROLIF_COLORING_SCRATCH_ARENA
+#define PROLIF_COLORING_SCRATCH_ARENA
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+/**
+ * This class defines a per-thread monotonic memory resource for the temporaries of a molecule (topology signatures,
+ * pattern runs, ring frames, ...): allocations are bump-pointer moves into a buffer owned by the thread, deallocations
+ * are no-ops and the whole buffer is released at once between molecules.
+ * The buffer grows to the largest molecule seen by the thread, so after the first molecules no allocation
+ * reaches the system allocator anymore.
+ * Memory of the arena must only be used by the thread that owns it, and must not outlive the current molecule
+ */
+class ScratchArena : public std::pmr::memory_resource {
+private:
+    /**
+     * The initial size of the buffer
+     */
+    static constexpr size_t minCapacity = 1 << 20;
+
+    /**
+     * The buffer the temporaries are allocated into
+     */
+    std::unique_ptr<std::byte[]> buffer;
+
+    /**
+     * The size of the buffer
+     */
+    size_t capacity;
+
+    /**
+     * The bytes requested since the last reset, and the largest amount requested between two resets
+     */
+    size_t used, peak;
+
+    /**
+     * The bump allocator over the buffer (it falls back to the system allocator when the buffer is exhausted)
+     */
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void *, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    /**
+     * This constructor initialize an empty arena
+     * @param capacity The initial size of the buffer
+     */
+    explicit ScratchArena(size_t capacity = minCapacity);
+
+    ScratchArena(const ScratchArena &) = delete;
+
+    ScratchArena &operator=(const ScratchArena &) = delete;
+
+    /**
+     * This function returns the arena of the calling thread
+     * @return The arena of the calling thread
+     */
+    static ScratchArena &local();
+
+    /**
+     * This function returns the arena of the calling thread as a memory resource for pmr containers
+     * @return The arena of the calling thread
+     */
+    static std::pmr::memory_resource *resource() {
+        return &local();
+    }
+
+    /**
+     * This function releases all the temporaries of the arena at once, if the last molecule did not fit the buffer,
+     * the buffer is enlarged so that the next ones do
+     */
+    void reset();
+
+    /**
+     * This function returns the size of the buffer
+     * @return
+     */
+    inline size_t getCapacity() const {
+        return capacity;
+    }
+
+    /**
+     * This function returns the bytes requested since the last reset
+     * @return
+     */
+    inline size_t getUsed() const {
+        return used;
+    }
+};
+
+#endif //PROLIF_COLORING_SCRATCH_ARENA
@@ -4,6 +4,7 @@
 
 #include <GraphMol/GraphMol.h>
 #include <Interaction.hpp>
+#include "ConeStencil.hpp"
 
 /**
  * This class extends Interaction class
@@ -26,6 +27,25 @@ private:
      * Variable 0/1 that defines if p1 or p2 has to be used as centroid for distance calculation
      */
     int cp;
+
+    /**
+     * The serial implementation of getInteraction(), see Backend
+     */
+    bool getInteractionSerial(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                              MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
+    /**
+     * The OpenMP implementation of getInteraction(), see Backend
+     */
+    bool getInteractionOmp(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                           MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
+    /**
+     * The CUDA implementation of getInteraction(), see Backend
+     */
+    bool getInteractionCuda(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                            MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask);
+
 public:
 
     /**
@@ -49,10 +69,19 @@ public:
     };
 
     /**
-     * This function overrides the Interaction class one
+     * This function overrides the Interaction class one, it runs on the backend resolved for the rows of the
+     * patterns of its matches
+     */
+    bool getInteraction(const MoleculeContext &context, MoleculeMesh &interactionMask,
+                        MoleculeMesh &subtractionMask) override;
+
+    /**
+     * This function overrides the Interaction class one, the patterns are the ones the serial getInteraction()
+     * stamps
      */
-    bool getInteraction(const RDKit::ROMol *molecule,
-                        MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) override;
+    void placeMatches(const MoleculeContext &context, const std::vector<RDKit::MatchVectType> &matches,
+                      const std::vector<size_t> &sites, const MoleculeMesh &interactionMask,
+                      std::vector<MatchStamp> &stamps) override;
 };
 
 #endif //PROLIF_COLORING_SINGLEANGLE_INTERACTION
@@ -0,0 +1,87 @@
+#ifndef PROLIF_COLORING_SPAN_STENCIL
+#define PROLIF_COLORING_SPAN_STENCIL
+
+#include <vector>
+#include <memory_resource>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+/**
+ * This class defines a sparse pattern-mesh, described as the list of the x-runs of voxels it contains
+ * (runs are pushed ordered by Z, so that the runs of a range of rows can be looked up)
+ */
+class SpanStencil {
+public:
+    /**
+     * A run of contiguous set voxels [x_begin, x_end) on the x-row at (Y,Z)
+     */
+    struct Span {
+        int y, z, x_begin, x_end;
+    };
+
+    /**
+     * The 3D sizes of the window the pattern is defined on
+     */
+    int dim_x, dim_y, dim_z;
+
+    /**
+     * The runs the pattern is made of
+     */
+    std::pmr::vector<Span> spans;
+
+    /**
+     * This constructor initialize an empty pattern
+     * @param p_dim_x X dimension of the pattern window
+     * @param p_dim_y Y dimension of the pattern window
+     * @param p_dim_z Z dimension of the pattern window
+     * @param resource The memory resource the runs are allocated from (e.g. a ScratchArena for per-molecule patterns)
+     */
+    SpanStencil(int p_dim_x, int p_dim_y, int p_dim_z,
+                std::pmr::memory_resource *resource = std::pmr::get_default_resource()) :
+            dim_x(p_dim_x), dim_y(p_dim_y), dim_z(p_dim_z), spans(resource) {}
+
+    /**
+     * This function appends a run of voxels to the pattern, empty runs are discarded
+     * @param y Y discrete coordinates of the run
+     * @param z Z discrete coordinates of the run
+     * @param x_begin The first voxel of the run
+     * @param x_end The voxel past the last one of the run
+     */
+    inline void push(int y, int z, int x_begin, int x_end) {
+        if (x_begin < x_end) spans.push_back({y, z, x_begin, x_end});
+    }
+
+    /**
+     * This function removes all the runs of the pattern (so that it can be reused)
+     */
+    inline void clear() {
+        spans.clear();
+    }
+
+    /**
+     * This function returns the runs on the rows z_begin <= Z < z_end
+     * @param z_begin The first row
+     * @param z_end The row past the last one
+     * @return The pair <first run, run past the last one>
+     */
+    inline std::pair<const Span *, const Span *> slab(int z_begin, int z_end) const {
+        auto byZ = [](const Span &span, int z) { return span.z < z; };
+        const Span *begin = std::lower_bound(spans.data(), spans.data() + spans.size(), z_begin, byZ);
+        const Span *end = std::lower_bound(begin, spans.data() + spans.size(), z_end, byZ);
+        return {begin, end};
+    }
+
+    /**
+     * This function returns the number of voxels the pattern contains
+     * @return
+     */
+    inline size_t getVoxelCount() const {
+        size_t count = 0;
+        for (const Span &span: spans)
+            count += span.x_end - span.x_begin;
+        return count;
+    }
+};
+
+#endif //PROLIF_COLORING_SPAN_STENCIL
@@ -0,0 +1,233 @@
+#ifndef PROLIF_COLORING_SPARSE_MESH
+#define PROLIF_COLORING_SPARSE_MESH
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include "Geometry/point.h"
+#include "Mesh.hpp"
+#include "SpanStencil.hpp"
+
+/**
+ * This class defines a sparse discrete space: the space is tiled into bricks of 8x8x8 voxels and only the bricks
+ * something has been written to are allocated, so that memory and sweeps scale with the occupied volume instead of
+ * the volume of the bounding box (the brick table costs 4 bytes per brick, 1/16 of a dense brick).
+ * Voxel coordinates, global and internal displacement have the same meaning they have in MoleculeMesh
+ */
+class SparseMesh {
+public:
+    /**
+     * The edge of a brick, in voxels
+     */
+    static constexpr int brickEdge = 8;
+
+    /**
+     * A brick: one data word per z-layer, each word packs the 8 x-rows of the layer (bit 8 * y + x)
+     */
+    typedef std::array<MoleculeMesh::data_t, brickEdge> brick_t;
+
+private:
+    /**
+     * The 3D sizes of the brick table
+     */
+    int bricks_x, bricks_y, bricks_z;
+
+    /**
+     * The brick table: the index of each brick into #bricks, -1 if the brick is not allocated
+     */
+    std::vector<int32_t> table;
+
+    /**
+     * The allocated bricks
+     */
+    std::vector<brick_t> bricks;
+
+    /**
+     * The position of each allocated brick into the brick table
+     */
+    std::vector<uint32_t> keys;
+
+    /**
+     * This function returns the allocated brick at a brick table position, allocating an empty one if needed
+     * @param key The brick table position
+     * @return The brick
+     */
+    inline brick_t &touch(size_t key) {
+        int32_t index = table[key];
+        if (index < 0) {
+            index = static_cast<int32_t>(bricks.size());
+            table[key] = index;
+            bricks.push_back(brick_t{});
+            keys.push_back(static_cast<uint32_t>(key));
+        }
+        return bricks[index];
+    }
+
+    /**
+     * This function returns the brick table position of a brick
+     * @param bx X brick coordinates
+     * @param by Y brick coordinates
+     * @param bz Z brick coordinates
+     * @return The brick table position
+     */
+    inline size_t brickKey(int bx, int by, int bz) const {
+        return static_cast<size_t>(bricks_x) * (static_cast<size_t>(bz) * bricks_y + by) + bx;
+    }
+
+    /**
+     * This function throws if a discrete space is not defined on the same voxels of this one
+     */
+    void checkShape(int o_dim_x, int o_dim_y, int o_dim_z) const;
+
+public:
+    /**
+     * The 3D sizes of the discrete space
+     */
+    const int dim_x, dim_y, dim_z;
+
+    /**
+     * The displacement this discrete space have in relation to a "global" one
+     */
+    RDGeom::Point3D globalDisplacement;
+
+    /**
+     * The displacement data have internally in this discrete space
+     */
+    int internalDisplacement;
+
+    /**
+     * The number of voxels per unit of length of the space
+     */
+    int grain;
+
+    /**
+     * This constructor initialize an empty discrete space (no brick is allocated)
+     * @param p_dim_x X dimension of the space
+     * @param p_dim_y Y dimension of the space
+     * @param p_dim_z Z dimension of the space
+     * @param globalDisplacement Global displacement of the space
+     * @param internalDisplacement Internal displacement of data
+     * @param grain The number of voxels per unit of length of the space
+     */
+    SparseMesh(int p_dim_x, int p_dim_y, int p_dim_z, const RDGeom::Point3D &globalDisplacement,
+               int internalDisplacement, int grain = GRAIN);
+
+    /**
+     * This constructor converts a dense discrete space, only the bricks holding set voxels are allocated
+     * @param mesh The dense discrete space
+     */
+    explicit SparseMesh(const MoleculeMesh &mesh);
+
+    /**
+     * This function converts the discrete space to a dense one
+     * @return The dense discrete space
+     */
+    MoleculeMesh toDense() const;
+
+    /**
+     * This function returns the data at a specific discrete position of the space
+     * @param x X discrete coordinates
+     * @param y Y discrete coordinates
+     * @param z Z discrete coordinates
+     * @return The data at (X,Y,Z) discrete position in space
+     */
+    inline bool at(int x, int y, int z) const {
+        int32_t index = table[brickKey(x / brickEdge, y / brickEdge, z / brickEdge)];
+        if (index < 0) return false;
+        return (bricks[index][z % brickEdge] >> (brickEdge * (y % brickEdge) + x % brickEdge)) & 1;
+    }
+
+    /**
+     * This function sets the data at a specific discrete position of the space
+     * @param x X discrete coordinates
+     * @param y Y discrete coordinates
+     * @param z Z discrete coordinates
+     */
+    inline void set(int x, int y, int z) {
+        touch(brickKey(x / brickEdge, y / brickEdge, z / brickEdge))[z % brickEdge] |=
+                MoleculeMesh::data_t(1) << (brickEdge * (y % brickEdge) + x % brickEdge);
+    }
+
+    /**
+     * This function returns the number of allocated bricks
+     * @return
+     */
+    inline size_t getBrickCount() const {
+        return bricks.size();
+    }
+
+    /**
+     * This function returns the number of bytes the space is made of (brick table and allocated bricks)
+     * @return
+     */
+    inline size_t getMemoryUsage() const {
+        return table.size() * sizeof(int32_t) + bricks.size() * (sizeof(brick_t) + sizeof(uint32_t));
+    }
+
+    /**
+     * This function returns the number of set voxels of the space
+     * @return
+     */
+    size_t getVoxelCount() const;
+
+    /**
+     * This function releases all the bricks of the space
+     */
+    void clear();
+
+    /**
+     * This function releases the allocated bricks that hold no set voxel (e.g. after a subtraction)
+     */
+    void prune();
+
+    /**
+     * This function performs a boolean addition of a discrete space (of the same size of this one), brick by brick
+     * @param addend The discrete space we want to integrate
+     */
+    void add(const SparseMesh &addend);
+
+    /**
+     * This function performs a boolean subtraction of a discrete space (of the same size of this one),
+     * only the allocated bricks of both spaces are visited
+     * @param mask The discrete space we want to subtract
+     */
+    void sub(const SparseMesh &mask);
+
+    /**
+     * This function performs a boolean subtraction of a dense discrete space (of the same size of this one),
+     * only the allocated bricks of this space are visited
+     * @param mask The discrete space we want to subtract
+     */
+    void sub(const MoleculeMesh &mask);
+
+    /**
+     * This function allow to integrate a sparse pattern performing a boolean addition, only the bricks crossed by
+     * the runs of the pattern are allocated
+     * @param stencil The pattern we want to integrate
+     * @param displ_x The X displacement we want the pattern to be placed
+     * @param displ_y The Y displacement we want the pattern to be placed
+     * @param displ_z The Z displacement we want the pattern to be placed
+     */
+    void stamp(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z);
+
+    /**
+     * This function visits the set voxels of the space, brick by brick (in allocation order)
+     * @param visit The function called with the (X,Y,Z) discrete coordinates of each set voxel
+     */
+    template<typename F>
+    void forEachVoxel(F visit) const {
+        for (size_t i = 0; i < bricks.size(); ++i) {
+            int bx = static_cast<int>(keys[i] % bricks_x);
+            int by = static_cast<int>(keys[i] / bricks_x % bricks_y);
+            int bz = static_cast<int>(keys[i] / bricks_x / bricks_y);
+            for (int l = 0; l < brickEdge; ++l) {
+                for (MoleculeMesh::data_t word = bricks[i][l]; word; word &= word - 1) {
+                    int bit = __builtin_ctzll(word);
+                    visit(bx * brickEdge + bit % brickEdge, by * brickEdge + bit / brickEdge, bz * brickEdge + l);
+                }
+            }
+        }
+    }
+};
+
+#endif //PROLIF_COLORING_SPARSE_MESH
@@ -0,0 +1,50 @@
+#ifndef PROLIF_COLORING_STENCIL_CACHE
+#define PROLIF_COLORING_STENCIL_CACHE
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include "Mesh.hpp"
+#include "SpanStencil.hpp"
+
+/**
+ * This class keeps a process-wide collection of the patterns that only depend on interaction parameters,
+ * so that they are built once and shared by every interaction (and every molecule) that needs them
+ */
+class StencilCache {
+private:
+    /**
+     * The key that identifies a spherical pattern: <radius, grain>
+     */
+    typedef std::pair<double, int> sphere_key_t;
+
+    /**
+     * The mutex guarding the cached patterns
+     */
+    static std::mutex mutex;
+
+    /**
+     * The cached spherical patterns
+     */
+    static std::map<sphere_key_t, std::unique_ptr<const SpanStencil>> spheres;
+
+    /**
+     * This function generates a spherical pattern, one x-run per (Y,Z) row of the pattern window
+     * @param radius The radius of the sphere
+     * @param grain The number of voxels per unit of length
+     * @return The spherical pattern
+     */
+    static std::unique_ptr<const SpanStencil> buildSphere(double radius, int grain);
+
+public:
+    /**
+     * This function returns the spherical pattern of a given radius, the pattern window is a cube of edge
+     * 2 * ceil(radius * grain) in which every voxel whose distance from the center is <= radius is set
+     * @param radius The radius of the sphere
+     * @param grain The number of voxels per unit of length
+     * @return The spherical pattern, valid for the whole process lifetime
+     */
+    static const SpanStencil &sphere(double radius, int grain = GRAIN);
+};
+
+#endif //PROLIF_COLORING_STENCIL_CACHE
@@ -0,0 +1,100 @@
+#ifndef PROLIF_COLORING_THREAD_POOL
+#define PROLIF_COLORING_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * This class defines a pool of worker threads executing independent tasks (e.g. one molecule each),
+ * every worker owns a task queue and, once it is empty, steals the oldest tasks of the other workers
+ */
+class ThreadPool {
+public:
+    /**
+     * The type of task the pool executes
+     */
+    typedef std::function<void()> task_t;
+
+private:
+    /**
+     * The task queue owned by a worker
+     */
+    struct WorkerQueue {
+        std::deque<task_t> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    /**
+     * The state shared by all workers: number of queued tasks, number of unfinished tasks, shutdown flag
+     */
+    std::mutex stateMutex;
+    std::condition_variable taskAvailable, allDone;
+    size_t queued = 0, pending = 0;
+    bool stopping = false;
+
+    /**
+     * The queue next external submission is assigned to
+     */
+    std::atomic<unsigned int> nextQueue{0};
+
+    /**
+     * This function extracts a task, first from the back of the worker own queue, then from the front
+     * of the others
+     * @param self The index of the worker
+     * @param task The extracted task
+     * @return False if no task is currently queued, True otherwise
+     */
+    bool tryPop(unsigned int self, task_t &task);
+
+    /**
+     * This function defines the worker loop
+     * @param self The index of the worker
+     */
+    void run(unsigned int self);
+
+public:
+    /**
+     * This constructor starts the worker threads
+     * @param numThreads The number of workers (0 means one per hardware thread)
+     */
+    explicit ThreadPool(unsigned int numThreads = 0);
+
+    /**
+     * This destructor waits for all submitted tasks and stops the workers
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * This function submits a task to the pool, tasks submitted by a worker are queued on its own queue
+     * @param task The task to execute
+     */
+    void submit(task_t task);
+
+    /**
+     * This function blocks until all the submitted tasks have been executed
+     */
+    void wait();
+
+    /**
+     * This function returns the number of workers of the pool
+     * @return
+     */
+    inline unsigned int size() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+};
+
+#endif //PROLIF_COLORING_THREAD_POOL
@@ -0,0 +1,199 @@
+#ifndef PROLIF_COLORING_TRAJECTORY_MESH
+#define PROLIF_COLORING_TRAJECTORY_MESH
+
+#include <memory>
+#include <vector>
+#include "CountMesh.hpp"
+#include "Interaction.hpp"
+#include "InteractionCollection.hpp"
+#include "MoleculeContext.hpp"
+
+/**
+ * This class keeps the discrete molecule and the discrete interactions of the frames of a trajectory (or the
+ * conformers of a molecule) up to date incrementally: every atom sphere and every match pattern is reference-counted
+ * (see CountMesh), so that a frame only removes and stamps again the spheres of the atoms and the patterns of the
+ * matches that moved since they have been stamped, and the cost of a frame is proportional to the motion instead of
+ * the size of the molecule.
+ * Atoms (and matches) that moved less than a tolerance (half a voxel by default) keep their stamp, the error
+ * does not accumulate as the motion is measured from the position the stamp has been placed at.
+ * The support-mesh is the one of the first frame, enlarged by a margin: frames with atoms out of it (or with a
+ * different topology) are discretized from scratch
+ */
+class TrajectoryMesh {
+public:
+    /**
+     * The default margin the support-mesh is enlarged by, in units of length
+     */
+    static constexpr int defaultMargin = 2;
+
+private:
+    /**
+     * The incremental state of an interaction
+     */
+    struct Channel {
+        /**
+         * The interaction
+         */
+        Interaction *interaction;
+
+        /**
+         * The matches of the match-pattern into the molecule
+         */
+        MatchCache::matches_t matches;
+
+        /**
+         * The placed pattern of every match
+         */
+        std::vector<Interaction::MatchStamp> stamps;
+
+        /**
+         * The positions of the atoms of every match when its pattern has been placed (scaled by the grain),
+         * the ones of match i start at anchors[3 * offsets[i]]
+         */
+        std::vector<double> anchors;
+        std::vector<size_t> offsets;
+
+        /**
+         * The reference-counted union of the placed patterns
+         */
+        std::unique_ptr<CountMesh> coverage;
+
+        /**
+         * The number of matches having a pattern
+         */
+        size_t placed = 0;
+    };
+
+    /**
+     * The interactions to calculate
+     */
+    const InteractionCollection::list_t &interactions;
+
+    /**
+     * The number of voxels per unit of length, the padding of the support-mesh and its additional margin
+     * (in units of length)
+     */
+    const int grain, padding, margin;
+
+    /**
+     * The squared motion (in voxels) from which an atom or a match is stamped again
+     */
+    const double squaredTolerance;
+
+    /**
+     * The reference-counted atom spheres
+     */
+    std::unique_ptr<CountMesh> molecule;
+
+    /**
+     * The sphere centers of the atoms (in the discrete reference system of the support-mesh), 3 per atom
+     */
+    std::vector<double> atomAnchors;
+
+    /**
+     * The state of every interaction (the i-th one is interaction i)
+     */
+    std::vector<Channel> channels;
+
+    /**
+     * The statistics of the last update: if it discretized from scratch, the atoms and the matches stamped again
+     */
+    bool rebuilt = false;
+    size_t movedAtoms = 0, movedMatches = 0;
+
+    /**
+     * This function returns if the atoms of a frame lie in the support-mesh far enough from its border
+     * (as they would in a support-mesh built on the frame)
+     */
+    bool fits(const MoleculeContext &context) const;
+
+    /**
+     * This function discretizes a frame from scratch, on a new support-mesh
+     * @param context The frame
+     * @param matches The matches of every interaction into the frame
+     */
+    void rebuild(const MoleculeContext &context, const std::vector<MatchCache::matches_t> &matches);
+
+    /**
+     * This function places and stamps the patterns of some matches of an interaction, recording the positions
+     * of their atoms
+     */
+    void place(Channel &channel, const MoleculeContext &context, const std::vector<size_t> &sites);
+
+public:
+    /**
+     * This constructor initialize an empty trajectory, the first update discretizes its frame from scratch
+     * @param interactions The interactions to calculate
+     * @param grain The number of voxels per unit of length
+     * @param padding The padding of the support-mesh around the atoms, in units of length
+     * @param margin The additional padding that lets atoms move before a frame has to be discretized from scratch
+     * @param tolerance The motion (in voxels) under which an atom or a match keeps its stamp
+     */
+    explicit TrajectoryMesh(const InteractionCollection::list_t &interactions, int grain = GRAIN, int padding = 5,
+                            int margin = defaultMargin, double tolerance = 0.5);
+
+    /**
+     * This function moves the meshes to a new frame
+     * @param context The frame, a conformer of the molecule of the previous frames (or of a new molecule)
+     */
+    void update(const MoleculeContext &context);
+
+    /**
+     * This function returns the discrete molecule of the current frame
+     * @return
+     */
+    const MoleculeMesh &getMoleculeMesh() const {
+        return molecule->getMesh();
+    }
+
+    /**
+     * This function returns the union of the patterns of an interaction in the current frame
+     * (the molecule is not subtracted)
+     * @param i The index of the interaction
+     * @return
+     */
+    const MoleculeMesh &getCoverage(size_t i) const {
+        return channels[i].coverage->getMesh();
+    }
+
+    /**
+     * This function returns if an interaction has been found in the current frame (any of its matches has a pattern)
+     * @param i The index of the interaction
+     * @return
+     */
+    bool isFound(size_t i) const {
+        return channels[i].placed > 0;
+    }
+
+    /**
+     * This function returns the number of bytes held by the reference-counted meshes
+     * @return
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * This function returns if the last update discretized its frame from scratch
+     * @return
+     */
+    bool isRebuilt() const {
+        return rebuilt;
+    }
+
+    /**
+     * This function returns the number of atoms the last update stamped again
+     * @return
+     */
+    size_t getMovedAtoms() const {
+        return movedAtoms;
+    }
+
+    /**
+     * This function returns the number of matches the last update stamped again
+     * @return
+     */
+    size_t getMovedMatches() const {
+        return movedMatches;
+    }
+};
+
+#endif //PROLIF_COLORING_TRAJECTORY_MESH
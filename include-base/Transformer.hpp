@@ -1,8 +1,16 @@
 #ifndef PROLIF_COLORING_DISCRETIZER
 #define PROLIF_COLORING_DISCRETIZER
 
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <vector>
 #include "GraphMol/RWMol.h"
 #include "Mesh.hpp"
+#include "SparseMesh.hpp"
+#include "MoleculeContext.hpp"
+#include "Metrics.hpp"
+#include "ScratchArena.hpp"
 
 /**
  * This class allow the transformation from the continuous space of RDKit-molecule
@@ -19,48 +27,46 @@ class Transformer {
      */
     static constexpr int minPadding = 2;
 
-public:
     /**
-     * This function allow the transformation from the RDKit-molecule to MoleculeMesh
-     * @param molecule The RDKit-molecule to get discrete definition
-     * @param padding The padding to add to discrete definition
-     * @return The discrete definition of the input molecule
+     * The support-mesh kernel, see supportMesh()
+     * @param grain The number of voxels per unit of length (a compile-time constant for specialized grains)
      */
-    static MoleculeMesh *discretize(const RDKit::ROMol &molecule, int padding = minPadding) {
-
-        /* Padding less than the minimum one is not allowed */
-        if (padding < minPadding) padding = minPadding;
-
+    template<typename G>
+    static std::unique_ptr<MoleculeMesh> supportMeshKernel(const MoleculeContext &context, int padding, G grain) {
         /* Retrieve all atom position of input molecule */
-        std::vector<RDGeom::Point3D> atoms = molecule.getConformer().getPositions();
+        const size_t n_atoms = context.getNumAtoms();
+        if (n_atoms == 0)
+            throw std::runtime_error("cannot discretize a molecule without atoms");
+        const double *atoms_x = context.x.data(), *atoms_y = context.y.data(), *atoms_z = context.z.data();
 
         /* Find min and max of the span of molecule */
-        double t_max_x = 0, t_max_y = 0, t_max_z = 0, t_min_x = atoms[0].x, t_min_y = atoms[0].y, t_min_z = atoms[0].z;
-
-        for (const auto &pos: atoms) {
-            if (t_max_x < pos.x)
-                t_max_x = pos.x;
-            if (t_max_y < pos.y)
-                t_max_y = pos.y;
-            if (t_max_z < pos.z)
-                t_max_z = pos.z;
-
-            if (t_min_x > pos.x)
-                t_min_x = pos.x;
-            if (t_min_y > pos.y)
-                t_min_y = pos.y;
-            if (t_min_z > pos.z)
-                t_min_z = pos.z;
+        double t_max_x = atoms_x[0], t_max_y = atoms_y[0], t_max_z = atoms_z[0];
+        double t_min_x = atoms_x[0], t_min_y = atoms_y[0], t_min_z = atoms_z[0];
+
+        for (size_t i = 0; i < n_atoms; ++i) {
+            if (t_max_x < atoms_x[i])
+                t_max_x = atoms_x[i];
+            if (t_max_y < atoms_y[i])
+                t_max_y = atoms_y[i];
+            if (t_max_z < atoms_z[i])
+                t_max_z = atoms_z[i];
+
+            if (t_min_x > atoms_x[i])
+                t_min_x = atoms_x[i];
+            if (t_min_y > atoms_y[i])
+                t_min_y = atoms_y[i];
+            if (t_min_z > atoms_z[i])
+                t_min_z = atoms_z[i];
         }
 
         /* Discretize min and max */
-        int max_x = static_cast<int>(ceil(t_max_x) * GRAIN);
-        int max_y = static_cast<int>(ceil(t_max_y) * GRAIN);
-        int max_z = static_cast<int>(ceil(t_max_z) * GRAIN);
+        int max_x = static_cast<int>(ceil(t_max_x) * grain);
+        int max_y = static_cast<int>(ceil(t_max_y) * grain);
+        int max_z = static_cast<int>(ceil(t_max_z) * grain);
 
-        int min_x = static_cast<int>(floor(t_min_x) * GRAIN);
-        int min_y = static_cast<int>(floor(t_min_y) * GRAIN);
-        int min_z = static_cast<int>(floor(t_min_z) * GRAIN);
+        int min_x = static_cast<int>(floor(t_min_x) * grain);
+        int min_y = static_cast<int>(floor(t_min_y) * grain);
+        int min_z = static_cast<int>(floor(t_min_z) * grain);
 
         /* Calculate span of molecule */
         int span_x = max_x - min_x;
@@ -68,101 +74,187 @@ public:
         int span_z = max_z - min_z;
 
         /* Size of mesh is molecule_span + border_padding, all scaled to a granularity factor */
-        int scaledPadding = padding * GRAIN;
+        int scaledPadding = padding * grain;
 
         int size_x = span_x + scaledPadding * 2;
         int size_y = span_y + scaledPadding * 2;
         int size_z = span_z + scaledPadding * 2;
 
         /* Generate support-mesh */
-        auto mesh = new MoleculeMesh(size_x, size_y, size_z,
-                                     {floor(t_min_x),
-                                      floor(t_min_y),
-                                      floor(t_min_z)},
-                                     scaledPadding);
-
-        /* Calculate discrete atom size */
-        double scaledAtomRadius = atomRadius * GRAIN;
-        int scaledAtomPadding = static_cast<int>(ceil(scaledAtomRadius));
-
-        /* For each atom of molecule */
-        for (auto &pos: atoms) {
-            /* Calculate atom position on support-mesh reference system */
-            double px = pos.x * GRAIN - min_x + scaledPadding;
-            double py = pos.y * GRAIN - min_y + scaledPadding;
-            double pz = pos.z * GRAIN - min_z + scaledPadding;
-
-            /* Calculate operative ranges of atom */
-            std::pair<int, int> range_x = {
-                    static_cast<int>(floor(px)) - scaledAtomPadding,
-                    static_cast<int>(ceil(px)) + scaledAtomPadding
-            };
-            std::pair<int, int> range_y = {
-                    static_cast<int>(floor(py)) - scaledAtomPadding,
-                    static_cast<int>(ceil(py)) + scaledAtomPadding
-            };
-            std::pair<int, int> range_z = {
-                    static_cast<int>(floor(pz)) - scaledAtomPadding,
-                    static_cast<int>(ceil(pz)) + scaledAtomPadding
-            };
-
-            /* Over operative ranges */
-            double ds = scaledAtomRadius * scaledAtomRadius;
-            for (int z = range_z.first; z < range_z.second; ++z) {
-                double dz = z - pz;
-                double z_res = dz * dz;
-                for (int y = range_y.first; y < range_y.second; ++y) {
-                    double dy = y - py;
-                    double y_res = dy * dy;
-                    for (int x = range_x.first; x < range_x.second; ++x) {
-                        double dx = x - px;
-                        double x_res = dx * dx;
-                        /* Find if the point (x,y,z) has distance <= #atomRadius from atom-position (#pos) */
-                        if (x_res + y_res + z_res <= ds)
-                            mesh->at(x, y, z) = 1;
-                    }
-                }
-            }
+        return std::make_unique<MoleculeMesh>(size_x, size_y, size_z,
+                                              RDGeom::Point3D(floor(t_min_x),
+                                                              floor(t_min_y),
+                                                              floor(t_min_z)),
+                                              scaledPadding, grain);
+    }
+
+    /**
+     * The discretization kernel, see discretize()
+     * @param grain The number of voxels per unit of length (a compile-time constant for specialized grains)
+     */
+    template<typename G>
+    static std::unique_ptr<MoleculeMesh> discretizeKernel(const MoleculeContext &context, int padding, G grain) {
+        std::unique_ptr<MoleculeMesh> mesh = supportMeshKernel(context, padding, grain);
+
+        const size_t n_atoms = context.getNumAtoms();
+        const double *atoms_x = context.x.data(), *atoms_y = context.y.data(), *atoms_z = context.z.data();
+
+        /* Calculate atom positions on support-mesh reference system (one flat pass per axis) */
+        std::pmr::vector<double> centers_x(n_atoms, ScratchArena::resource());
+        std::pmr::vector<double> centers_y(n_atoms, ScratchArena::resource());
+        std::pmr::vector<double> centers_z(n_atoms, ScratchArena::resource());
+        const RDGeom::Point3D origin = mesh->globalDisplacement;
+        const int scaledPadding = mesh->internalDisplacement;
+        for (size_t i = 0; i < n_atoms; ++i) {
+            centers_x[i] = meshCoordinate(atoms_x[i], origin.x, scaledPadding, grain);
+            centers_y[i] = meshCoordinate(atoms_y[i], origin.y, scaledPadding, grain);
+            centers_z[i] = meshCoordinate(atoms_z[i], origin.z, scaledPadding, grain);
         }
 
+        /* Fill every voxel having distance <= #atomRadius from an atom-position, one x-row run at a time */
+        mesh->stampSpheres(centers_x.data(), centers_y.data(), centers_z.data(), n_atoms, atomRadius * grain);
+
         return mesh;
     }
 
 
     /**
-     * This function allow the transformation from the MoleculeMesh to RDKit-molecule
-     * @param mesh The RDKit-molecule to get continuous definition
-     * @return The continuous definition of the input molecule
+     * The dense synthesis kernel, see sintetize()
+     * @param grain The number of voxels per unit of length (a compile-time constant for specialized grains)
      */
-    static RDKit::RWMol *sintetize(MoleculeMesh &mesh) {
-        /* Generate a new molecule and assign a conformer for atoms position */
-        auto *molecule = new RDKit::RWMol();
-        auto *conformer = new RDKit::Conformer();
-        molecule->addConformer(conformer);
+    template<typename G>
+    static std::unique_ptr<RDKit::RWMol> sintetizeKernel(const MoleculeMesh &mesh, G grain) {
+        /* Generate a new molecule, and a conformer for atoms position as large as the set voxels */
+        auto molecule = std::make_unique<RDKit::RWMol>();
+        auto conformer = std::make_unique<RDKit::Conformer>(mesh.getVoxelCount());
 
-        /* Over the entire size of mesh */
+        /* Over the set voxels of mesh (walking the packed words of each x-row) */
+        const int words_x = MoleculeMesh::rowWords(mesh.dim_x);
         for (int i = 0; i < mesh.dim_z; i++) {
-            auto pz = static_cast<double>(i - mesh.internalDisplacement) / GRAIN + mesh.globalDisplacement.z;
+            auto pz = static_cast<double>(i - mesh.internalDisplacement) / grain + mesh.globalDisplacement.z;
             for (int j = 0; j < mesh.dim_y; j++) {
-                auto py = static_cast<double>(j - mesh.internalDisplacement) / GRAIN + mesh.globalDisplacement.y;
-                for (int k = 0; k < mesh.dim_x; k++) {
-                    if (mesh.at(k, j, i)) {
+                auto py = static_cast<double>(j - mesh.internalDisplacement) / grain + mesh.globalDisplacement.y;
+                const MoleculeMesh::data_t *row = MoleculeMesh::row(mesh.getData(), j, i, words_x, mesh.dim_y);
+                for (int w = 0; w < words_x; w++) {
+                    for (MoleculeMesh::data_t word = row[w]; word; word &= word - 1) {
+                        int k = w * MoleculeMesh::wordBits + __builtin_ctzll(word);
                         auto px =
-                                static_cast<double>(k - mesh.internalDisplacement) / GRAIN + mesh.globalDisplacement.x;
+                                static_cast<double>(k - mesh.internalDisplacement) / grain + mesh.globalDisplacement.x;
 
-                        /* Get atom position back from mesh reference system */
-                        auto *pos = new RDGeom::Point3D(px, py, pz);
-
-                        /* Add atom to the molecule and assign the calculated position */
+                        /* Add atom to the molecule and assign the position got back from mesh reference system */
                         unsigned int autoId = molecule->addAtom();
                         molecule->getAtomWithIdx(autoId)->setAtomicNum(1);
-                        conformer->setAtomPos(autoId, *pos);
+                        conformer->setAtomPos(autoId, RDGeom::Point3D(px, py, pz));
                     }
                 }
             }
         }
+
+        /* The conformer is attached once all atoms are there, so it is not grown atom by atom */
+        molecule->addConformer(conformer.release(), true);
+        return molecule;
+    }
+
+    /**
+     * The sparse synthesis kernel, see sintetize()
+     * @param grain The number of voxels per unit of length (a compile-time constant for specialized grains)
+     */
+    template<typename G>
+    static std::unique_ptr<RDKit::RWMol> sintetizeKernel(const SparseMesh &mesh, G grain) {
+        /* Generate a new molecule, and a conformer for atoms position as large as the set voxels */
+        auto molecule = std::make_unique<RDKit::RWMol>();
+        auto conformer = std::make_unique<RDKit::Conformer>(mesh.getVoxelCount());
+
+        mesh.forEachVoxel([&](int x, int y, int z) {
+            /* Get atom position back from mesh reference system */
+            RDGeom::Point3D pos(static_cast<double>(x - mesh.internalDisplacement) / grain + mesh.globalDisplacement.x,
+                                static_cast<double>(y - mesh.internalDisplacement) / grain + mesh.globalDisplacement.y,
+                                static_cast<double>(z - mesh.internalDisplacement) / grain + mesh.globalDisplacement.z);
+
+            /* Add atom to the molecule and assign the calculated position */
+            unsigned int autoId = molecule->addAtom();
+            molecule->getAtomWithIdx(autoId)->setAtomicNum(1);
+            conformer->setAtomPos(autoId, pos);
+        });
+
+        molecule->addConformer(conformer.release(), true);
         return molecule;
     }
+
+public:
+    /**
+     * This function returns the radius of the spheres the atoms are discretized into
+     * @return The radius, in units of length
+     */
+    static constexpr double getAtomRadius() {
+        return atomRadius;
+    }
+
+    /**
+     * This function returns a coordinate of an atom in the discrete reference system of a support-mesh
+     * @param position The coordinate of the atom
+     * @param globalDisplacement The global displacement of the support-mesh along the same axis
+     * @param internalDisplacement The internal displacement of the support-mesh
+     * @param grain The number of voxels per unit of length of the support-mesh
+     * @return The discrete (not rounded) coordinate
+     */
+    static inline double meshCoordinate(double position, double globalDisplacement, int internalDisplacement,
+                                        int grain) {
+        return position * grain - static_cast<int>(globalDisplacement * grain) + internalDisplacement;
+    }
+
+    /**
+     * This function returns the empty support-mesh discretize() would fill: the box of the molecule atoms,
+     * padded on every side
+     * @param context The RDKit-molecule, prepared for a conformer
+     * @param padding The padding to add around the atoms, in units of length
+     * @param grain The number of voxels per unit of length of the support-mesh
+     * @return The empty support-mesh
+     */
+    static std::unique_ptr<MoleculeMesh> supportMesh(const MoleculeContext &context, int padding = minPadding,
+                                                     int grain = GRAIN) {
+        /* Padding less than the minimum one is not allowed */
+        if (padding < minPadding) padding = minPadding;
+
+        return Grain::dispatch(grain, [&](auto g) { return supportMeshKernel(context, padding, g); });
+    }
+
+    /**
+     * This function allow the transformation from the RDKit-molecule to MoleculeMesh
+     * @param context The RDKit-molecule to get discrete definition, prepared for a conformer
+     * @param padding The padding to add to discrete definition
+     * @param grain The number of voxels per unit of length of the discrete definition
+     * @return The discrete definition of the input molecule
+     */
+    static std::unique_ptr<MoleculeMesh> discretize(const MoleculeContext &context, int padding = minPadding,
+                                                    int grain = GRAIN) {
+        /* Padding less than the minimum one is not allowed */
+        if (padding < minPadding) padding = minPadding;
+
+        Metrics::Timer timer(Metrics::DISCRETIZE);
+        return Grain::dispatch(grain, [&](auto g) { return discretizeKernel(context, padding, g); });
+    }
+
+    /**
+     * This function allow the transformation from the MoleculeMesh to RDKit-molecule
+     * @param mesh The RDKit-molecule to get continuous definition
+     * @return The continuous definition of the input molecule
+     */
+    static std::unique_ptr<RDKit::RWMol> sintetize(const MoleculeMesh &mesh) {
+        Metrics::Timer timer(Metrics::SINTETIZE);
+        return Grain::dispatch(mesh.grain, [&](auto g) { return sintetizeKernel(mesh, g); });
+    }
+
+    /**
+     * This function allow the transformation from the SparseMesh to RDKit-molecule
+     * (only the allocated bricks are visited, atoms follow the brick order)
+     * @param mesh The RDKit-molecule to get continuous definition
+     * @return The continuous definition of the input molecule
+     */
+    static std::unique_ptr<RDKit::RWMol> sintetize(const SparseMesh &mesh) {
+        Metrics::Timer timer(Metrics::SINTETIZE);
+        return Grain::dispatch(mesh.grain, [&](auto g) { return sintetizeKernel(mesh, g); });
+    }
 };
 
 #endif //PROLIF_COLORING_DISCRETIZER
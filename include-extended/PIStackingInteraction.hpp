@@ -0,0 +1,28 @@
+#ifndef PROLIF_COLORING_PISTACKING_INTERACTION
+#define PROLIF_COLORING_PISTACKING_INTERACTION
+
+#include "RestrictedBasePIStackingInteraction.hpp"
+
+class FaceToFaceInteraction : public RestrictedBasePIStackingInteraction {
+public:
+    FaceToFaceInteraction() : RestrictedBasePIStackingInteraction(
+            5.5,
+            {0, M_PI * 35 / 180},
+            {0, M_PI * 33 / 180},
+            "[a;r6]1:[a;r6]:[a;r6]:[a;r6]:[a;r6]:[a;r6]:1"
+    ) {}
+};
+
+class EdgeToFaceInteraction : public RestrictedBasePIStackingInteraction {
+public:
+    EdgeToFaceInteraction() : RestrictedBasePIStackingInteraction(
+            6.5,
+            {M_PI * 50 / 180, M_PI * 90 / 180},
+            {0, M_PI * 30 / 180},
+            "[a;r6]1:[a;r6]:[a;r6]:[a;r6]:[a;r6]:[a;r6]:1",
+            true,
+            1.5
+    ) {}
+};
+
+#endif //PROLIF_COLORING_PISTACKING_INTERACTION
@@ -1,83 +1,281 @@
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include "GraphMol/FileParsers/FileParsers.h"
-#include "Mesh.hpp"
-#include "Transformer.hpp"
+#include "Backend.hpp"
+#include "DistanceTransform.hpp"
 #include "InteractionCollection.hpp"
+#include "Metrics.hpp"
+#include "MoleculeReader.hpp"
+#include "Pipeline.hpp"
+#include "ThreadPool.hpp"
 
-int main(int argc, char *argv[]) {
-    /* Get molecule file path */
-    if (argc != 2) {
-        std::cout << "Usage:\tProLIF_coloring <molecule_path>" << std::endl;
-        return 1;
+/**
+ * This function collects the molecule files of a batch, given either a directory (all its .pdb files)
+ * or a list file (one path per line, empty lines and lines starting with '#' are skipped)
+ * @param batchPath The directory or list file path
+ * @return The molecule file paths
+ */
+static std::vector<std::string> collectBatch(const std::string &batchPath) {
+    std::vector<std::string> paths;
+
+    if (std::filesystem::is_directory(batchPath)) {
+        for (const auto &entry: std::filesystem::directory_iterator(batchPath))
+            if (entry.is_regular_file() && entry.path().extension() == ".pdb")
+                paths.push_back(entry.path().string());
+        std::sort(paths.begin(), paths.end());
+    } else {
+        std::ifstream list(batchPath);
+        std::string line;
+        while (std::getline(list, line)) {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty() && line[0] != '#') paths.push_back(line);
+        }
     }
-    std::string molPath = argv[1];
 
-    timespec startTime, endTime;
+    return paths;
+}
 
-    /* Setup directory for output files */
-    std::filesystem::create_directory("./outs/");
+/**
+ * This function processes a batch of molecules concurrently, each molecule is a task of a work-stealing pool
+ * and its results are saved into ./outs/<index>_<molecule_name>/, the metrics summary (if metrics are collected)
+ * into ./outs/metrics_summary.json
+ * @param paths The molecule file paths
+ * @param options The processing options
+ * @param numThreads The number of workers (0 means one per hardware thread)
+ * @return The number of molecules that could not be processed
+ */
+static size_t processBatch(const std::vector<std::string> &paths, const Pipeline::Options &options,
+                           unsigned int numThreads) {
+    /* Interactions (and their compiled SMARTS) are built once and shared by all workers */
+    InteractionCollection::list_t interactions = InteractionCollection::buildList();
 
-    /* Read molecule file and generate molecule mesh */
-    RDKit::ROMol *molecule = RDKit::PDBFileToMol(molPath, true, false);
+    std::atomic<size_t> failed{0};
+    std::mutex outputMutex;
+    Metrics batchMetrics;
 
-    std::cout << "Discretizing molecule" << std::endl;
+    timespec startTime, endTime;
     clock_gettime(CLOCK_MONOTONIC, &startTime);
-    MoleculeMesh *moleculeMesh = Transformer::discretize(*molecule, 5);
-    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    {
+        ThreadPool pool(numThreads);
+        std::cout << "Processing " << paths.size() << " molecules on " << pool.size() << " workers" << std::endl;
 
-    auto elapsed = static_cast<double>((endTime.tv_sec - startTime.tv_sec));
-    elapsed += static_cast<double>((endTime.tv_nsec - startTime.tv_nsec)) / 1000000000.0;
-    std::cout << "\t-> elapsed time : " << elapsed << std::endl;
+        for (size_t i = 0; i < paths.size(); ++i) {
+            pool.submit([&, i]() {
+                const std::string &molPath = paths[i];
+                std::string outDir = "./outs/" + std::to_string(i) + "_" +
+                                     std::filesystem::path(molPath).stem().string() + "/";
+                bool succeed = false;
+                try {
+                    std::unique_ptr<RDKit::ROMol> molecule(RDKit::PDBFileToMol(molPath, true, false));
+                    if (molecule != nullptr && molecule->getNumConformers() > 0) {
+                        std::filesystem::create_directories(outDir);
+                        Metrics metrics = Pipeline::writeAll(Pipeline::computeAll(*molecule, interactions, options),
+                                                             outDir, options);
+                        succeed = true;
 
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        batchMetrics.merge(metrics);
+                    }
+                } catch (const std::exception &e) {
+                    std::lock_guard<std::mutex> lock(outputMutex);
+                    std::cout << "\t-> " << molPath << " : " << e.what() << std::endl;
+                }
 
-    /* Generate discrete molecule from molecule-mesh */
-    RDKit::RWMol *discrMolecule = Transformer::sintetize(*moleculeMesh);
+                if (!succeed) failed++;
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << (succeed ? "\t-> done : " : "\t-> failed : ") << molPath << " -> " << outDir
+                          << std::endl;
+            });
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
 
-    /* Save discrete molecule */
-    std::string discrMoleculePath = "./outs/Molecule.pdb";
+    double elapsed = Pipeline::elapsedTime(startTime, endTime);
+    size_t processed = paths.size() - failed;
+    std::cout << "Processed " << processed << "/" << paths.size() << " molecules in " << elapsed << " s"
+              << " -> " << (elapsed > 0 ? static_cast<double>(processed) / elapsed : 0) << " molecules/s"
+              << std::endl;
 
-    std::cout << "\t-> saving discrete molecule file -> ";
-    RDKit::MolToPDBFile(*discrMolecule, discrMoleculePath);
-    std::cout << discrMoleculePath << std::endl;
+    if (Metrics::isEnabled()) {
+        Pipeline::writeMetricsSummary(batchMetrics, processed, failed, elapsed, "./outs/metrics_summary.json");
+        std::cout << "Metrics summary -> ./outs/metrics_summary.json" << std::endl;
+    }
 
-    /* Retrive interaction list */
-    std::vector<std::pair<std::string, Interaction *>> interactions = InteractionCollection::buildList();
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    /* Get processing options */
+    Pipeline::Options options;
+    bool validOptions = true, occupancy = false;
+    while (!args.empty() && (args[0] == "--labeled" || args[0] == "--conformers" || args[0] == "--sparse" ||
+                             args[0] == "--metrics" || args[0] == "--incremental" || args[0] == "--occupancy" ||
+                             (args.size() >= 2 &&
+                              (args[0] == "--format" || args[0] == "--grain" || args[0] == "--backend" ||
+                               args[0] == "--distance" || args[0] == "--mask" || args[0] == "--probe")))) {
+        if (args[0] == "--labeled" || args[0] == "--conformers" || args[0] == "--sparse" || args[0] == "--metrics" ||
+            args[0] == "--incremental" || args[0] == "--occupancy") {
+            if (args[0] == "--labeled") options.labeled = true;
+            else if (args[0] == "--conformers") options.allConformers = true;
+            else if (args[0] == "--incremental") options.allConformers = options.incremental = true;
+            else if (args[0] == "--occupancy") occupancy = true;
+            else if (args[0] == "--sparse") options.sparse = true;
+            else Metrics::setEnabled(true);
+            args.erase(args.begin());
+            continue;
+        }
+        if (args[0] == "--grain") {
+            char *end;
+            long grain = strtol(args[1].c_str(), &end, 10);
+            if (*end != '\0' || grain < 1) validOptions = false;
+            else options.grain = static_cast<int>(grain);
+            args.erase(args.begin(), args.begin() + 2);
+            continue;
+        }
+        if (args[0] == "--backend") {
+            try {
+                Backend::select(Backend::parse(args[1]));
+            } catch (const std::invalid_argument &) {
+                validOptions = false;
+            }
+            args.erase(args.begin(), args.begin() + 2);
+            continue;
+        }
+        if (args[0] == "--mask") {
+            if (args[1] == "vdw") options.mask = Pipeline::VDW;
+            else if (args[1] == "sas") options.mask = Pipeline::SAS;
+            else if (args[1] == "ses") options.mask = Pipeline::SES;
+            else validOptions = false;
+            args.erase(args.begin(), args.begin() + 2);
+            continue;
+        }
+        if (args[0] == "--probe") {
+            char *end;
+            double probeRadius = strtod(args[1].c_str(), &end);
+            if (*end != '\0' || !(probeRadius > 0)) validOptions = false;
+            else options.probeRadius = probeRadius;
+            args.erase(args.begin(), args.begin() + 2);
+            continue;
+        }
+        if (args[0] == "--distance") {
+            try {
+                DistanceTransform::select(DistanceTransform::parse(args[1]));
+            } catch (const std::invalid_argument &) {
+                validOptions = false;
+            }
+            args.erase(args.begin(), args.begin() + 2);
+            continue;
+        }
+        if (args[1] == "pdb") options.format = Pipeline::PDB;
+        else if (args[1] == "grid") options.format = Pipeline::GRID;
+        else if (args[1] == "mrc") options.format = Pipeline::MRC;
+        else if (args[1] == "dx") options.format = Pipeline::DX;
+        else if (args[1] == "mrc-channels") options.format = Pipeline::MRC_CHANNELS;
+        else validOptions = false;
+        args.erase(args.begin(), args.begin() + 2);
+    }
 
-    /* Iterate over interaction list */
-    for (const std::pair<std::string, Interaction *> &interaction: interactions) {
-        Interaction *inter = interaction.second;
-        std::string desc = interaction.first;
+    /* Get molecule file path (or batch/stream description) */
+    std::string mode = !args.empty() ? args[0] : "";
+    bool batch = args.size() >= 2 && mode == "--batch";
+    bool stream = args.size() >= 2 && mode == "--stream";
+    unsigned int numThreads = 0;
+    if ((batch || stream) && args.size() == 3) {
+        char *end;
+        long threads = strtol(args[2].c_str(), &end, 10);
+        if (*end != '\0' || threads < 1) validOptions = false;
+        else numThreads = static_cast<unsigned int>(threads);
+    }
+    if (!validOptions || (!batch && !stream && args.size() != 1) || ((batch || stream) && args.size() > 3) ||
+        (batch && occupancy)) {
+        std::cout << "Usage:\tProLIF_coloring [options] <molecule_path>" << std::endl;
+        std::cout << "      \tProLIF_coloring [options] --batch <list_file|directory> [num_threads]" << std::endl;
+        std::cout << "      \tProLIF_coloring [options] --stream <multi_model.pdb|multi_record.sdf> [num_threads]"
+                  << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "      \t--format pdb|grid|mrc|dx|mrc-channels\toutput format of discrete meshes (default pdb)"
+                  << std::endl;
+        std::cout << "      \t--labeled\t\t\t\tcalculate all interactions into a single labeled mesh" << std::endl;
+        std::cout << "      \t--conformers\t\t\t\tprocess every conformer of a molecule (default only the first one)"
+                  << std::endl;
+        std::cout << "      \t--incremental\t\t\t\tprocess conformers as trajectory frames, updating the meshes by the"
+                  << " atoms that moved (implies --conformers)" << std::endl;
+        std::cout << "      \t--sparse\t\t\t\tkeep interaction meshes as sparse (brick) meshes" << std::endl;
+        std::cout << "      \t--grain <voxels>\t\t\tnumber of voxels per Angstrom (default " << GRAIN << ")"
+                  << std::endl;
+        std::cout << "      \t--backend auto|serial|omp|cuda\t\tbackend of mesh operations and interactions"
+                  << " (default auto)" << std::endl;
+        std::cout << "      \t--distance auto|stamp|edt\t\tengine of distance-based interactions, pattern stamping or"
+                  << " distance transform (default auto)" << std::endl;
+        std::cout << "      \t--mask vdw|sas|ses\t\t\tmodel of the molecule subtracted from interactions, atom spheres,"
+                  << " solvent-accessible or solvent-excluded (default vdw)" << std::endl;
+        std::cout << "      \t--probe <radius>\t\t\tradius of the solvent probe of the sas and ses masks, in Angstrom"
+                  << " (default 1.4)" << std::endl;
+        std::cout << "      \t--metrics\t\t\t\tsave timers and counters of each molecule (and of the batch) as JSON"
+                  << std::endl;
+        std::cout << "      \t--occupancy\t\t\t\tsave the fraction of conformers (or stream records) covering each"
+                  << " voxel, one density map per interaction (mrc, or dx)" << std::endl;
+        return 1;
+    }
 
-        /* Generate a support-mesh for interaction as large as molecule one */
-        MoleculeMesh interactionMesh(moleculeMesh->dim_x, moleculeMesh->dim_y, moleculeMesh->dim_z,
-                                     moleculeMesh->globalDisplacement, moleculeMesh->internalDisplacement);
+    /* Setup directory for output files */
+    std::filesystem::create_directory("./outs/");
 
-        std::cout << "Calculating interaction: " << desc << std::endl;
-        clock_gettime(CLOCK_MONOTONIC, &startTime);
-        bool succeed = inter->getInteraction(molecule, interactionMesh, *moleculeMesh);
-        clock_gettime(CLOCK_MONOTONIC, &endTime);
+    if (batch) {
+        std::vector<std::string> paths = collectBatch(args[1]);
+        return processBatch(paths, options, numThreads) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-        /* If interaction mesh generation has succeeded */
-        if (succeed) {
-            auto elapsed = static_cast<double>((endTime.tv_sec - startTime.tv_sec));
-            elapsed += static_cast<double>((endTime.tv_nsec - startTime.tv_nsec)) / 1000000000.0;
-            std::cout << "\t-> elapsed time : " << elapsed << std::endl;
+    if (stream) {
+        std::unique_ptr<MoleculeReader> reader;
+        try {
+            reader = std::make_unique<MoleculeReader>(args[1]);
+        } catch (const std::runtime_error &) {
+            std::cout << "Unable to read molecules from " << args[1] << std::endl;
+            return EXIT_FAILURE;
+        }
+        InteractionCollection::list_t interactions = InteractionCollection::buildList();
+        if (occupancy)
+            return Pipeline::accumulate(*reader, interactions, "./outs/", options, numThreads) == 0 ? EXIT_SUCCESS
+                                                                                                    : EXIT_FAILURE;
+        return Pipeline::stream(*reader, interactions, "./outs/", options, numThreads) == 0 ? EXIT_SUCCESS
+                                                                                            : EXIT_FAILURE;
+    }
 
-            /* Generate discrete molecule from interaction-mesh */
-            RDKit::RWMol *discrInteraction = Transformer::sintetize(interactionMesh);
+    std::string molPath = args[0];
 
-            /* Save discrete interaction */
-            std::string interactionPath = "./outs/" + desc + ".pdb";
+    /* Read molecule file */
+    std::unique_ptr<RDKit::ROMol> molecule(RDKit::PDBFileToMol(molPath, true, false));
+    if (molecule == nullptr || molecule->getNumConformers() == 0) {
+        std::cout << "Unable to read a molecule with coordinates from " << molPath << std::endl;
+        return EXIT_FAILURE;
+    }
 
-            std::cout << "\t-> saving discrete interaction file -> ";
-            RDKit::MolToPDBFile(*discrInteraction, interactionPath);
-            std::cout << interactionPath << std::endl;
+    /* Retrive interaction list */
+    InteractionCollection::list_t interactions = InteractionCollection::buildList();
 
-        }else{
-            std::cout << "\t-> no interaction found" << std::endl;
-        }
+    /* Accumulate the occupancy of the conformers, then save it */
+    if (occupancy) {
+        Pipeline::Occupancy conformersOccupancy = Pipeline::accumulate(*molecule, interactions, options);
+        std::filesystem::create_directory("./outs/occupancy/");
+        std::cout << "Accumulated " << conformersOccupancy.frames << " conformers" << std::endl;
+        Pipeline::writeOccupancy(conformersOccupancy, "./outs/occupancy/", options.format, true);
+        return EXIT_SUCCESS;
     }
 
+    /* Generate molecule mesh and interactions, then save them */
+    std::vector<std::unique_ptr<Pipeline::Result>> results =
+            Pipeline::computeAll(*molecule, interactions, options, true);
+    Pipeline::writeAll(results, "./outs/", options, true);
+
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -1,35 +1,12 @@
 
 #include "DistanceInteraction.hpp"
+#include "StencilCache.hpp"
+#include "ScratchArena.hpp"
 #include <vector>
+#include <stdexcept>
 
-__global__
-void buildBubble_ker(MoleculeMesh::data_t *bubble, const double inter_d, const int maskEdge) {
-    int thr_id = static_cast<int>(blockIdx.x * blockDim.x + threadIdx.x);
-    const int layerDim = maskEdge * maskEdge;
-
-    if (thr_id < layerDim * maskEdge) {
-        const int z_cord = thr_id / layerDim;
-        const int y_cord = (thr_id % layerDim) / maskEdge;
-        const int x_cord = (thr_id % layerDim) % maskEdge;
-
-        const int maskRadius = maskEdge / 2;
-
-        // Over all size of pattern-mesh assign if (point-distance <= #distance) from the center of mesh
-        double ds = inter_d * inter_d;
-        int dz = z_cord - maskRadius;
-        int z_res = dz * dz;
-        int dy = y_cord - maskRadius;
-        int y_res = dy * dy;
-        int dx = x_cord - maskRadius;
-        int x_res = dx * dx;
-
-        bubble[thr_id] = (x_res + y_res + z_res <= ds);
-    }
-}
-
-
-bool DistanceInteraction::getInteraction(const RDKit::ROMol *molecule, MoleculeMesh &interactionMask,
-                                         MoleculeMesh &subtractionMask) {
+bool DistanceInteraction::getInteractionCuda(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                                             MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
     cudaError_t err;
     MoleculeMesh::data_t *bubble_data = nullptr;
     MoleculeMesh::data_t *interaction_data = nullptr;
@@ -37,87 +14,80 @@ bool DistanceInteraction::getInteraction(const RDKit::ROMol *molecule, MoleculeM
     bool ris = false;
 
     try {
-        // Get molecule conformer and retrive matches of smart into given molecule
-        RDKit::Conformer conformer = molecule->getConformer();
-        std::vector<RDKit::MatchVectType> *matches = Interaction::findMatch(molecule);
-
         if (matches->empty()) return false;
 
-        // Discretize mask radius and calculate mask dimension
-        // Over all size of pattern-mesh assign if (point-distance <= #distance) from the center of mesh
-        double scaledDistance = distance * GRAIN;
+        // Resolve the interaction-centroid of every match into the coordinate block
+        std::pmr::vector<int> centroids(ScratchArena::resource());
+        Interaction::resolveMatches(*matches, 1, centroids);
+
+        // Discretize mask radius (at the grain of the support-mesh) and retrieve the (shared) spherical pattern
+        const int grain = interactionMask.grain;
+        double scaledDistance = distance * grain;
         int scaledMaskRadius = static_cast<int>(ceil(scaledDistance));
         int maskDim = 2 * scaledMaskRadius;
 
-        int bubbleDim = maskDim * maskDim * maskDim;
-
-        err = cudaMalloc((void **) &bubble_data, sizeof(MoleculeMesh::data_t) * (bubbleDim));
-        if (err != cudaSuccess) throw;
-
-        unsigned int numBlocks = (interactionMask.getDataSize() + BLOCK_SIZE) / BLOCK_SIZE;
+        // The device merge works on dense pattern-meshes, so the shared pattern is rasterized once per call
+        MoleculeMesh bubble(maskDim, maskDim, maskDim);
+        bubble.stamp(StencilCache::sphere(distance, grain), 0, 0, 0);
 
+        err = cudaMalloc((void **) &bubble_data, sizeof(MoleculeMesh::data_t) * bubble.getDataSize());
+        if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
-        buildBubble_ker<<<numBlocks, BLOCK_SIZE>>>(bubble_data, scaledDistance, maskDim);
-        err = cudaGetLastError();
-        if (err != cudaSuccess) throw;
-
+        err = cudaMemcpy(bubble_data, bubble.getData(),
+                         sizeof(MoleculeMesh::data_t) * bubble.getDataSize(), cudaMemcpyHostToDevice);
+        if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
         err = cudaMalloc((void **) &interaction_data, sizeof(MoleculeMesh::data_t) * interactionMask.getDataSize());
-        if (err != cudaSuccess) throw;
+        if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
         // For each interaction-centroid apply the pattern-mesh centered at centroid onto the support-mesh
         auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskRadius);
 
-        for (RDKit::MatchVectType match: *matches) {
-            if (!match.empty()) {
-                ris = true;
-                // Get interaction match centroid position
-                auto atomId = match.at(0).second;
-                RDGeom::Point3D pos = conformer.getAtomPos(atomId);
+        for (int atomId: centroids) {
+            ris = true;
 
-                // Find the zero-point displacement of pattern from the zero-point of support-mask
-                double px = (pos.x - interactionMask.globalDisplacement.x) * GRAIN + paddingDisplacement;
-                double py = (pos.y - interactionMask.globalDisplacement.y) * GRAIN + paddingDisplacement;
-                double pz = (pos.z - interactionMask.globalDisplacement.z) * GRAIN + paddingDisplacement;
+            // Find the zero-point displacement of pattern from the zero-point of support-mask
+            double px = (context.x[atomId] - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+            double py = (context.y[atomId] - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+            double pz = (context.z[atomId] - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
 
-                // Discretize the displacement
-                int displ_x = static_cast<int>(round(px));
-                int displ_y = static_cast<int>(round(py));
-                int displ_z = static_cast<int>(round(pz));
+            // Discretize the displacement
+            int displ_x = static_cast<int>(round(px));
+            int displ_y = static_cast<int>(round(py));
+            int displ_z = static_cast<int>(round(pz));
 
-                MoleculeMesh::addMeshes(interaction_data, bubble_data,
+            MoleculeMesh::addMeshesCuda(interaction_data, bubble_data,
                                         displ_x, displ_y, displ_z,
                                         interactionMask.dim_x, interactionMask.dim_y, interactionMask.dim_z,
                                         maskDim, maskDim, maskDim);
-                err = cudaGetLastError();
-                if (err != cudaSuccess) throw;
-            }
+            err = cudaGetLastError();
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
         }
 
         if (subtractionMask.getDataSize()!=0) {
             err = cudaMalloc((void **) &subtraction_data, sizeof(MoleculeMesh::data_t) * subtractionMask.getDataSize());
-            if (err != cudaSuccess) throw;
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
             err = cudaMemcpy(subtraction_data, subtractionMask.getData(),
                              sizeof(MoleculeMesh::data_t) * subtractionMask.getDataSize(), cudaMemcpyHostToDevice);
-            if (err != cudaSuccess) throw;
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
-            MoleculeMesh::subMeshes(interaction_data, subtraction_data,
-                                    0, 0, 0,
-                                    interactionMask.dim_x, interactionMask.dim_y, interactionMask.dim_z,
-                                    subtractionMask.dim_x, subtractionMask.dim_y, subtractionMask.dim_z);
+            MoleculeMesh::subMeshesCuda(interaction_data, subtraction_data,
+                                        0, 0, 0,
+                                        interactionMask.dim_x, interactionMask.dim_y, interactionMask.dim_z,
+                                        subtractionMask.dim_x, subtractionMask.dim_y, subtractionMask.dim_z);
             err = cudaGetLastError();
-            if (err != cudaSuccess) throw;
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
         }
 
 
         err = cudaMemcpy(interactionMask.getData(), interaction_data,
                          sizeof(MoleculeMesh::data_t) * interactionMask.getDataSize(), cudaMemcpyDeviceToHost);
-        if(err != cudaSuccess) throw;
+        if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
-    } catch (...) {
+    } catch (const std::exception &e) {
         ris = false;
-        std::cout << cudaGetErrorString(err) << std::endl;
+        std::cout << e.what() << std::endl;
     }
 
     if(bubble_data != nullptr) cudaFree(bubble_data);
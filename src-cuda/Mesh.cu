@@ -1,6 +1,29 @@
 
 #include "Mesh.hpp"
 
+__device__
+MoleculeMesh::data_t fetchWord_dev(const MoleculeMesh::data_t *row, const int offset, const int words_x) {
+    const int word = offset >= 0 ? offset / MoleculeMesh::wordBits
+                                 : -((MoleculeMesh::wordBits - 1 - offset) / MoleculeMesh::wordBits);
+    const int shift = offset - word * MoleculeMesh::wordBits;
+    MoleculeMesh::data_t lo = (word >= 0 && word < words_x) ? row[word] : 0;
+    if (shift == 0) return lo;
+    MoleculeMesh::data_t hi = (word + 1 >= 0 && word + 1 < words_x) ? row[word + 1] : 0;
+    return (lo >> shift) | (hi << (MoleculeMesh::wordBits - shift));
+}
+
+__device__
+MoleculeMesh::data_t rangeMask_dev(const int word, const int begin, const int end) {
+    int lo = begin - word * MoleculeMesh::wordBits;
+    int hi = end - word * MoleculeMesh::wordBits;
+    if (lo < 0) lo = 0;
+    if (hi > MoleculeMesh::wordBits) hi = MoleculeMesh::wordBits;
+    if (lo >= hi) return 0;
+    MoleculeMesh::data_t upper = hi == MoleculeMesh::wordBits ? ~MoleculeMesh::data_t(0)
+                                                              : (MoleculeMesh::data_t(1) << hi) - 1;
+    return upper & ~((MoleculeMesh::data_t(1) << lo) - 1);
+}
+
 __global__
 void addMask_ker(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
                  const int displ_x, const int displ_y, const int displ_z,
@@ -9,32 +32,38 @@ void addMask_ker(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
 
     const int thr_id = static_cast<int>(blockIdx.x * blockDim.x + threadIdx.x);
 
+    const int data_words_x = (data_dim_x + MoleculeMesh::wordBits - 1) / MoleculeMesh::wordBits;
+    const int add_words_x = (add_dim_x + MoleculeMesh::wordBits - 1) / MoleculeMesh::wordBits;
 
-    const int data_layer_size = data_dim_x * data_dim_y;
+    const int data_layer_size = data_words_x * data_dim_y;
     const int data_z = thr_id / data_layer_size;
 
     if (data_z < data_dim_z) {
-        const int data_y = (thr_id % data_layer_size) / data_dim_y;
-        const int data_x = (thr_id % data_layer_size) % data_dim_y;
+        const int data_y = (thr_id % data_layer_size) / data_words_x;
+        const int data_w = (thr_id % data_layer_size) % data_words_x;
 
         const int add_z = data_z - displ_z;
         const int add_y = data_y - displ_y;
-        const int add_x = data_x - displ_x;
 
-        if (add_z >= 0 && add_y >= 0 && add_x >= 0 && add_z < add_dim_z && add_y < add_dim_y && add_x < add_dim_x) {
-            const int data_id = data_dim_x * (data_z * data_dim_y + data_y) + data_x;
-            const int add_id = add_dim_x * (add_z * add_dim_y + add_y) + add_x;
-            data[data_id] = data[data_id] || to_add[add_id];
+        if (add_z >= 0 && add_y >= 0 && add_z < add_dim_z && add_y < add_dim_y) {
+            // Voxels of the data word that are covered by the addend x-row
+            int sx = displ_x < 0 ? 0 : displ_x;
+            int ex = add_dim_x + displ_x < data_dim_x ? add_dim_x + displ_x : data_dim_x;
+
+            const MoleculeMesh::data_t *add_row = to_add + add_words_x * (add_z * add_dim_y + add_y);
+            const int data_id = data_words_x * (data_z * data_dim_y + data_y) + data_w;
+            data[data_id] |= fetchWord_dev(add_row, data_w * MoleculeMesh::wordBits - displ_x, add_words_x) &
+                             rangeMask_dev(data_w, sx, ex);
         }
     }
 }
 
-void MoleculeMesh::addMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_add,
-                             const int displ_x, const int displ_y, const int displ_z,
-                             const int data_dim_x, const int data_dim_y, const int data_dim_z,
-                             const int add_dim_x, const int add_dim_y, const int add_dim_z) {
+void MoleculeMesh::addMeshesCuda(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
+                                 const int displ_x, const int displ_y, const int displ_z,
+                                 const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                                 const int add_dim_x, const int add_dim_y, const int add_dim_z) {
 
-    int dataDim = data_dim_x * data_dim_y * data_dim_z;
+    int dataDim = MoleculeMesh::rowWords(data_dim_x) * data_dim_y * data_dim_z;
     unsigned int numBlocks = (dataDim + BLOCK_SIZE) / (BLOCK_SIZE);
 
     addMask_ker<<<numBlocks, BLOCK_SIZE>>>(data, to_add, displ_x, displ_y, displ_z,
@@ -50,34 +79,42 @@ void subMask_ker(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subt
 
     int thr_id = static_cast<int>(blockIdx.x * blockDim.x + threadIdx.x);
 
-    const int data_layer_size = data_dim_x * data_dim_y;
+    const int data_words_x = (data_dim_x + MoleculeMesh::wordBits - 1) / MoleculeMesh::wordBits;
+    const int sub_words_x = (sub_dim_x + MoleculeMesh::wordBits - 1) / MoleculeMesh::wordBits;
+
+    const int data_layer_size = data_words_x * data_dim_y;
     const int data_z = thr_id / data_layer_size;
 
     if (data_z < data_dim_z) {
-        const int data_y = (thr_id % data_layer_size) / data_dim_y;
-        const int data_x = (thr_id % data_layer_size) % data_dim_y;
+        const int data_y = (thr_id % data_layer_size) / data_words_x;
+        const int data_w = (thr_id % data_layer_size) % data_words_x;
 
         const int sub_z = data_z - displ_z;
         const int sub_y = data_y - displ_y;
-        const int sub_x = data_x - displ_x;
 
-        if (sub_z >= 0 && sub_y >= 0 && sub_x >= 0 && sub_z < sub_dim_z && sub_y < sub_dim_y && sub_x < sub_dim_x) {
-            const int data_id = data_dim_x * (data_z * data_dim_y + data_y) + data_x;
-            const int sub_id = sub_dim_x * (sub_z * sub_dim_y + sub_y) + sub_x;
-            data[data_id] = data[data_id] && !to_subtract[sub_id];
+        if (sub_z >= 0 && sub_y >= 0 && sub_z < sub_dim_z && sub_y < sub_dim_y) {
+            // Voxels of the data word that are covered by the subtrahend x-row
+            int sx = displ_x < 0 ? 0 : displ_x;
+            int ex = sub_dim_x + displ_x < data_dim_x ? sub_dim_x + displ_x : data_dim_x;
+
+            const MoleculeMesh::data_t *sub_row = to_subtract + sub_words_x * (sub_z * sub_dim_y + sub_y);
+            const int data_id = data_words_x * (data_z * data_dim_y + data_y) + data_w;
+            data[data_id] &= ~(fetchWord_dev(sub_row, data_w * MoleculeMesh::wordBits - displ_x, sub_words_x) &
+                               rangeMask_dev(data_w, sx, ex));
         }
     }
 }
 
-void MoleculeMesh::subMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_subtract,
-                             const int displ_x, const int displ_y, const int displ_z,
-                             const int data_dim_x, const int data_dim_y, const int data_dim_z,
-                             const int sub_dim_x, const int sub_dim_y, const int sub_dim_z) {
+void MoleculeMesh::subMeshesCuda(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
+                                 const int displ_x, const int displ_y, const int displ_z,
+                                 const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                                 const int sub_dim_x, const int sub_dim_y, const int sub_dim_z) {
 
-    int dataDim = data_dim_x * data_dim_y * data_dim_z;
+    int dataDim = MoleculeMesh::rowWords(data_dim_x) * data_dim_y * data_dim_z;
     unsigned int numBlocks = (dataDim + BLOCK_SIZE) / (BLOCK_SIZE);
 
     subMask_ker<<<numBlocks, BLOCK_SIZE>>>(data, to_subtract, displ_x, displ_y, displ_z,
                                            data_dim_x, data_dim_y, data_dim_z,
                                            sub_dim_x, sub_dim_y, sub_dim_z);
 }
+
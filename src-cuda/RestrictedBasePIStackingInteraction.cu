@@ -0,0 +1,87 @@
+
+#include "RestrictedBasePIStackingInteraction.hpp"
+#include "ScratchArena.hpp"
+#include <vector>
+#include <stdexcept>
+
+bool RestrictedBasePIStackingInteraction::getInteractionCuda(const MoleculeContext &context,
+                                                             const MatchCache::matches_t &matches,
+                                                             MoleculeMesh &interactionMask,
+                                                             MoleculeMesh &subtractionMask) {
+    cudaError_t err = cudaSuccess;
+    MoleculeMesh::data_t *interaction_data = nullptr;
+    MoleculeMesh::data_t *subtraction_data = nullptr;
+    bool ris = false;
+
+    try {
+        if (matches->empty()) return false;
+
+        // Rings are few, so their sparse patterns are generated and applied on the host
+        SpanStencil bubble(0, 0, 0, ScratchArena::resource());
+        // Pattern rasterizer at the grain of the support-mesh
+        const int grain = interactionMask.grain;
+        const RingStencil ring(distance, {min_angle_ring, max_angle_ring}, {min_angle_cent, max_angle_cent},
+                               intersect, intersect_radius, grain);
+        int scaledMaskCenter = ring.getCenter();
+        auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
+
+        for (const RDKit::MatchVectType &match: *matches) {
+            RDGeom::Point3D center, normal;
+            if (!RingStencil::ringFrame(context, match, center, normal)) continue;
+            ris = true;
+
+            // Generate pattern-mesh runs around the ring centroid
+            ring.build(normal, bubble);
+
+            // Find the zero-point displacement of pattern from the zero-point of support-mask
+            double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+            double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+            double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+            // Discretize the displacement
+            int displ_x = static_cast<int>(round(px));
+            int displ_y = static_cast<int>(round(py));
+            int displ_z = static_cast<int>(round(pz));
+
+            // Apply pattern at displacement onto support-mesh
+            interactionMask.stamp(bubble, displ_x, displ_y, displ_z);
+        }
+
+        // The subtraction is performed on the device
+        if (ris && subtractionMask.getDataSize() != 0) {
+            err = cudaMalloc((void **) &interaction_data, sizeof(MoleculeMesh::data_t) * interactionMask.getDataSize());
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+
+            err = cudaMemcpy(interaction_data, interactionMask.getData(),
+                             sizeof(MoleculeMesh::data_t) * interactionMask.getDataSize(), cudaMemcpyHostToDevice);
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+
+            err = cudaMalloc((void **) &subtraction_data, sizeof(MoleculeMesh::data_t) * subtractionMask.getDataSize());
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+
+            err = cudaMemcpy(subtraction_data, subtractionMask.getData(),
+                             sizeof(MoleculeMesh::data_t) * subtractionMask.getDataSize(), cudaMemcpyHostToDevice);
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+
+            MoleculeMesh::subMeshesCuda(interaction_data, subtraction_data,
+                                        0, 0, 0,
+                                        interactionMask.dim_x, interactionMask.dim_y, interactionMask.dim_z,
+                                        subtractionMask.dim_x, subtractionMask.dim_y, subtractionMask.dim_z);
+            err = cudaGetLastError();
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+
+            err = cudaMemcpy(interactionMask.getData(), interaction_data,
+                             sizeof(MoleculeMesh::data_t) * interactionMask.getDataSize(), cudaMemcpyDeviceToHost);
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+        }
+
+    } catch (const std::exception &e) {
+        ris = false;
+        std::cout << e.what() << std::endl;
+    }
+
+    if (interaction_data != nullptr) cudaFree(interaction_data);
+    if (subtraction_data != nullptr) cudaFree(subtraction_data);
+
+    return ris;
+}
@@ -1,6 +1,8 @@
 
 #include "SingleAngleInteraction.hpp"
+#include "ScratchArena.hpp"
 #include <cuda/std/cmath>
+#include <stdexcept>
 
 __device__
 double lengthSq(double x, double y, double z) {
@@ -40,13 +42,14 @@ void buildBubbleSlice_ker(MoleculeMesh::data_t *bubble,
                           const int maskEdge) {
 
     int thr_id = static_cast<int>(blockIdx.x * blockDim.x + threadIdx.x);
-    const int layerDim = maskEdge * maskEdge;
+    const int wordsEdge = (maskEdge + MoleculeMesh::wordBits - 1) / MoleculeMesh::wordBits;
+    const int layerDim = wordsEdge * maskEdge;
 
     if (thr_id < layerDim * maskEdge) {
 
         const int z_cord = thr_id / layerDim;
-        const int y_cord = (thr_id % layerDim) / maskEdge;
-        const int x_cord = (thr_id % layerDim) % maskEdge;
+        const int y_cord = (thr_id % layerDim) / wordsEdge;
+        const int w_cord = (thr_id % layerDim) % wordsEdge;
 
         const int maskRadius = maskEdge / 2;
 
@@ -72,34 +75,45 @@ void buildBubbleSlice_ker(MoleculeMesh::data_t *bubble,
         int z_res = dz * dz;
         int dy = y_cord - maskRadius;
         int y_res = dy * dy;
-        int dx = x_cord - maskRadius;
-        int x_res = dx * dx;
 
-        // Position of l1 is calculated taking account of pattern-center position
+        // Each thread packs the voxels of one data word of the x-row
+        MoleculeMesh::data_t word = 0;
+        for (int b = 0; b < MoleculeMesh::wordBits; ++b) {
+            int x_cord = w_cord * MoleculeMesh::wordBits + b;
+            if (x_cord >= maskEdge) break;
 
-        double l1_z = z_cord + center_z;
-        double l1_y = y_cord + center_y;
-        double l1_x = x_cord + center_x;
+            int dx = x_cord - maskRadius;
+            int x_res = dx * dx;
 
-        // Calculate vector p2 --> l1
-        double p2l1_x = l1_x - p2_x;
-        double p2l1_y = l1_y - p2_y;
-        double p2l1_z = l1_z - p2_z;
+            // Position of l1 is calculated taking account of pattern-center position
 
-        double p2l1_l = cuda::std::sqrt(lengthSq(p2l1_x, p2l1_y, p2l1_z));
-        p2l1_x /= p2l1_l;
-        p2l1_y /= p2l1_l;
-        p2l1_z /= p2l1_l;
+            double l1_z = z_cord + center_z;
+            double l1_y = y_cord + center_y;
+            double l1_x = x_cord + center_x;
 
-        // Calculate angle l1 <-- p2 --> p1
-        double angle = angleTo(p2p1_x, p2p1_y, p2p1_z, p2l1_x, p2l1_y, p2l1_z);
+            // Calculate vector p2 --> l1
+            double p2l1_x = l1_x - p2_x;
+            double p2l1_y = l1_y - p2_y;
+            double p2l1_z = l1_z - p2_z;
 
-        bubble[thr_id] = (x_res + y_res + z_res <= ds && angle >= min_angle && angle <= max_angle);
+            double p2l1_l = cuda::std::sqrt(lengthSq(p2l1_x, p2l1_y, p2l1_z));
+            p2l1_x /= p2l1_l;
+            p2l1_y /= p2l1_l;
+            p2l1_z /= p2l1_l;
+
+            // Calculate angle l1 <-- p2 --> p1
+            double angle = angleTo(p2p1_x, p2p1_y, p2p1_z, p2l1_x, p2l1_y, p2l1_z);
+
+            if (x_res + y_res + z_res <= ds && angle >= min_angle && angle <= max_angle)
+                word |= MoleculeMesh::data_t(1) << b;
+        }
+
+        bubble[thr_id] = word;
     }
 }
 
-bool SingleAngleInteraction::getInteraction(const RDKit::ROMol *molecule,
-                                            MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
+bool SingleAngleInteraction::getInteractionCuda(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                                                MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
     cudaError_t err;
     MoleculeMesh::data_t *bubble_data = nullptr;
     MoleculeMesh::data_t *interaction_data = nullptr;
@@ -107,95 +121,92 @@ bool SingleAngleInteraction::getInteraction(const RDKit::ROMol *molecule,
     bool ris = false;
 
     try {
-        // Get molecule conformer and retrive matches of smart into given molecule
-        RDKit::Conformer conformer = molecule->getConformer();
-        std::vector<RDKit::MatchVectType> *matches = Interaction::findMatch(molecule);
-
         if (matches->empty()) return false;
 
-        // Calculate mask size and centering coordinates
-        double scaledDistance = distance * GRAIN;
+        // Resolve the centroids <p1, p2> of every match into the coordinate block
+        std::pmr::vector<int> centroids(ScratchArena::resource());
+        Interaction::resolveMatches(*matches, 2, centroids);
+
+        // Calculate mask size and centering coordinates (at the grain of the support-mesh)
+        const int grain = interactionMask.grain;
+        double scaledDistance = distance * grain;
         auto scaledMaskCenter = static_cast<int>(ceil(scaledDistance));
         int maskDim = 2 * scaledMaskCenter;
 
 
-        int bubbleDim = maskDim * maskDim * maskDim;
+        int bubbleDim = MoleculeMesh::rowWords(maskDim) * maskDim * maskDim;
 
         unsigned int numBlocks = (interactionMask.getDataSize() + BLOCK_SIZE) / BLOCK_SIZE;
 
         err = cudaMalloc((void **) &bubble_data, sizeof(MoleculeMesh::data_t) * (bubbleDim));
-        if (err != cudaSuccess) throw;
+        if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
         err = cudaMalloc((void **) &interaction_data, sizeof(MoleculeMesh::data_t) * interactionMask.getDataSize());
-        if (err != cudaSuccess) throw;
-
-        for (RDKit::MatchVectType match: *matches) {
-            if (match.size() >= 2) {
-                ris = true;
-
-                // Get molecule match and its centroids position
-                auto p1Id = match.at(0).second;
-                auto p1 = conformer.getAtomPos(p1Id);
-                auto p2Id = match.at(1).second;
-                auto p2 = conformer.getAtomPos(p2Id);
-
-                RDGeom::Point3D center;
-                if (cp) center = p1;
-                else center = p2;
-
-                buildBubbleSlice_ker<<<numBlocks, BLOCK_SIZE>>>(bubble_data,
-                                                                scaledDistance, min_angle, max_angle,
-                                                                center.x, center.y, center.z,
-                                                                p1.x, p1.y, p1.z,
-                                                                p2.x, p2.y, p2.z,
-                                                                maskDim);
-                err = cudaGetLastError();
-                if (err != cudaSuccess) throw;
-
-                // Find the zero-point displacement of pattern from the zero-point of support-mask
-                auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
-                double px = (center.x - interactionMask.globalDisplacement.x) * GRAIN + paddingDisplacement;
-                double py = (center.y - interactionMask.globalDisplacement.y) * GRAIN + paddingDisplacement;
-                double pz = (center.z - interactionMask.globalDisplacement.z) * GRAIN + paddingDisplacement;
-
-                // Discretize the displacement
-                int displ_x = static_cast<int>(round(px));
-                int displ_y = static_cast<int>(round(py));
-                int displ_z = static_cast<int>(round(pz));
-
-                // Apply pattern at displacement onto support-mesh
-                MoleculeMesh::addMeshes(interaction_data, bubble_data,
+        if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+
+        for (size_t i = 0; i < centroids.size(); i += 2) {
+            ris = true;
+
+            // Get molecule match centroids position
+            RDGeom::Point3D p1 = context.getAtomPos(centroids[i]);
+            RDGeom::Point3D p2 = context.getAtomPos(centroids[i + 1]);
+
+            RDGeom::Point3D center;
+            if (cp) center = p1;
+            else center = p2;
+
+            buildBubbleSlice_ker<<<numBlocks, BLOCK_SIZE>>>(bubble_data,
+                                                            scaledDistance, min_angle, max_angle,
+                                                            center.x, center.y, center.z,
+                                                            p1.x, p1.y, p1.z,
+                                                            p2.x, p2.y, p2.z,
+                                                            maskDim);
+            err = cudaGetLastError();
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
+
+            // Find the zero-point displacement of pattern from the zero-point of support-mask
+            auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
+            double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+            double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+            double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+            // Discretize the displacement
+            int displ_x = static_cast<int>(round(px));
+            int displ_y = static_cast<int>(round(py));
+            int displ_z = static_cast<int>(round(pz));
+
+            // Apply pattern at displacement onto support-mesh
+            MoleculeMesh::addMeshesCuda(interaction_data, bubble_data,
                                         displ_x, displ_y, displ_z,
                                         interactionMask.dim_x, interactionMask.dim_y, interactionMask.dim_z,
                                         maskDim, maskDim, maskDim);
-                err = cudaGetLastError();
-                if (err != cudaSuccess) throw;
-            }
+            err = cudaGetLastError();
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
         }
 
-        if (!subtractionMask.getDataSize()!=0) {
+        if (subtractionMask.getDataSize() != 0) {
             err = cudaMalloc((void **) &subtraction_data, sizeof(MoleculeMesh::data_t) * subtractionMask.getDataSize());
-            if (err != cudaSuccess) throw;
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
             err = cudaMemcpy(subtraction_data, subtractionMask.getData(),
                              sizeof(MoleculeMesh::data_t) * subtractionMask.getDataSize(), cudaMemcpyHostToDevice);
-            if (err != cudaSuccess) throw;
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
-            MoleculeMesh::subMeshes(interaction_data, subtraction_data,
-                                    0, 0, 0,
-                                    interactionMask.dim_x, interactionMask.dim_y, interactionMask.dim_z,
-                                    subtractionMask.dim_x, subtractionMask.dim_y, subtractionMask.dim_z);
+            MoleculeMesh::subMeshesCuda(interaction_data, subtraction_data,
+                                        0, 0, 0,
+                                        interactionMask.dim_x, interactionMask.dim_y, interactionMask.dim_z,
+                                        subtractionMask.dim_x, subtractionMask.dim_y, subtractionMask.dim_z);
             err = cudaGetLastError();
-            if (err != cudaSuccess) throw;
+            if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
         }
 
         err = cudaMemcpy(interactionMask.getData(), interaction_data,
                          sizeof(MoleculeMesh::data_t) * interactionMask.getDataSize(), cudaMemcpyDeviceToHost);
-        if (err != cudaSuccess) throw;
+        if (err != cudaSuccess) throw std::runtime_error(cudaGetErrorString(err));
 
-    } catch (...) {
+    } catch (const std::exception &e) {
         ris = false;
-        std::cout << cudaGetErrorString(err) << std::endl;
+        std::cout << e.what() << std::endl;
     }
 
     if (bubble_data != nullptr) cudaFree(bubble_data);
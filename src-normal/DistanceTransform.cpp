@@ -0,0 +1,41 @@
+
+#include "DistanceTransform.hpp"
+#include <algorithm>
+#include <vector>
+
+void DistanceTransform::thresholdSerial(const int *seeds, size_t n_seeds, double scaledRadius, MoleculeMesh &mesh) {
+    int begin[3], end[3];
+    fieldBox(seeds, n_seeds, scaledRadius, mesh, begin, end);
+    const int nx = end[0] - begin[0], ny = end[1] - begin[1], nz = end[2] - begin[2];
+    const size_t sy = nx, sz = static_cast<size_t>(nx) * ny;
+    const double ds = scaledRadius * scaledRadius;
+
+    // Seed the field (it can be much larger than the temporaries of the arena, so it has its own buffer)
+    std::vector<int32_t> field(sz * nz, infinity);
+    for (size_t i = 0; i < n_seeds; ++i) {
+        const int *seed = &seeds[3 * i];
+        field[(seed[0] - begin[0]) + (seed[1] - begin[1]) * sy + (seed[2] - begin[2]) * sz] = 0;
+    }
+
+    // Transform the lines along x, then along y, then along z (tiles of adjacent lines)
+    Workspace workspace(std::max({nx, ny, nz}));
+    for (int k = 0; k < nz; ++k)
+        for (int j = 0; j < ny; ++j)
+            transformLine(&field[j * sy + k * sz], nx, ds, workspace);
+    for (int k = 0; k < nz; ++k)
+        for (int i = 0; i < nx; i += tileLines)
+            transformTile(&field[i + k * sz], ny, sy, std::min(tileLines, nx - i), ds, workspace);
+    for (int j = 0; j < ny; ++j)
+        for (int i = 0; i < nx; i += tileLines)
+            transformTile(&field[i + j * sy], nz, sz, std::min(tileLines, nx - i), ds, workspace);
+    dropPoles(seeds, n_seeds, scaledRadius, field.data(), begin, end);
+
+    // Threshold the field onto the rows of the mesh it overlaps
+    const int x_begin = std::max(begin[0], 0), x_end = std::min(end[0], mesh.dim_x);
+    for (int k = std::max(begin[2], 0); k < std::min(end[2], mesh.dim_z); ++k) {
+        for (int j = std::max(begin[1], 0); j < std::min(end[1], mesh.dim_y); ++j) {
+            const int32_t *line = &field[(x_begin - begin[0]) + (j - begin[1]) * sy + (k - begin[2]) * sz];
+            thresholdRow(line, MoleculeMesh::row(mesh.getData(), j, k, mesh.words_x, mesh.dim_y), x_begin, x_end, ds);
+        }
+    }
+}
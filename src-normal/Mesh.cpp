@@ -1,10 +1,10 @@
 
 #include "Mesh.hpp"
 
-void MoleculeMesh::subMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_subtract,
-                                    const int displ_x, const int displ_y, const int displ_z,
-                                    const int data_dim_x, const int data_dim_y, const int data_dim_z,
-                                    const int sub_dim_x, const int sub_dim_y, const int sub_dim_z) {
+void MoleculeMesh::subMeshesSerial(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
+                                          const int displ_x, const int displ_y, const int displ_z,
+                                          const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                                          const int sub_dim_x, const int sub_dim_y, const int sub_dim_z) {
     // calculate operative window
     int sx = displ_x;
     if (sx < 0) {
@@ -36,25 +36,33 @@ void MoleculeMesh::subMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *t
         ez = sub_dim_z + displ_z;
     }
 
-    /* Execute operation over operative window */
+    if (sx >= ex) return;
+
+    const int data_words_x = MoleculeMesh::rowWords(data_dim_x);
+    const int sub_words_x = MoleculeMesh::rowWords(sub_dim_x);
+    const int sw = sx / MoleculeMesh::wordBits;
+    const int ew = (ex - 1) / MoleculeMesh::wordBits;
+
+    /* Execute operation over operative window, one packed word at a time */
     for (int z = sz; z < ez; z++) {
         int az = z - displ_z;
         for (int y = sy; y < ey; y++) {
             int ay = y - displ_y;
-            for (int x = sx; x < ex; x++) {
-                int ax = x - displ_x;
-                MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z) =
-                        MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z)
-                        && !MoleculeMesh::ref(to_subtract, ax, ay, az, sub_dim_x, sub_dim_y, sub_dim_z);
+            MoleculeMesh::data_t *dataRow = MoleculeMesh::row(data, y, z, data_words_x, data_dim_y);
+            const MoleculeMesh::data_t *subRow = MoleculeMesh::row(to_subtract, ay, az, sub_words_x, sub_dim_y);
+            for (int w = sw; w <= ew; w++) {
+                int ax = w * MoleculeMesh::wordBits - displ_x;
+                dataRow[w] &= ~(MoleculeMesh::fetchWord(subRow, ax, sub_words_x) &
+                                MoleculeMesh::rangeMask(w, sx, ex));
             }
         }
     }
 }
 
-void MoleculeMesh::addMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_add,
-                                    const int displ_x, const int displ_y, const int displ_z,
-                                    const int data_dim_x, const int data_dim_y, const int data_dim_z,
-                                    const int add_dim_x, const int add_dim_y, const int add_dim_z){
+void MoleculeMesh::addMeshesSerial(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
+                                          const int displ_x, const int displ_y, const int displ_z,
+                                          const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                                          const int add_dim_x, const int add_dim_y, const int add_dim_z){
     // calculate operative window
     int sx = displ_x;
     if (sx < 0) {
@@ -86,16 +94,57 @@ void MoleculeMesh::addMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *t
         ez = add_dim_z + displ_z;
     }
 
-    /* Execute operation over operative window */
+    if (sx >= ex) return;
+
+    const int data_words_x = MoleculeMesh::rowWords(data_dim_x);
+    const int add_words_x = MoleculeMesh::rowWords(add_dim_x);
+    const int sw = sx / MoleculeMesh::wordBits;
+    const int ew = (ex - 1) / MoleculeMesh::wordBits;
+
+    /* Execute operation over operative window, one packed word at a time */
     for (int z = sz; z < ez; z++) {
         int az = z - displ_z;
         for (int y = sy; y < ey; y++) {
             int ay = y - displ_y;
-            for (int x = sx; x < ex; x++) {
-                int ax = x - displ_x;
-                MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z) =
-                        MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z)
-                        || MoleculeMesh::ref(to_add, ax, ay, az, add_dim_x, add_dim_y, add_dim_z);
+            MoleculeMesh::data_t *dataRow = MoleculeMesh::row(data, y, z, data_words_x, data_dim_y);
+            const MoleculeMesh::data_t *addRow = MoleculeMesh::row(to_add, ay, az, add_words_x, add_dim_y);
+            for (int w = sw; w <= ew; w++) {
+                int ax = w * MoleculeMesh::wordBits - displ_x;
+                dataRow[w] |= MoleculeMesh::fetchWord(addRow, ax, add_words_x) &
+                              MoleculeMesh::rangeMask(w, sx, ex);
+            }
+        }
+    }
+}
+
+void MoleculeMesh::stampSpheresSerial(MoleculeMesh::data_t *data,
+                                      const double *centers_x, const double *centers_y, const double *centers_z,
+                                      const size_t n_spheres, const double radius,
+                                      const int data_dim_x, const int data_dim_y, const int data_dim_z) {
+    const int data_words_x = MoleculeMesh::rowWords(data_dim_x);
+    const int padding = static_cast<int>(ceil(radius));
+    const double ds = radius * radius;
+
+    /* Fill each sphere one x-row run at a time, over its operative window clipped onto the space */
+    for (size_t i = 0; i < n_spheres; i++) {
+        const double px = centers_x[i], py = centers_y[i], pz = centers_z[i];
+
+        int sx = std::max(static_cast<int>(floor(px)) - padding, 0);
+        int ex = std::min(static_cast<int>(ceil(px)) + padding, data_dim_x);
+        int sy = std::max(static_cast<int>(floor(py)) - padding, 0);
+        int ey = std::min(static_cast<int>(ceil(py)) + padding, data_dim_y);
+        int sz = std::max(static_cast<int>(floor(pz)) - padding, 0);
+        int ez = std::min(static_cast<int>(ceil(pz)) + padding, data_dim_z);
+
+        for (int z = sz; z < ez; z++) {
+            double dz = z - pz;
+            double z_res = dz * dz;
+            for (int y = sy; y < ey; y++) {
+                double dy = y - py;
+                double y_res = dy * dy;
+                int begin, end;
+                if (MoleculeMesh::sphereRun(px, y_res, z_res, ds, sx, ex, begin, end))
+                    MoleculeMesh::fillRow(MoleculeMesh::row(data, y, z, data_words_x, data_dim_y), begin, end);
             }
         }
     }
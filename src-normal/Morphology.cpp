@@ -0,0 +1,50 @@
+#include "Morphology.hpp"
+#include "DistanceTransform.hpp"
+#include <algorithm>
+#include <vector>
+
+void Morphology::transformSerial(MoleculeMesh &mesh, double scaledRadius, bool erode) {
+    const int nx = mesh.dim_x, ny = mesh.dim_y + 2, nz = mesh.dim_z + 2;
+    const size_t sy = nx, sz = static_cast<size_t>(nx) * ny;
+    const double ds = scaledRadius * scaledRadius;
+
+    // The field frames the mesh with a layer of voxels out of it along y and z (seedRow() accounts for the x ones)
+    std::vector<int32_t> field(sz * nz, erode ? 0 : DistanceTransform::infinity);
+    for (int k = 0; k < mesh.dim_z; ++k)
+        for (int j = 0; j < mesh.dim_y; ++j)
+            seedRow(MoleculeMesh::row(mesh.getData(), j, k, mesh.words_x, mesh.dim_y), nx, erode, ds,
+                    &field[(j + 1) * sy + (k + 1) * sz]);
+
+    // Transform the lines along y of the slices of the mesh, then the ones along z (tiles of adjacent lines)
+    DistanceTransform::Workspace workspace(std::max({nx, ny, nz}));
+    for (int k = 1; k < nz - 1; ++k)
+        for (int i = 0; i < nx; i += DistanceTransform::tileLines)
+            DistanceTransform::transformTile(&field[i + k * sz], ny, sy, std::min(DistanceTransform::tileLines, nx - i),
+                                             ds, workspace);
+    for (int j = 1; j < ny - 1; ++j)
+        for (int i = 0; i < nx; i += DistanceTransform::tileLines)
+            DistanceTransform::transformTile(&field[i + j * sy], nz, sz, std::min(DistanceTransform::tileLines, nx - i),
+                                             ds, workspace);
+
+    for (int k = 0; k < mesh.dim_z; ++k)
+        for (int j = 0; j < mesh.dim_y; ++j)
+            writeRow(&field[(j + 1) * sy + (k + 1) * sz], MoleculeMesh::row(mesh.getData(), j, k, mesh.words_x,
+                                                                            mesh.dim_y), nx, erode, ds);
+}
+
+void Morphology::combineSerial(MoleculeMesh &mesh, const std::vector<Run> &runs, const std::vector<int> &widths,
+                               bool erode) {
+    const size_t block = mesh.getDataSize();
+    const size_t rows = static_cast<size_t>(mesh.dim_y) * mesh.dim_z;
+
+    // Widen every row once per run length (a mesh data block per level), then combine the rows of the result
+    std::vector<MoleculeMesh::data_t> widened(widths.size() * block);
+    for (size_t level = 0; level < widths.size(); ++level)
+        for (size_t r = 0; r < rows; ++r)
+            widenRow(mesh.getData() + r * mesh.words_x, &widened[level * block + r * mesh.words_x], mesh.words_x,
+                     widths[level], erode);
+
+    for (int k = 0; k < mesh.dim_z; ++k)
+        for (int j = 0; j < mesh.dim_y; ++j)
+            combineRow(widened.data(), mesh, runs, j, k, erode);
+}
@@ -0,0 +1,61 @@
+
+#include "RestrictedBasePIStackingInteraction.hpp"
+#include "ScratchArena.hpp"
+#include "Metrics.hpp"
+#include <vector>
+
+bool RestrictedBasePIStackingInteraction::getInteractionSerial(const MoleculeContext &context,
+                                                               const MatchCache::matches_t &matches,
+                                                               MoleculeMesh &interactionMask,
+                                                               MoleculeMesh &subtractionMask) {
+
+    if (matches->empty()) return false;
+
+    // Calculate ring centroids and normals once
+    std::pmr::vector<RDGeom::Point3D> centroids(ScratchArena::resource()), normals(ScratchArena::resource());
+    for (const RDKit::MatchVectType &match: *matches) {
+        RDGeom::Point3D centroid, normal;
+        if (RingStencil::ringFrame(context, match, centroid, normal)) {
+            centroids.push_back(centroid);
+            normals.push_back(normal);
+        }
+    }
+
+    // Pattern-mesh runs, reused by all rings
+    SpanStencil bubble(0, 0, 0, ScratchArena::resource());
+    // Pattern rasterizer at the grain of the support-mesh
+    const int grain = interactionMask.grain;
+    const RingStencil ring(distance, {min_angle_ring, max_angle_ring}, {min_angle_cent, max_angle_cent},
+                           intersect, intersect_radius, grain);
+    int scaledMaskCenter = ring.getCenter();
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
+
+    for (size_t i = 0; i < centroids.size(); ++i) {
+        const RDGeom::Point3D &center = centroids[i];
+
+        // Generate pattern-mesh runs around the ring centroid
+        {
+            Metrics::Timer timer(Metrics::STENCIL);
+            ring.build(normals[i], bubble);
+        }
+
+        // Find the zero-point displacement of pattern from the zero-point of support-mask
+        double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+        double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+        double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+        // Discretize the displacement
+        int displ_x = static_cast<int>(round(px));
+        int displ_y = static_cast<int>(round(py));
+        int displ_z = static_cast<int>(round(pz));
+
+        // Apply pattern at displacement onto support-mesh
+        interactionMask.stamp(bubble, displ_x, displ_y, displ_z);
+    }
+
+    Metrics::count(Metrics::STENCILS_BUILT, centroids.size());
+
+    interactionMask.sub(subtractionMask, 0, 0, 0);
+
+    return !centroids.empty();
+}
@@ -1,93 +1,61 @@
 
 #include "SingleAngleInteraction.hpp"
+#include "ScratchArena.hpp"
+#include "Metrics.hpp"
 
-bool SingleAngleInteraction::getInteraction(const RDKit::ROMol *molecule,
-                                            MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
-
-    // Get molecule conformer and retrive matches of smart into given molecule
-    RDKit::Conformer conformer = molecule->getConformer();
-    std::vector<RDKit::MatchVectType> *matches = Interaction::findMatch(molecule);
+bool SingleAngleInteraction::getInteractionSerial(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                                                  MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
 
     if (matches->empty()) return false;
 
+    // Resolve the centroids <p1, p2> of every match into the coordinate block
+    std::pmr::vector<int> centroids(ScratchArena::resource());
+    Interaction::resolveMatches(*matches, 2, centroids);
+
+    // Pattern-mesh runs, reused by all matches
+    SpanStencil bubble(0, 0, 0, ScratchArena::resource());
+    // Pattern rasterizer at the grain of the support-mesh
+    const int grain = interactionMask.grain;
+    const ConeStencil cone({min_angle, max_angle}, distance, grain);
+    int scaledMaskCenter = cone.getCenter();
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
+
+    for (size_t i = 0; i < centroids.size(); i += 2) {
+        // Get molecule match centroids position
+        RDGeom::Point3D p1 = context.getAtomPos(centroids[i]);
+        RDGeom::Point3D p2 = context.getAtomPos(centroids[i + 1]);
+
+        RDGeom::Point3D center;
+        if (cp) center = p1;
+        else center = p2;
+
+        /*
+         * Generate pattern-mesh runs where:
+         *      - (point-distance <= #distance) from the center of mesh
+         *      - angle between l1 <-- p2 --> p1 is (#min <= #angle <= #max)
+         */
+        {
+            Metrics::Timer timer(Metrics::STENCIL);
+            cone.build(center, p1, p2, bubble);
+        }
 
-    bool found = false;
-    for (RDKit::MatchVectType match: *matches) {
-        if (match.size() >= 2) {
-            found = true;
-
-            // Get molecule match and its centroids position
-            auto p1Id = match.at(0).second;
-            auto p1 = conformer.getAtomPos(p1Id);
-            auto p2Id = match.at(1).second;
-            auto p2 = conformer.getAtomPos(p2Id);
-
-            RDGeom::Point3D center;
-                if (cp) center = p1;
-                else center = p2;
-
-            // Calculate mask size and centering coordinates
-            auto scaledMaskCenter = static_cast<int>(ceil(distance * GRAIN));
-            auto maskDim = 2 * scaledMaskCenter;
-
-            // Generate pattern-mesh
-            MoleculeMesh bubble(maskDim, maskDim, maskDim);
-
-            // Calculate vector p2 --> p1
-            RDGeom::Point3D p2p1 = p2.directionVector(p1);
-
-            /*
-             * Over all size of pattern-mesh assign if:
-             *      - (point-distance <= #distance) from the center of mesh
-             *      - angle between l1 <-- p2 --> p1 is (#min <= #angle <= #max)
-             */
-            double scaledDistance = distance * GRAIN;
-            double ds = scaledDistance * scaledDistance;
-            for (int z = 0; z < maskDim; ++z) {
-                int dz = z - scaledMaskCenter;
-                int z_res = dz * dz;
-                double pz = static_cast<double>(dz) / GRAIN + center.z;
-                for (int y = 0; y < maskDim; ++y) {
-                    int dy = y - scaledMaskCenter;
-                    int y_res = dy * dy;
-                    double py = static_cast<double>(dy) / GRAIN + center.y;
-                    for (int x = 0; x < maskDim; ++x) {
-                        int dx = x - scaledMaskCenter;
-                        int x_res = dx * dx;
-                        double px = static_cast<double>(dx) / GRAIN + center.x;
-
-                        // Position of l1 is calculated taking account of pattern-center position
-                        RDGeom::Point3D l1(px, py, pz);
-
-                        // Calculate vector p2 --> l1
-                        RDGeom::Point3D p2l1 = p2.directionVector(l1);
-
-                        // Calculate angle l1 <-- p2 --> p1
-                        double angle = p2p1.angleTo(p2l1);
-
-                        if (x_res + y_res + z_res <= ds && angle >= min_angle && angle <= max_angle)
-                            bubble.at(x, y, z) = true;
-                    }
-                }
-            }
-
-            // Find the zero-point displacement of pattern from the zero-point of support-mask
-            auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
-            double px = (center.x - interactionMask.globalDisplacement.x) * GRAIN + paddingDisplacement;
-            double py = (center.y - interactionMask.globalDisplacement.y) * GRAIN + paddingDisplacement;
-            double pz = (center.z - interactionMask.globalDisplacement.z) * GRAIN + paddingDisplacement;
+        // Find the zero-point displacement of pattern from the zero-point of support-mask
+        double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+        double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+        double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
 
-            // Discretize the displacement
-            int displ_x = static_cast<int>(round(px));
-            int displ_y = static_cast<int>(round(py));
-            int displ_z = static_cast<int>(round(pz));
+        // Discretize the displacement
+        int displ_x = static_cast<int>(round(px));
+        int displ_y = static_cast<int>(round(py));
+        int displ_z = static_cast<int>(round(pz));
 
-            // Apply pattern at displacement onto support-mesh
-            interactionMask.add(bubble, displ_x, displ_y, displ_z);
-        }
+        // Apply pattern at displacement onto support-mesh
+        interactionMask.stamp(bubble, displ_x, displ_y, displ_z);
     }
 
+    Metrics::count(Metrics::STENCILS_BUILT, centroids.size() / 2);
+
     interactionMask.sub(subtractionMask, 0, 0, 0);
 
-    return found;
-}
\ No newline at end of file
+    return !centroids.empty();
+}
@@ -1,76 +1,63 @@
 
 #include "DistanceInteraction.hpp"
+#include "StencilCache.hpp"
+#include "ScratchArena.hpp"
+#include <omp.h>
+#include <algorithm>
 #include <vector>
 
-bool DistanceInteraction::getInteraction(const RDKit::ROMol *molecule, MoleculeMesh &interactionMask,
-                                          MoleculeMesh &subtractionMask) {
-    // Get molecule conformer and retrive matches of smart into given molecule
-    RDKit::Conformer conformer = molecule->getConformer();
-    std::vector<RDKit::MatchVectType> *matches = Interaction::findMatch(molecule);
+bool DistanceInteraction::getInteractionOmp(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                                            MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
 
     if (matches->empty()) return false;
 
-    // Discretize mask radius and calculate mask dimension
-    int scaledMaskRadius = static_cast<int>(ceil(distance * GRAIN));
-    int maskDim = 2 * scaledMaskRadius;
+    // Resolve the interaction-centroid of every match into the coordinate block
+    std::pmr::vector<int> centroids(ScratchArena::resource());
+    Interaction::resolveMatches(*matches, 1, centroids);
 
-    // Generate a pattern-mesh
-    MoleculeMesh bubble(maskDim, maskDim, maskDim);
+    // Discretize mask radius (at the grain of the support-mesh) and retrieve the (shared) spherical pattern
+    const int grain = interactionMask.grain;
+    int scaledMaskRadius = static_cast<int>(ceil(distance * grain));
+    const SpanStencil &bubble = StencilCache::sphere(distance, grain);
 
-    bool found = false;
-    // Over all size of pattern-mesh assign if (point-distance <= #distance) from the center of mesh
-#pragma omp parallel
-    {
-        double scaledDistance = distance * GRAIN;
-        double ds = scaledDistance * scaledDistance;
+    // Displacement of the pattern of every centroid
+    int n_centroids = static_cast<int>(centroids.size());
+    std::pmr::vector<int> displacements(3 * n_centroids, ScratchArena::resource());
 
-        int layerS = maskDim * maskDim;
-        int maskS = layerS * maskDim;
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskRadius);
 
-#pragma omp for simd
-        for (int k = 0; k < maskS; ++k) {
-            int z = k / layerS;
-            int y = (k % layerS) / maskDim;
-            int x = (k % layerS) % maskDim;
-            int dz = z - scaledMaskRadius;
-            int z_res = dz * dz;
-            int dy = y - scaledMaskRadius;
-            int y_res = dy * dy;
-            int dx = x - scaledMaskRadius;
-            int x_res = dx * dx;
-            if (x_res + y_res + z_res <= ds)
-                bubble.at(x, y, z) = true;
-        }
-
-        // For each interaction-centroid apply the pattern-mesh centered at centroid onto the support-mesh
-        auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskRadius);
+#pragma omp parallel for
+    for (int i = 0; i < n_centroids; ++i) {
+        int atomId = centroids[i];
 
-#pragma omp for simd
-        for (int i = 0; i < matches->size(); ++i) {
-            RDKit::MatchVectType match = (*matches)[i];
-            if (!match.empty()) {
-                found = true;
-                // Get interaction match centroid position
-                auto atomId = match.at(0).second;
-                RDGeom::Point3D pos = conformer.getAtomPos(atomId);
+        // Find the zero-point displacement of pattern from the zero-point of support-mask
+        double px = (context.x[atomId] - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+        double py = (context.y[atomId] - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+        double pz = (context.z[atomId] - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
 
-                // Find the zero-point displacement of pattern from the zero-point of support-mask
-                double px = (pos.x - interactionMask.globalDisplacement.x) * GRAIN + paddingDisplacement;
-                double py = (pos.y - interactionMask.globalDisplacement.y) * GRAIN + paddingDisplacement;
-                double pz = (pos.z - interactionMask.globalDisplacement.z) * GRAIN + paddingDisplacement;
-
-                // Discretize the displacement
-                int displ_x = static_cast<int>(round(px));
-                int displ_y = static_cast<int>(round(py));
-                int displ_z = static_cast<int>(round(pz));
+        // Discretize the displacement
+        displacements[3 * i] = static_cast<int>(round(px));
+        displacements[3 * i + 1] = static_cast<int>(round(py));
+        displacements[3 * i + 2] = static_cast<int>(round(pz));
+    }
 
-                // Apply pattern at displacement onto support-mesh
-                interactionMask.add(bubble, displ_x, displ_y, displ_z);
-            }
+    /*
+     * Apply pattern at displacements onto support-mesh: the support-mesh is split into z-slabs, each one owned by
+     * a single thread (rows of different slabs never share packed words), so no synchronization is needed
+     */
+    int n_slabs = std::min(interactionMask.dim_z, 4 * omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic)
+    for (int s = 0; s < n_slabs; ++s) {
+        int z_begin = interactionMask.dim_z * s / n_slabs;
+        int z_end = interactionMask.dim_z * (s + 1) / n_slabs;
+        for (int i = 0; i < n_centroids; ++i) {
+            int displ_z = displacements[3 * i + 2];
+            if (displ_z >= z_end || displ_z + bubble.dim_z <= z_begin) continue;
+            interactionMask.stamp(bubble, displacements[3 * i], displacements[3 * i + 1], displ_z, z_begin, z_end);
         }
     }
 
     interactionMask.sub(subtractionMask, 0, 0, 0);
 
-    return found;
-}
\ No newline at end of file
+    return n_centroids > 0;
+}
@@ -1,10 +1,11 @@
 
 #include "Mesh.hpp"
+#include <omp.h>
 
-void MoleculeMesh::subMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_subtract,
-                             const int displ_x, const int displ_y, const int displ_z,
-                             const int data_dim_x, const int data_dim_y, const int data_dim_z,
-                             const int sub_dim_x, const int sub_dim_y, const int sub_dim_z) {
+void MoleculeMesh::subMeshesOmp(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
+                                const int displ_x, const int displ_y, const int displ_z,
+                                const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                                const int sub_dim_x, const int sub_dim_y, const int sub_dim_z) {
 
     // calculate operative window
     int sx = displ_x;
@@ -37,25 +38,34 @@ void MoleculeMesh::subMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *t
         ez = sub_dim_z + displ_z;
     }
 
-    /* Execute operation over operative window */
+    if (sx >= ex) return;
+
+    const int data_words_x = MoleculeMesh::rowWords(data_dim_x);
+    const int sub_words_x = MoleculeMesh::rowWords(sub_dim_x);
+    const int sw = sx / MoleculeMesh::wordBits;
+    const int ew = (ex - 1) / MoleculeMesh::wordBits;
+
+    /* Execute operation over operative window, one packed word at a time (each z-layer is owned by a thread) */
+#pragma omp parallel for schedule(static)
     for (int z = sz; z < ez; z++) {
         int az = z - displ_z;
         for (int y = sy; y < ey; y++) {
             int ay = y - displ_y;
-            for (int x = sx; x < ex; x++) {
-                int ax = x - displ_x;
-                MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z) =
-                        MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z)
-                        && !MoleculeMesh::ref(to_subtract, ax, ay, az, sub_dim_x, sub_dim_y, sub_dim_z);
+            MoleculeMesh::data_t *dataRow = MoleculeMesh::row(data, y, z, data_words_x, data_dim_y);
+            const MoleculeMesh::data_t *subRow = MoleculeMesh::row(to_subtract, ay, az, sub_words_x, sub_dim_y);
+            for (int w = sw; w <= ew; w++) {
+                int ax = w * MoleculeMesh::wordBits - displ_x;
+                dataRow[w] &= ~(MoleculeMesh::fetchWord(subRow, ax, sub_words_x) &
+                                MoleculeMesh::rangeMask(w, sx, ex));
             }
         }
     }
 }
 
-void MoleculeMesh::addMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *to_add,
-                             const int displ_x, const int displ_y, const int displ_z,
-                             const int data_dim_x, const int data_dim_y, const int data_dim_z,
-                             const int add_dim_x, const int add_dim_y, const int add_dim_z) {
+void MoleculeMesh::addMeshesOmp(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
+                                const int displ_x, const int displ_y, const int displ_z,
+                                const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                                const int add_dim_x, const int add_dim_y, const int add_dim_z) {
 
     // calculate operative window
     int sx = displ_x;
@@ -88,16 +98,69 @@ void MoleculeMesh::addMeshes(MoleculeMesh::data_t *data, MoleculeMesh::data_t *t
         ez = add_dim_z + displ_z;
     }
 
-    /* Execute operation over operative window */
+    if (sx >= ex) return;
+
+    const int data_words_x = MoleculeMesh::rowWords(data_dim_x);
+    const int add_words_x = MoleculeMesh::rowWords(add_dim_x);
+    const int sw = sx / MoleculeMesh::wordBits;
+    const int ew = (ex - 1) / MoleculeMesh::wordBits;
+
+    /* Execute operation over operative window, one packed word at a time (each z-layer is owned by a thread) */
+#pragma omp parallel for schedule(static)
     for (int z = sz; z < ez; z++) {
         int az = z - displ_z;
         for (int y = sy; y < ey; y++) {
             int ay = y - displ_y;
-            for (int x = sx; x < ex; x++) {
-                int ax = x - displ_x;
-                MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z) =
-                        MoleculeMesh::ref(data, x, y, z, data_dim_x, data_dim_y, data_dim_z)
-                        || MoleculeMesh::ref(to_add, ax, ay, az, add_dim_x, add_dim_y, add_dim_z);
+            MoleculeMesh::data_t *dataRow = MoleculeMesh::row(data, y, z, data_words_x, data_dim_y);
+            const MoleculeMesh::data_t *addRow = MoleculeMesh::row(to_add, ay, az, add_words_x, add_dim_y);
+            for (int w = sw; w <= ew; w++) {
+                int ax = w * MoleculeMesh::wordBits - displ_x;
+                dataRow[w] |= MoleculeMesh::fetchWord(addRow, ax, add_words_x) &
+                              MoleculeMesh::rangeMask(w, sx, ex);
+            }
+        }
+    }
+}
+
+void MoleculeMesh::stampSpheresOmp(MoleculeMesh::data_t *data,
+                                   const double *centers_x, const double *centers_y, const double *centers_z,
+                                   const size_t n_spheres, const double radius,
+                                   const int data_dim_x, const int data_dim_y, const int data_dim_z) {
+    const int data_words_x = MoleculeMesh::rowWords(data_dim_x);
+    const int padding = static_cast<int>(ceil(radius));
+    const double ds = radius * radius;
+
+    /*
+     * The space is split into z-slabs, each one owned by a single thread (rows of different slabs never share
+     * packed words): every slab fills the x-row runs of the spheres crossing it, so no synchronization is needed
+     */
+    int n_slabs = std::min(data_dim_z, 4 * omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic)
+    for (int s = 0; s < n_slabs; ++s) {
+        int z_begin = data_dim_z * s / n_slabs;
+        int z_end = data_dim_z * (s + 1) / n_slabs;
+        for (size_t i = 0; i < n_spheres; i++) {
+            const double px = centers_x[i], py = centers_y[i], pz = centers_z[i];
+
+            int sz = std::max(static_cast<int>(floor(pz)) - padding, z_begin);
+            int ez = std::min(static_cast<int>(ceil(pz)) + padding, z_end);
+            if (sz >= ez) continue;
+
+            int sx = std::max(static_cast<int>(floor(px)) - padding, 0);
+            int ex = std::min(static_cast<int>(ceil(px)) + padding, data_dim_x);
+            int sy = std::max(static_cast<int>(floor(py)) - padding, 0);
+            int ey = std::min(static_cast<int>(ceil(py)) + padding, data_dim_y);
+
+            for (int z = sz; z < ez; z++) {
+                double dz = z - pz;
+                double z_res = dz * dz;
+                for (int y = sy; y < ey; y++) {
+                    double dy = y - py;
+                    double y_res = dy * dy;
+                    int begin, end;
+                    if (MoleculeMesh::sphereRun(px, y_res, z_res, ds, sx, ex, begin, end))
+                        MoleculeMesh::fillRow(MoleculeMesh::row(data, y, z, data_words_x, data_dim_y), begin, end);
+                }
             }
         }
     }
@@ -0,0 +1,69 @@
+#include "Morphology.hpp"
+#include "DistanceTransform.hpp"
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+void Morphology::transformOmp(MoleculeMesh &mesh, double scaledRadius, bool erode) {
+    const int nx = mesh.dim_x, ny = mesh.dim_y + 2, nz = mesh.dim_z + 2;
+    const size_t sy = nx, sz = static_cast<size_t>(nx) * ny;
+    const double ds = scaledRadius * scaledRadius;
+
+    // The field frames the mesh with a layer of voxels out of it along y and z (seedRow() accounts for the x ones)
+    std::vector<int32_t> field(sz * nz, erode ? 0 : DistanceTransform::infinity);
+
+    /*
+     * The lines of a pass are independent, each thread transforms whole lines with its own workspaces:
+     * x-rows and y-lines by z-slice, z-lines by y-slice, then the z-slices are packed back into the mesh
+     */
+#pragma omp parallel
+    {
+        DistanceTransform::Workspace workspace(std::max({nx, ny, nz}));
+
+#pragma omp for schedule(static)
+        for (int k = 0; k < mesh.dim_z; ++k) {
+            for (int j = 0; j < mesh.dim_y; ++j)
+                seedRow(MoleculeMesh::row(mesh.getData(), j, k, mesh.words_x, mesh.dim_y), nx, erode, ds,
+                        &field[(j + 1) * sy + (k + 1) * sz]);
+            for (int i = 0; i < nx; i += DistanceTransform::tileLines)
+                DistanceTransform::transformTile(&field[i + (k + 1) * sz], ny, sy,
+                                                 std::min(DistanceTransform::tileLines, nx - i), ds, workspace);
+        }
+
+#pragma omp for schedule(static)
+        for (int j = 1; j < ny - 1; ++j)
+            for (int i = 0; i < nx; i += DistanceTransform::tileLines)
+                DistanceTransform::transformTile(&field[i + j * sy], nz, sz,
+                                                 std::min(DistanceTransform::tileLines, nx - i), ds, workspace);
+
+#pragma omp for schedule(static)
+        for (int k = 0; k < mesh.dim_z; ++k)
+            for (int j = 0; j < mesh.dim_y; ++j)
+                writeRow(&field[(j + 1) * sy + (k + 1) * sz],
+                         MoleculeMesh::row(mesh.getData(), j, k, mesh.words_x, mesh.dim_y), nx, erode, ds);
+    }
+}
+
+void Morphology::combineOmp(MoleculeMesh &mesh, const std::vector<Run> &runs, const std::vector<int> &widths,
+                            bool erode) {
+    const size_t block = mesh.getDataSize();
+    const auto rows = static_cast<long>(mesh.dim_y) * mesh.dim_z;
+    std::vector<MoleculeMesh::data_t> widened(widths.size() * block);
+
+    // Rows are widened and combined independently, the result is written only once all the rows are widened
+#pragma omp parallel
+    {
+        for (size_t level = 0; level < widths.size(); ++level) {
+#pragma omp for schedule(static) nowait
+            for (long r = 0; r < rows; ++r)
+                widenRow(mesh.getData() + r * mesh.words_x, &widened[level * block + r * mesh.words_x], mesh.words_x,
+                         widths[level], erode);
+        }
+
+#pragma omp barrier
+#pragma omp for schedule(static)
+        for (int k = 0; k < mesh.dim_z; ++k)
+            for (int j = 0; j < mesh.dim_y; ++j)
+                combineRow(widened.data(), mesh, runs, j, k, erode);
+    }
+}
@@ -0,0 +1,77 @@
+
+#include "RestrictedBasePIStackingInteraction.hpp"
+#include "ScratchArena.hpp"
+#include "Metrics.hpp"
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+bool RestrictedBasePIStackingInteraction::getInteractionOmp(const MoleculeContext &context,
+                                                            const MatchCache::matches_t &matches,
+                                                            MoleculeMesh &interactionMask,
+                                                            MoleculeMesh &subtractionMask) {
+
+    if (matches->empty()) return false;
+
+    // Pattern-mesh runs and displacement of every ring (degenerate rings keep an empty one)
+    // (the runs are filled by other threads, so they are allocated on the heap and not on this thread's arena)
+    int n_rings = static_cast<int>(matches->size());
+    std::pmr::vector<SpanStencil> bubbles(n_rings, SpanStencil(0, 0, 0), ScratchArena::resource());
+    std::pmr::vector<int> displacements(3 * n_rings, ScratchArena::resource());
+
+    // Pattern rasterizer at the grain of the support-mesh
+    const int grain = interactionMask.grain;
+    const RingStencil ring(distance, {min_angle_ring, max_angle_ring}, {min_angle_cent, max_angle_cent},
+                           intersect, intersect_radius, grain);
+    int scaledMaskCenter = ring.getCenter();
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
+
+    int n_built = 0;
+
+    // Ring centroids and normals are calculated once, patterns are independent so they are generated concurrently
+    {
+        Metrics::Timer timer(Metrics::STENCIL);
+#pragma omp parallel for schedule(dynamic) reduction(+:n_built)
+        for (int i = 0; i < n_rings; ++i) {
+            RDGeom::Point3D center, normal;
+            if (RingStencil::ringFrame(context, (*matches)[i], center, normal)) {
+                n_built++;
+
+                // Generate pattern-mesh runs around the ring centroid
+                ring.build(normal, bubbles[i]);
+
+                // Find the zero-point displacement of pattern from the zero-point of support-mask
+                double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+                double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+                double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+                // Discretize the displacement
+                displacements[3 * i] = static_cast<int>(round(px));
+                displacements[3 * i + 1] = static_cast<int>(round(py));
+                displacements[3 * i + 2] = static_cast<int>(round(pz));
+            }
+        }
+    }
+    Metrics::count(Metrics::STENCILS_BUILT, n_built);
+
+    /*
+     * Apply patterns at displacement onto support-mesh: the support-mesh is split into z-slabs, each one owned by
+     * a single thread (rows of different slabs never share packed words), so no synchronization is needed
+     */
+    int n_slabs = std::min(interactionMask.dim_z, 4 * omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic)
+    for (int s = 0; s < n_slabs; ++s) {
+        int z_begin = interactionMask.dim_z * s / n_slabs;
+        int z_end = interactionMask.dim_z * (s + 1) / n_slabs;
+        for (int i = 0; i < n_rings; ++i) {
+            const SpanStencil &bubble = bubbles[i];
+            int displ_z = displacements[3 * i + 2];
+            if (bubble.spans.empty() || displ_z >= z_end || displ_z + bubble.dim_z <= z_begin) continue;
+            interactionMask.stamp(bubble, displacements[3 * i], displacements[3 * i + 1], displ_z, z_begin, z_end);
+        }
+    }
+
+    interactionMask.sub(subtractionMask, 0, 0, 0);
+
+    return n_built > 0;
+}
@@ -1,101 +1,82 @@
 
 #include "SingleAngleInteraction.hpp"
+#include "ScratchArena.hpp"
+#include "Metrics.hpp"
+#include <omp.h>
+#include <algorithm>
 
-bool SingleAngleInteraction::getInteraction(const RDKit::ROMol *molecule,
-                                            MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
-
-    // Get molecule conformer and retrive matches of smart into given molecule
-    RDKit::Conformer conformer = molecule->getConformer();
-    std::vector<RDKit::MatchVectType> *matches = Interaction::findMatch(molecule);
+bool SingleAngleInteraction::getInteractionOmp(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                                               MoleculeMesh &interactionMask, MoleculeMesh &subtractionMask) {
 
     if (matches->empty()) return false;
 
+    // Resolve the centroids <p1, p2> of every match into the coordinate block
+    std::pmr::vector<int> centroids(ScratchArena::resource());
+    Interaction::resolveMatches(*matches, 2, centroids);
 
-    bool found = false;
-
-#pragma omp parallel
-    {
-#pragma omp for simd
-        for (unsigned int i = 0; i < matches->size(); ++i) {
-            RDKit::MatchVectType match = (*matches)[i];
-            if (match.size() >= 2) {
-                found = true;
-
-                // Get molecule match and its centroids position
-                auto p1Id = match.at(0).second;
-                auto p1 = conformer.getAtomPos(p1Id);
-                auto p2Id = match.at(1).second;
-                auto p2 = conformer.getAtomPos(p2Id);
-
-                RDGeom::Point3D center;
-                if (cp) center = p1;
-                else center = p2;
-
-                // Calculate mask size and centering coordinates
-                auto scaledMaskCenter = static_cast<int>(ceil(distance * GRAIN));
-                auto maskDim = 2 * scaledMaskCenter;
-
-                // Generate pattern-mesh
-                MoleculeMesh bubble(maskDim, maskDim, maskDim);
-
-                // Calculate vector p2 --> p1
-                RDGeom::Point3D p2p1 = p2.directionVector(p1);
-
-                /*
-                 * Over all size of pattern-mesh assign if:
-                 *      - (point-distance <= #distance) from the center of mesh
-                 *      - angle between l1 <-- p2 --> p1 is (#min <= #angle <= #max)
-                 */
-                double scaledDistance = distance * GRAIN;
-                double ds = scaledDistance * scaledDistance;
-                for (int z = 0; z < maskDim; ++z) {
-                    int dz = z - scaledMaskCenter;
-                    int z_res = dz * dz;
-                    double pz = static_cast<double>(dz) / GRAIN + center.z;
-                    for (int y = 0; y < maskDim; ++y) {
-                        int dy = y - scaledMaskCenter;
-                        int y_res = dy * dy;
-                        double py = static_cast<double>(dy) / GRAIN + center.y;
-                        for (int x = 0; x < maskDim; ++x) {
-                            int dx = x - scaledMaskCenter;
-                            int x_res = dx * dx;
-                            double px = static_cast<double>(dx) / GRAIN + center.x;
-
-                            // Position of l1 is calculated taking account of pattern-center position
-                            RDGeom::Point3D l1(px, py, pz);
-
-                            // Calculate vector p2 --> l1
-                            RDGeom::Point3D p2l1 = p2.directionVector(l1);
+    // Pattern-mesh runs and displacement of every match
+    // (the runs are filled by other threads, so they are allocated on the heap and not on this thread's arena)
+    int n_patterns = static_cast<int>(centroids.size() / 2);
+    std::pmr::vector<SpanStencil> bubbles(n_patterns, SpanStencil(0, 0, 0), ScratchArena::resource());
+    std::pmr::vector<int> displacements(3 * n_patterns, ScratchArena::resource());
 
-                            // Calculate angle l1 <-- p2 --> p1
-                            double angle = p2p1.angleTo(p2l1);
+    // Pattern rasterizer at the grain of the support-mesh
+    const int grain = interactionMask.grain;
+    const ConeStencil cone({min_angle, max_angle}, distance, grain);
+    int scaledMaskCenter = cone.getCenter();
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskCenter);
 
-                            if (x_res + y_res + z_res <= ds && angle >= min_angle && angle <= max_angle)
-                                bubble.at(x, y, z) = true;
-                        }
-                    }
-                }
-
-                // Find the zero-point displacement of pattern from the zero-point of support-mask
-                auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement -
-                                                               scaledMaskCenter);
-                double px = (center.x - interactionMask.globalDisplacement.x) * GRAIN + paddingDisplacement;
-                double py = (center.y - interactionMask.globalDisplacement.y) * GRAIN + paddingDisplacement;
-                double pz = (center.z - interactionMask.globalDisplacement.z) * GRAIN + paddingDisplacement;
-
-                // Discretize the displacement
-                int displ_x = static_cast<int>(round(px));
-                int displ_y = static_cast<int>(round(py));
-                int displ_z = static_cast<int>(round(pz));
-
-                // Apply pattern at displacement onto support-mesh
-                interactionMask.add(bubble, displ_x, displ_y, displ_z);
-
-            }
+    // Patterns are independent, so they are generated concurrently
+    {
+        Metrics::Timer timer(Metrics::STENCIL);
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < n_patterns; ++i) {
+            // Get molecule match centroids position
+            RDGeom::Point3D p1 = context.getAtomPos(centroids[2 * i]);
+            RDGeom::Point3D p2 = context.getAtomPos(centroids[2 * i + 1]);
+
+            RDGeom::Point3D center;
+            if (cp) center = p1;
+            else center = p2;
+
+            /*
+             * Generate pattern-mesh runs where:
+             *      - (point-distance <= #distance) from the center of mesh
+             *      - angle between l1 <-- p2 --> p1 is (#min <= #angle <= #max)
+             */
+            cone.build(center, p1, p2, bubbles[i]);
+
+            // Find the zero-point displacement of pattern from the zero-point of support-mask
+            double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+            double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+            double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+            // Discretize the displacement
+            displacements[3 * i] = static_cast<int>(round(px));
+            displacements[3 * i + 1] = static_cast<int>(round(py));
+            displacements[3 * i + 2] = static_cast<int>(round(pz));
+        }
+    }
+    Metrics::count(Metrics::STENCILS_BUILT, n_patterns);
+
+    /*
+     * Apply patterns at displacement onto support-mesh: the support-mesh is split into z-slabs, each one owned by
+     * a single thread (rows of different slabs never share packed words), so no synchronization is needed
+     */
+    int n_slabs = std::min(interactionMask.dim_z, 4 * omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic)
+    for (int s = 0; s < n_slabs; ++s) {
+        int z_begin = interactionMask.dim_z * s / n_slabs;
+        int z_end = interactionMask.dim_z * (s + 1) / n_slabs;
+        for (int i = 0; i < n_patterns; ++i) {
+            const SpanStencil &bubble = bubbles[i];
+            int displ_z = displacements[3 * i + 2];
+            if (bubble.spans.empty() || displ_z >= z_end || displ_z + bubble.dim_z <= z_begin) continue;
+            interactionMask.stamp(bubble, displacements[3 * i], displacements[3 * i + 1], displ_z, z_begin, z_end);
         }
-
-#pragma omp single
-        interactionMask.sub(subtractionMask, 0, 0, 0);
     }
-    return found;
-}
\ No newline at end of file
+
+    interactionMask.sub(subtractionMask, 0, 0, 0);
+
+    return n_patterns > 0;
+}
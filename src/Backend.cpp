@@ -0,0 +1,68 @@
+#include "Backend.hpp"
+#include <stdexcept>
+
+std::atomic<Backend::Type> Backend::selected{Backend::AUTO};
+std::atomic<size_t> Backend::autoRows{Backend::defaultAutoRows};
+thread_local bool Backend::concurrentWorker = false;
+
+bool Backend::isAvailable(Type type) {
+    switch (type) {
+        case AUTO:
+        case SERIAL:
+            return true;
+        case OMP:
+#ifdef USEOMP
+            return true;
+#else
+            return false;
+#endif
+        case CUDA:
+#ifdef USECUDA
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+void Backend::select(Type type, size_t autoThreshold) {
+    if (!isAvailable(type))
+        throw std::invalid_argument(std::string("backend ") + name(type) + " has not been built");
+    autoRows.store(autoThreshold, std::memory_order_relaxed);
+    selected.store(type, std::memory_order_relaxed);
+}
+
+Backend::Type Backend::resolve(size_t rows) {
+    Type type = getSelected();
+
+    /* The workers of a pool already keep the cpu busy, an openmp team each would oversubscribe it */
+    if (concurrentWorker && (type == AUTO || type == OMP)) return SERIAL;
+    if (type != AUTO) return type;
+
+    /* Small problems do not pay back the fork/join (or transfer) overhead of a parallel backend */
+    if (rows < autoRows.load(std::memory_order_relaxed)) return SERIAL;
+    if (isAvailable(OMP)) return OMP;
+    if (isAvailable(CUDA)) return CUDA;
+    return SERIAL;
+}
+
+const char *Backend::name(Type type) {
+    switch (type) {
+        case AUTO:
+            return "auto";
+        case SERIAL:
+            return "serial";
+        case OMP:
+            return "omp";
+        case CUDA:
+            return "cuda";
+    }
+    return "unknown";
+}
+
+Backend::Type Backend::parse(const std::string &name) {
+    for (Type type: {AUTO, SERIAL, OMP, CUDA})
+        if (name == Backend::name(type)) return type;
+    throw std::invalid_argument("unknown backend " + name);
+}
@@ -0,0 +1,169 @@
+#include "ConeStencil.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "StencilCache.hpp"
+
+namespace {
+    /**
+     * This function returns the cosine of an angle bound, right angles get an exact zero
+     * (acos(0) == PI / 2 while cos(PI / 2) is not zero, the voxels at 90 degrees must keep matching the bound)
+     */
+    double boundCos(double angle) {
+        double c = cos(angle);
+        return fabs(c) < 1e-12 ? 0 : c;
+    }
+
+    /**
+     * The classification of a cell of voxels
+     */
+    enum CellState : uint8_t {
+        UNKNOWN = 0,
+        OUTSIDE,
+        INSIDE,
+        MIXED
+    };
+
+    /**
+     * The margin kept between a cell angular range and an angle bound, so that rounding never misclassifies a cell
+     */
+    constexpr double angleMargin = 1e-7;
+}
+
+ConeStencil::ConeStencil(std::pair<double, double> angle, double distance, int grain) :
+        sphere(StencilCache::sphere(distance, grain)),
+        scaledMaskCenter(static_cast<int>(ceil(distance * grain))),
+        grain(grain),
+        cos_min(boundCos(angle.first)),
+        cos_max(boundCos(angle.second)),
+        cos_min_sq(cos_min * cos_min),
+        cos_max_sq(cos_max * cos_max),
+        check_min(angle.first > 0),
+        check_max(angle.second < M_PI),
+        min_angle(angle.first),
+        max_angle(angle.second) {}
+
+void ConeStencil::build(const RDGeom::Point3D &center, const RDGeom::Point3D &p1, const RDGeom::Point3D &p2,
+                        SpanStencil &stencil) const {
+    Grain::dispatch(grain, [&](auto g) { buildKernel(center, p1, p2, stencil, g); });
+}
+
+template<typename G>
+void ConeStencil::buildKernel(const RDGeom::Point3D &center, const RDGeom::Point3D &p1, const RDGeom::Point3D &p2,
+                              SpanStencil &stencil, G grain) const {
+    stencil.clear();
+    stencil.dim_x = sphere.dim_x;
+    stencil.dim_y = sphere.dim_y;
+    stencil.dim_z = sphere.dim_z;
+
+    // Calculate vector p2 --> p1 (only directions are compared, so it is not normalized)
+    const double ax = p1.x - p2.x, ay = p1.y - p2.y, az = p1.z - p2.z;
+    const double aa = ax * ax + ay * ay + az * az;
+    if (aa == 0) return;
+
+    /*
+     * Be d = (p2p1 . p2l1), the angle l1 <-- p2 --> p1 is in [#min, #max] iff cos(#max) <= cos(angle) <= cos(#min),
+     * that is comparing d * |d| against cos^2 * |p2p1|^2 * |p2l1|^2 with the signs of d and of the bounds
+     */
+    const double kMin = cos_min_sq * aa, kMax = cos_max_sq * aa;
+
+    // The cone lies against p2 --> p1 if #min > 90, along it if #max < 90, rows are clipped to that half-space
+    const double side = cos_min < 0 ? -1 : (cos_max > 0 ? 1 : 0);
+
+    const int C = scaledMaskCenter;
+
+    /*
+     * Coarse pass: the points of a cell lie within #reach of its center, so seen from p2 their angles with p2 --> p1
+     * lie within asin(reach / |p2 --> cell|) of the center one, cells are classified lazily as rows reach them
+     * (at coarse grains cells span too much of the pattern to be classified, so all of them are left mixed)
+     */
+    const int cells = (sphere.dim_x + cellEdge - 1) / cellEdge;
+    // The states are rebuilt for every pattern, into a buffer each thread keeps across patterns
+    thread_local std::vector<uint8_t> cellStates;
+    cellStates.assign(grain < minCellGrain ? 0 : static_cast<size_t>(cells) * cells * cells, UNKNOWN);
+    const double reach = sqrt(3.0) * (cellEdge - 1) / 2 / grain;
+    const double cellOffset = (cellEdge - 1) / 2.0 - C;
+    auto classify = [&](int cx, int cy, int cz) -> uint8_t {
+        double vx = ((cx * cellEdge + cellOffset) / grain + center.x) - p2.x;
+        double vy = ((cy * cellEdge + cellOffset) / grain + center.y) - p2.y;
+        double vz = ((cz * cellEdge + cellOffset) / grain + center.z) - p2.z;
+        double cross_x = ay * vz - az * vy, cross_y = az * vx - ax * vz, cross_z = ax * vy - ay * vx;
+        double length = sqrt(vx * vx + vy * vy + vz * vz);
+        if (length <= reach * (1 + angleMargin)) return MIXED;
+
+        double theta = atan2(sqrt(cross_x * cross_x + cross_y * cross_y + cross_z * cross_z),
+                             ax * vx + ay * vy + az * vz);
+        double spread = asin(reach / length);
+        double low = theta - spread, high = theta + spread;
+
+        if ((check_min && high < min_angle - angleMargin) || (check_max && low > max_angle + angleMargin))
+            return OUTSIDE;
+        if ((!check_min || low > min_angle + angleMargin) && (!check_max || high < max_angle - angleMargin))
+            return INSIDE;
+        return MIXED;
+    };
+
+    // Over all the rows of the sphere keep the x-runs of voxels inside the cone
+    for (const SpanStencil::Span &span: sphere.spans) {
+        double wy = (static_cast<double>(span.y - C) / grain + center.y) - p2.y;
+        double wz = (static_cast<double>(span.z - C) / grain + center.z) - p2.z;
+        double yz = wy * wy + wz * wz;
+        double dyz = ay * wy + az * wz;
+
+        int x_begin = span.x_begin, x_end = span.x_end;
+        if (side != 0) {
+            // side * d is linear along the row: sx * (x - C) / grain + r > 0 (a voxel of margin is kept on rounding)
+            double sx = side * ax;
+            double r = side * (ax * (center.x - p2.x) + dyz);
+            if (sx == 0) {
+                if (r <= 0) continue;
+            } else {
+                double t = C - r * grain / sx;
+                t = std::max(-2.0, std::min(t, sphere.dim_x + 2.0));
+                if (sx > 0) x_begin = std::max(x_begin, static_cast<int>(floor(t)));
+                else x_end = std::min(x_end, static_cast<int>(ceil(t)) + 1);
+            }
+            if (x_begin >= x_end) continue;
+        }
+
+        // Fine pass: runs are grown cell by cell, only the voxels of the mixed cells are tested one by one
+        const size_t rowCells = static_cast<size_t>(cells) * (span.z / cellEdge * cells + span.y / cellEdge);
+        int runBegin = -1;
+        auto mark = [&](int x, bool inside) {
+            if (inside) {
+                if (runBegin < 0) runBegin = x;
+            } else if (runBegin >= 0) {
+                stencil.push(span.y, span.z, runBegin, x);
+                runBegin = -1;
+            }
+        };
+
+        for (int x = x_begin; x < x_end;) {
+            int cellEnd = x_end;
+            if (grain >= minCellGrain) {
+                int cx = x / cellEdge;
+                uint8_t &state = cellStates[rowCells + cx];
+                cellEnd = std::min(x_end, (cx + 1) * cellEdge);
+                if (state == UNKNOWN) state = classify(cx, span.y / cellEdge, span.z / cellEdge);
+                if (state != MIXED) {
+                    mark(x, state == INSIDE);
+                    x = cellEnd;
+                    continue;
+                }
+            }
+
+            for (; x < cellEnd; ++x) {
+                double wx = (static_cast<double>(x - C) / grain + center.x) - p2.x;
+                double d = ax * wx + dyz;
+                double ww = wx * wx + yz;
+                double d2 = d * d;
+
+                bool minOk = !check_min || (cos_min >= 0 ? (d <= 0 || d2 <= kMin * ww) : (d < 0 && d2 >= kMin * ww));
+                bool maxOk = !check_max || (cos_max <= 0 ? (d >= 0 || d2 <= kMax * ww) : (d > 0 && d2 >= kMax * ww));
+                mark(x, ww > 0 && minOk && maxOk);
+            }
+        }
+        if (runBegin >= 0) stencil.push(span.y, span.z, runBegin, x_end);
+    }
+}
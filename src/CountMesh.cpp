@@ -0,0 +1,64 @@
+#include "CountMesh.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+void CountMesh::addRun(int y, int z, int begin, int end, int delta) {
+    count_t *countRow = &counts[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y)];
+    MoleculeMesh::data_t *row = MoleculeMesh::row(mesh.getData(), y, z, mesh.words_x, dim_y);
+
+    /* Only the voxels whose count leaves or reaches 0 change the set voxels */
+    for (int x = begin; x < end; ++x) {
+        MoleculeMesh::data_t bit = MoleculeMesh::data_t(1) << (x % MoleculeMesh::wordBits);
+        if (delta > 0) {
+            if (countRow[x] == std::numeric_limits<count_t>::max())
+                throw std::overflow_error("too many patterns covering a voxel of a count mesh");
+            if (countRow[x]++ == 0) row[x / MoleculeMesh::wordBits] |= bit;
+        } else {
+            if (--countRow[x] == 0) row[x / MoleculeMesh::wordBits] &= ~bit;
+        }
+    }
+}
+
+void CountMesh::addStencil(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z, int delta) {
+    /* Each run is clipped onto the operative window, as MoleculeMesh::stampSpans does */
+    for (const SpanStencil::Span &span: stencil.spans) {
+        int y = span.y + displ_y;
+        int z = span.z + displ_z;
+        if (y < 0 || y >= dim_y || z < 0 || z >= dim_z) continue;
+
+        int sx = std::max(span.x_begin + displ_x, 0);
+        int ex = std::min(span.x_end + displ_x, dim_x);
+        if (sx < ex) addRun(y, z, sx, ex, delta);
+    }
+}
+
+void CountMesh::addSphere(double center_x, double center_y, double center_z, double radius, int delta) {
+    const int padding = static_cast<int>(ceil(radius));
+    const double ds = radius * radius;
+
+    /* The operative window and the x-row runs are the ones of MoleculeMesh::stampSpheres */
+    int sx = std::max(static_cast<int>(floor(center_x)) - padding, 0);
+    int ex = std::min(static_cast<int>(ceil(center_x)) + padding, dim_x);
+    int sy = std::max(static_cast<int>(floor(center_y)) - padding, 0);
+    int ey = std::min(static_cast<int>(ceil(center_y)) + padding, dim_y);
+    int sz = std::max(static_cast<int>(floor(center_z)) - padding, 0);
+    int ez = std::min(static_cast<int>(ceil(center_z)) + padding, dim_z);
+
+    for (int z = sz; z < ez; z++) {
+        double dz = z - center_z;
+        double z_res = dz * dz;
+        for (int y = sy; y < ey; y++) {
+            double dy = y - center_y;
+            double y_res = dy * dy;
+            int begin, end;
+            if (MoleculeMesh::sphereRun(center_x, y_res, z_res, ds, sx, ex, begin, end))
+                addRun(y, z, begin, end, delta);
+        }
+    }
+}
+
+void CountMesh::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    mesh.clear();
+}
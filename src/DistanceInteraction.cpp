@@ -0,0 +1,98 @@
+#include "DistanceInteraction.hpp"
+#include "Backend.hpp"
+#include "DistanceTransform.hpp"
+#include "ScratchArena.hpp"
+#include "StencilCache.hpp"
+
+bool DistanceInteraction::getInteraction(const MoleculeContext &context, MoleculeMesh &interactionMask,
+                                         MoleculeMesh &subtractionMask) {
+    return stampMatches(context, interactionMask, [&](const MatchCache::matches_t &matches) {
+        // The work is estimated as the rows of the pattern windows stamped, one per match
+        Backend::Type backend = Backend::resolve(matches->size() *
+                                                 Backend::patternRows(distance, interactionMask.grain));
+
+        // Many matches in a compact box are cheaper as a distance transform, which runs on the cpu backends only
+        if (backend != Backend::CUDA && DistanceTransform::getSelected() != DistanceTransform::STAMP) {
+            std::pmr::vector<int> seeds(ScratchArena::resource());
+            seedVoxels(context, matches, interactionMask, seeds);
+            if (DistanceTransform::resolve(seeds.data(), seeds.size() / 3, distance * interactionMask.grain,
+                                           interactionMask) == DistanceTransform::EDT)
+                return getInteractionTransform(seeds, interactionMask, subtractionMask);
+        }
+
+        switch (backend) {
+#ifdef USEOMP
+            case Backend::OMP:
+                return getInteractionOmp(context, matches, interactionMask, subtractionMask);
+#endif
+#ifdef USECUDA
+            case Backend::CUDA:
+                return getInteractionCuda(context, matches, interactionMask, subtractionMask);
+#endif
+            default:
+                return getInteractionSerial(context, matches, interactionMask, subtractionMask);
+        }
+    });
+}
+
+void DistanceInteraction::seedVoxels(const MoleculeContext &context, const MatchCache::matches_t &matches,
+                                     const MoleculeMesh &interactionMask, std::pmr::vector<int> &seeds) const {
+    // Resolve the interaction-centroid of every match into the coordinate block
+    std::pmr::vector<int> centroids(ScratchArena::resource());
+    Interaction::resolveMatches(*matches, 1, centroids);
+
+    // Seed the voxel of every centroid, the one the serial getInteraction() centers its pattern at
+    const int grain = interactionMask.grain;
+    int scaledMaskRadius = static_cast<int>(ceil(distance * grain));
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskRadius);
+    seeds.resize(3 * centroids.size());
+    for (size_t i = 0; i < centroids.size(); ++i) {
+        int atomId = centroids[i];
+        double px = (context.x[atomId] - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+        double py = (context.y[atomId] - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+        double pz = (context.z[atomId] - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+        seeds[3 * i] = static_cast<int>(round(px)) + scaledMaskRadius;
+        seeds[3 * i + 1] = static_cast<int>(round(py)) + scaledMaskRadius;
+        seeds[3 * i + 2] = static_cast<int>(round(pz)) + scaledMaskRadius;
+    }
+}
+
+bool DistanceInteraction::getInteractionTransform(const std::pmr::vector<int> &seeds, MoleculeMesh &interactionMask,
+                                                  MoleculeMesh &subtractionMask) {
+    if (seeds.empty()) return false;
+
+    // Set every voxel within the distance from a centroid at once
+    DistanceTransform::threshold(seeds.data(), seeds.size() / 3, distance * interactionMask.grain, interactionMask);
+
+    interactionMask.sub(subtractionMask, 0, 0, 0);
+
+    return true;
+}
+
+void DistanceInteraction::placeMatches(const MoleculeContext &context, const std::vector<RDKit::MatchVectType> &matches,
+                                       const std::vector<size_t> &sites, const MoleculeMesh &interactionMask,
+                                       std::vector<MatchStamp> &stamps) {
+    // All matches share the spherical pattern, centered at the interaction-centroid
+    const int grain = interactionMask.grain;
+    int scaledMaskRadius = static_cast<int>(ceil(distance * grain));
+    const SpanStencil &bubble = StencilCache::sphere(distance, grain);
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - scaledMaskRadius);
+
+    for (size_t site: sites) {
+        MatchStamp &stamp = stamps[site];
+        stamp.stencil = nullptr;
+        if (matches[site].empty()) continue;
+        int atomId = matches[site][0].second;
+
+        // Find the zero-point displacement of pattern from the zero-point of support-mask
+        double px = (context.x[atomId] - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+        double py = (context.y[atomId] - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+        double pz = (context.z[atomId] - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+        // Discretize the displacement
+        stamp.displ_x = static_cast<int>(round(px));
+        stamp.displ_y = static_cast<int>(round(py));
+        stamp.displ_z = static_cast<int>(round(pz));
+        stamp.stencil = &bubble;
+    }
+}
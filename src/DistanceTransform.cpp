@@ -0,0 +1,202 @@
+#include "DistanceTransform.hpp"
+#include "Backend.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+std::atomic<DistanceTransform::Engine> DistanceTransform::selected{DistanceTransform::AUTO};
+
+void DistanceTransform::fieldBox(const int *seeds, size_t n_seeds, double scaledRadius, const MoleculeMesh &mesh,
+                                 int begin[3], int end[3]) {
+    const int dims[3] = {mesh.dim_x, mesh.dim_y, mesh.dim_z};
+    const int reach = static_cast<int>(floor(scaledRadius));
+
+    for (int axis = 0; axis < 3; ++axis) {
+        int min = seeds[axis], max = seeds[axis];
+        for (size_t i = 1; i < n_seeds; ++i) {
+            min = std::min(min, seeds[3 * i + axis]);
+            max = std::max(max, seeds[3 * i + axis]);
+        }
+        begin[axis] = std::min(std::max(min - reach, 0), min);
+        end[axis] = std::max(std::min(max + reach + 1, dims[axis]), max + 1);
+    }
+}
+
+void DistanceTransform::dropPoles(const int *seeds, size_t n_seeds, double scaledRadius, int32_t *field,
+                                  const int begin[3], const int end[3]) {
+    // Only a whole radius reaches the poles of the window (its squared distance is the one of the poles)
+    const int radius = static_cast<int>(scaledRadius);
+    if (radius < 1 || radius != scaledRadius) return;
+    const int32_t ds = radius * radius;
+    const size_t sy = end[0] - begin[0], sz = sy * (end[1] - begin[1]);
+
+    // The offsets at the radius from a seed the window holds (all of them but the poles at +R)
+    std::vector<int> shell;
+    for (int dz = -radius; dz <= radius; ++dz) {
+        for (int dy = -radius; dy <= radius; ++dy) {
+            int rest = ds - dy * dy - dz * dz;
+            if (rest < 0) continue;
+            int dx = static_cast<int>(floor(sqrt(rest)));
+            while ((dx + 1) * (dx + 1) <= rest) ++dx;
+            while (dx * dx > rest) --dx;
+            if (dx * dx != rest) continue;
+            for (int x: {-dx, dx}) {
+                bool pole = (x == radius) || (dy == radius) || (dz == radius);
+                if (!pole) shell.insert(shell.end(), {x, dy, dz});
+                if (dx == 0) break;
+            }
+        }
+    }
+
+    // A pole voxel at the radius from its nearest seeds is kept if one of them (a voxel at 0) holds it in the window
+    for (size_t i = 0; i < n_seeds; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            int p[3] = {seeds[3 * i], seeds[3 * i + 1], seeds[3 * i + 2]};
+            p[axis] += radius;
+            if (p[axis] >= end[axis]) continue;
+            int32_t &voxel = field[(p[0] - begin[0]) + (p[1] - begin[1]) * sy + (p[2] - begin[2]) * sz];
+            if (voxel != ds) continue;
+
+            bool held = false;
+            for (size_t o = 0; o < shell.size() && !held; o += 3) {
+                int s[3] = {p[0] - shell[o], p[1] - shell[o + 1], p[2] - shell[o + 2]};
+                if (s[0] < begin[0] || s[0] >= end[0] || s[1] < begin[1] || s[1] >= end[1] ||
+                    s[2] < begin[2] || s[2] >= end[2])
+                    continue;
+                held = field[(s[0] - begin[0]) + (s[1] - begin[1]) * sy + (s[2] - begin[2]) * sz] == 0;
+            }
+            if (!held) voxel = infinity;
+        }
+    }
+}
+
+DistanceTransform::Engine DistanceTransform::resolve(const int *seeds, size_t n_seeds, double scaledRadius,
+                                                     const MoleculeMesh &mesh) {
+    Engine engine = getSelected();
+    if (engine != AUTO) return engine;
+    if (n_seeds == 0) return STAMP;
+
+    // Stamping fills the rows of one pattern window per seed, the transform sweeps every voxel of the field
+    int begin[3], end[3];
+    fieldBox(seeds, n_seeds, scaledRadius, mesh, begin, end);
+    size_t fieldVoxels = static_cast<size_t>(end[0] - begin[0]) * (end[1] - begin[1]) * (end[2] - begin[2]);
+    size_t stampRows = n_seeds * Backend::patternRows(scaledRadius, 1);
+    return stampRows > transformRows * fieldVoxels ? EDT : STAMP;
+}
+
+void DistanceTransform::threshold(const int *seeds, size_t n_seeds, double scaledRadius, MoleculeMesh &mesh) {
+    if (n_seeds == 0) return;
+
+    // The work is estimated as the rows of the field
+    int begin[3], end[3];
+    fieldBox(seeds, n_seeds, scaledRadius, mesh, begin, end);
+    switch (Backend::resolve(static_cast<size_t>(end[1] - begin[1]) * (end[2] - begin[2]))) {
+#ifdef USEOMP
+        case Backend::OMP:
+            thresholdOmp(seeds, n_seeds, scaledRadius, mesh);
+            break;
+#endif
+        default:
+            thresholdSerial(seeds, n_seeds, scaledRadius, mesh);
+            break;
+    }
+}
+
+bool DistanceTransform::transformLine(int32_t *f, int n, double ds, Workspace &workspace) {
+    int *v = workspace.v.data();
+    int64_t *zNum = workspace.zNum.data(), *zDen = workspace.zDen.data();
+    int32_t *g = workspace.g.data();
+
+    /*
+     * Lower envelope of the parabolas rooted at the finite samples: the parabolas of p < q intersect at
+     * s = ((g[q] + q^2) - (g[p] + p^2)) / (2 (q - p)), the boundary on the left of the first parabola is -infinity
+     */
+    int k = -1;
+    for (int q = 0; q < n; ++q) {
+        g[q] = f[q];
+        if (g[q] == infinity) continue;
+
+        int64_t sNum = 0, sDen = 1;
+        while (k >= 0) {
+            int p = v[k];
+            sNum = (static_cast<int64_t>(g[q]) + static_cast<int64_t>(q) * q) -
+                   (static_cast<int64_t>(g[p]) + static_cast<int64_t>(p) * p);
+            sDen = 2 * static_cast<int64_t>(q - p);
+            if (k == 0 || sNum * zDen[k] > zNum[k] * sDen) break;
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        zNum[k] = sNum;
+        zDen[k] = sDen;
+    }
+
+    /* A line without samples stays at infinity */
+    if (k < 0) return false;
+
+    /* Squared distance of every sample from the parabola of the envelope over it */
+    int j = 0;
+    for (int q = 0; q < n; ++q) {
+        while (j < k && zNum[j + 1] < q * zDen[j + 1]) ++j;
+        int64_t d = q - v[j];
+        d = d * d + g[v[j]];
+        f[q] = d <= ds ? static_cast<int32_t>(d) : infinity;
+    }
+    return true;
+}
+
+void DistanceTransform::transformTile(int32_t *f, int n, size_t stride, int count, double ds,
+                                      Workspace &workspace) {
+    int32_t *tile = workspace.tile.data();
+
+    /* Gather the lines, one row of adjacent samples at a time */
+    for (int q = 0; q < n; ++q) {
+        const int32_t *source = f + q * stride;
+        for (int l = 0; l < count; ++l)
+            tile[l * n + q] = source[l];
+    }
+
+    /* Transform them, and scatter back the ones having a finite sample */
+    bool finite[tileLines];
+    bool any = false;
+    for (int l = 0; l < count; ++l)
+        any |= finite[l] = transformLine(tile + l * n, n, ds, workspace);
+    if (!any) return;
+
+    for (int q = 0; q < n; ++q) {
+        int32_t *target = f + q * stride;
+        for (int l = 0; l < count; ++l)
+            if (finite[l]) target[l] = tile[l * n + q];
+    }
+}
+
+void DistanceTransform::thresholdRow(const int32_t *f, MoleculeMesh::data_t *row, int begin, int end, double ds) {
+    // Pack the voxels within the threshold one word at a time
+    int x = begin;
+    while (x < end) {
+        int w = x / MoleculeMesh::wordBits;
+        int wordEnd = std::min(end, (w + 1) * MoleculeMesh::wordBits);
+        MoleculeMesh::data_t word = 0;
+        for (; x < wordEnd; ++x)
+            word |= static_cast<MoleculeMesh::data_t>(f[x - begin] <= ds) << (x % MoleculeMesh::wordBits);
+        row[w] |= word;
+    }
+}
+
+const char *DistanceTransform::name(Engine engine) {
+    switch (engine) {
+        case AUTO:
+            return "auto";
+        case STAMP:
+            return "stamp";
+        case EDT:
+            return "edt";
+    }
+    return "unknown";
+}
+
+DistanceTransform::Engine DistanceTransform::parse(const std::string &name) {
+    for (Engine engine: {AUTO, STAMP, EDT})
+        if (name == DistanceTransform::name(engine)) return engine;
+    throw std::invalid_argument("unknown distance engine " + name);
+}
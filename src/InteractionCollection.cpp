@@ -3,15 +3,18 @@
 #include "HBInteraction.hpp"
 #include "IonicInteraction.hpp"
 #include "MetalInteraction.hpp"
+#include "PIStackingInteraction.hpp"
 
-std::vector<std::pair<std::string, Interaction *>> InteractionCollection::buildList() {
-    std::vector<std::pair<std::string, Interaction *>> interactionsList;
-    interactionsList.push_back({"Hydrophobic", new HydrophobicInteraction()});
-    interactionsList.push_back({"HBAcceptor", new HBAcceptorInteraction()});
-    interactionsList.push_back({"HBDonor", new HBDonorInteraction()});
-    interactionsList.push_back({"Cationic", new AnionicInteraction()});
-    interactionsList.push_back({"Anionic", new CationicInteraction()});
-    interactionsList.push_back({"MetalAcceptor", new MetalAcceptorInteraction()});
-    interactionsList.push_back({"MetalDonor", new MetalDonorInteraction()});
+InteractionCollection::list_t InteractionCollection::buildList() {
+    InteractionCollection::list_t interactionsList;
+    interactionsList.emplace_back("Hydrophobic", std::make_unique<HydrophobicInteraction>());
+    interactionsList.emplace_back("HBAcceptor", std::make_unique<HBAcceptorInteraction>());
+    interactionsList.emplace_back("HBDonor", std::make_unique<HBDonorInteraction>());
+    interactionsList.emplace_back("Cationic", std::make_unique<AnionicInteraction>());
+    interactionsList.emplace_back("Anionic", std::make_unique<CationicInteraction>());
+    interactionsList.emplace_back("MetalAcceptor", std::make_unique<MetalAcceptorInteraction>());
+    interactionsList.emplace_back("MetalDonor", std::make_unique<MetalDonorInteraction>());
+    interactionsList.emplace_back("FaceToFace", std::make_unique<FaceToFaceInteraction>());
+    interactionsList.emplace_back("EdgeToFace", std::make_unique<EdgeToFaceInteraction>());
     return interactionsList;
 }
\ No newline at end of file
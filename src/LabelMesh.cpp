@@ -0,0 +1,62 @@
+#include "LabelMesh.hpp"
+#include "Metrics.hpp"
+
+void LabelMesh::merge(const MoleculeMesh &mesh, int channel) {
+    const auto bit = static_cast<label_t>(1u << channel);
+    channels |= bit;
+
+    /* Visit only the set voxels of the packed x-rows */
+    for (int z = 0; z < dim_z; ++z) {
+        for (int y = 0; y < dim_y; ++y) {
+            const MoleculeMesh::data_t *row = MoleculeMesh::row(mesh.getData(), y, z, mesh.words_x, mesh.dim_y);
+            label_t *labelRow = &labels[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y)];
+            for (int w = 0; w < mesh.words_x; ++w) {
+                MoleculeMesh::data_t word = row[w];
+                while (word) {
+                    labelRow[w * MoleculeMesh::wordBits + __builtin_ctzll(word)] |= bit;
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+}
+
+void LabelMesh::sub(const MoleculeMesh &mask) {
+    Metrics::Timer timer(Metrics::SUBTRACT);
+    size_t cleared = 0;
+
+    /* Visit only the set voxels of the packed x-rows */
+    for (int z = 0; z < dim_z; ++z) {
+        for (int y = 0; y < dim_y; ++y) {
+            const MoleculeMesh::data_t *row = MoleculeMesh::row(mask.getData(), y, z, mask.words_x, mask.dim_y);
+            label_t *labelRow = &labels[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y)];
+            for (int w = 0; w < mask.words_x; ++w) {
+                MoleculeMesh::data_t word = row[w];
+                while (word) {
+                    label_t &label = labelRow[w * MoleculeMesh::wordBits + __builtin_ctzll(word)];
+                    cleared += label != 0;
+                    label = 0;
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+
+    Metrics::count(Metrics::VOXELS_SUBTRACTED, cleared);
+}
+
+MoleculeMesh LabelMesh::extract(int channel) const {
+    const auto bit = static_cast<label_t>(1u << channel);
+    MoleculeMesh mesh(dim_x, dim_y, dim_z, globalDisplacement, internalDisplacement, grain);
+
+    for (int z = 0; z < dim_z; ++z) {
+        for (int y = 0; y < dim_y; ++y) {
+            const label_t *labelRow = &labels[static_cast<size_t>(dim_x) * (static_cast<size_t>(z) * dim_y + y)];
+            MoleculeMesh::data_t *row = MoleculeMesh::row(mesh.getData(), y, z, mesh.words_x, mesh.dim_y);
+            for (int x = 0; x < dim_x; ++x)
+                if (labelRow[x] & bit) row[x / MoleculeMesh::wordBits] |= MoleculeMesh::data_t(1) << (x % MoleculeMesh::wordBits);
+        }
+    }
+
+    return mesh;
+}
@@ -0,0 +1,78 @@
+#include "MatchCache.hpp"
+#include "ScratchArena.hpp"
+
+std::pmr::vector<int64_t> MatchCache::topology(const RDKit::ROMol &molecule, std::pmr::memory_resource *resource) {
+    std::pmr::vector<int64_t> signature(resource);
+    signature.reserve(2 + 8 * molecule.getNumAtoms() + 4 * molecule.getNumBonds());
+
+    signature.push_back(molecule.getNumAtoms());
+    for (unsigned int i = 0; i < molecule.getNumAtoms(); ++i) {
+        const RDKit::Atom *atom = molecule.getAtomWithIdx(i);
+        signature.push_back(atom->getAtomicNum());
+        signature.push_back(atom->getFormalCharge());
+        signature.push_back(atom->getIsotope());
+        signature.push_back(atom->getIsAromatic());
+        signature.push_back(atom->getTotalNumHs());
+        signature.push_back(atom->getDegree());
+        signature.push_back(atom->getNumRadicalElectrons());
+        signature.push_back(atom->getChiralTag());
+    }
+
+    signature.push_back(molecule.getNumBonds());
+    for (unsigned int i = 0; i < molecule.getNumBonds(); ++i) {
+        const RDKit::Bond *bond = molecule.getBondWithIdx(i);
+        signature.push_back(bond->getBeginAtomIdx());
+        signature.push_back(bond->getEndAtomIdx());
+        signature.push_back(bond->getBondType());
+        signature.push_back(bond->getIsAromatic());
+    }
+
+    return signature;
+}
+
+uint64_t MatchCache::hash(const std::pmr::vector<int64_t> &signature) {
+    // FNV-1a over the signature values
+    uint64_t h = 14695981039346656037ull;
+    for (int64_t value: signature) {
+        h ^= static_cast<uint64_t>(value);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+MatchCache::matches_t MatchCache::find(const RDKit::ROMol &molecule, const RDKit::ROMol &pattern) {
+    // The signature of the lookup is a temporary of the molecule, only cached signatures are copied out of the arena
+    std::pmr::vector<int64_t> signature = topology(molecule, ScratchArena::resource());
+    uint64_t key = hash(signature);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto cached = entries.find(key);
+        if (cached != entries.end() && cached->second.signature == signature) {
+            recents.splice(recents.begin(), recents, cached->second.recent);
+            return cached->second.matches;
+        }
+    }
+
+    // Matching runs unlocked, the same topology may be matched twice by concurrent callers
+    auto matches = std::make_shared<std::vector<RDKit::MatchVectType>>();
+    RDKit::SubstructMatch(molecule, pattern, *matches);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = entries.find(key);
+    if (cached != entries.end()) {
+        // A colliding (or concurrently matched) topology is replaced
+        recents.erase(cached->second.recent);
+        entries.erase(cached);
+    }
+    while (entries.size() >= capacity && !recents.empty()) {
+        entries.erase(recents.back());
+        recents.pop_back();
+    }
+    if (capacity > 0) {
+        recents.push_front(key);
+        entries[key] = {std::pmr::vector<int64_t>(signature.begin(), signature.end()), matches, recents.begin()};
+    }
+
+    return matches;
+}
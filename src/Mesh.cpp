@@ -0,0 +1,103 @@
+#include "Mesh.hpp"
+#include "Metrics.hpp"
+
+/**
+ * This function returns the number of set voxels of the packed data of a discrete space
+ */
+static size_t countVoxels(const MoleculeMesh::data_t *data, int dim_x, int dim_y, int dim_z) {
+    size_t words = static_cast<size_t>(MoleculeMesh::rowWords(dim_x)) * dim_y * dim_z;
+    size_t count = 0;
+    for (size_t i = 0; i < words; ++i)
+        count += __builtin_popcountll(data[i]);
+    return count;
+}
+
+void MoleculeMesh::addMeshes(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_add,
+                             const int displ_x, const int displ_y, const int displ_z,
+                             const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                             const int add_dim_x, const int add_dim_y, const int add_dim_z) {
+    // The data are on the host, the CUDA kernels merge their device data with addMeshesCuda() instead
+    switch (Backend::resolve(static_cast<size_t>(add_dim_y) * add_dim_z)) {
+#ifdef USEOMP
+        case Backend::OMP:
+            addMeshesOmp(data, to_add, displ_x, displ_y, displ_z, data_dim_x, data_dim_y, data_dim_z,
+                         add_dim_x, add_dim_y, add_dim_z);
+            return;
+#endif
+        default:
+            addMeshesSerial(data, to_add, displ_x, displ_y, displ_z, data_dim_x, data_dim_y, data_dim_z,
+                            add_dim_x, add_dim_y, add_dim_z);
+    }
+}
+
+void MoleculeMesh::subMeshes(MoleculeMesh::data_t *data, const MoleculeMesh::data_t *to_subtract,
+                             const int displ_x, const int displ_y, const int displ_z,
+                             const int data_dim_x, const int data_dim_y, const int data_dim_z,
+                             const int sub_dim_x, const int sub_dim_y, const int sub_dim_z) {
+    Metrics::Timer timer(Metrics::SUBTRACT);
+    /*
+     * The data are on the host (the CUDA kernels subtract their device data with subMeshesCuda() instead), counting
+     * the unset voxels takes a pass over the data, so it is done only if metrics are collected
+     */
+    size_t startVoxels = Metrics::isEnabled() ? countVoxels(data, data_dim_x, data_dim_y, data_dim_z) : 0;
+
+    switch (Backend::resolve(static_cast<size_t>(sub_dim_y) * sub_dim_z)) {
+#ifdef USEOMP
+        case Backend::OMP:
+            subMeshesOmp(data, to_subtract, displ_x, displ_y, displ_z, data_dim_x, data_dim_y, data_dim_z,
+                         sub_dim_x, sub_dim_y, sub_dim_z);
+            break;
+#endif
+        default:
+            subMeshesSerial(data, to_subtract, displ_x, displ_y, displ_z, data_dim_x, data_dim_y, data_dim_z,
+                            sub_dim_x, sub_dim_y, sub_dim_z);
+    }
+
+    if (Metrics::isEnabled())
+        Metrics::count(Metrics::VOXELS_SUBTRACTED, startVoxels - countVoxels(data, data_dim_x, data_dim_y, data_dim_z));
+}
+
+void MoleculeMesh::stampSpans(MoleculeMesh::data_t *data, const SpanStencil::Span *spans, const size_t n_spans,
+                              const int displ_x, const int displ_y, const int displ_z,
+                              const int data_dim_x, const int data_dim_y, const int data_dim_z) {
+    const int data_words_x = MoleculeMesh::rowWords(data_dim_x);
+
+    /*
+     * Fill each run clipped onto the operative window (a single pattern is too little work to be split,
+     * parallel backends split the patterns instead, see MoleculeMesh::stamp over a range of rows)
+     */
+    for (size_t i = 0; i < n_spans; i++) {
+        const SpanStencil::Span &span = spans[i];
+
+        int y = span.y + displ_y;
+        int z = span.z + displ_z;
+        if (y < 0 || y >= data_dim_y || z < 0 || z >= data_dim_z) continue;
+
+        int sx = span.x_begin + displ_x;
+        if (sx < 0) {
+            sx = 0;
+        }
+
+        int ex = span.x_end + displ_x;
+        if (ex > data_dim_x) {
+            ex = data_dim_x;
+        }
+
+        MoleculeMesh::fillRow(MoleculeMesh::row(data, y, z, data_words_x, data_dim_y), sx, ex);
+    }
+}
+
+void MoleculeMesh::stampSpheres(MoleculeMesh::data_t *data,
+                                const double *centers_x, const double *centers_y, const double *centers_z,
+                                const size_t n_spheres, const double radius,
+                                const int data_dim_x, const int data_dim_y, const int data_dim_z) {
+    /* The CUDA backend rasterizes the spheres on the host, as the serial one */
+#ifdef USEOMP
+    auto edge = static_cast<size_t>(2 * ceil(radius) + 1);
+    if (Backend::resolve(n_spheres * edge * edge) == Backend::OMP) {
+        stampSpheresOmp(data, centers_x, centers_y, centers_z, n_spheres, radius, data_dim_x, data_dim_y, data_dim_z);
+        return;
+    }
+#endif
+    stampSpheresSerial(data, centers_x, centers_y, centers_z, n_spheres, radius, data_dim_x, data_dim_y, data_dim_z);
+}
@@ -0,0 +1,480 @@
+#include "MeshIO.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    const char gridMagic[4] = {'P', 'L', 'C', 'G'};
+    const uint32_t gridVersion = 1;
+
+    template<typename T>
+    void put(std::ofstream &out, const T &value) {
+        out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void get(std::ifstream &in, T &value) {
+        in.read(reinterpret_cast<char *>(&value), sizeof(T));
+    }
+
+    /**
+     * This function writes the 1024 bytes header of an MRC2014 map of a mesh, the map starts at the integer voxel
+     * offset of the mesh origin (ORIGIN is left at zero so that both EM and crystallographic readers agree),
+     * any discrete space type (MoleculeMesh, LabelMesh) is accepted
+     */
+    template<typename Mesh>
+    void putMRCHeader(std::ofstream &out, const Mesh &mesh, int32_t mode,
+                      float dmin, float dmax, float dmean, const std::vector<std::string> &labels) {
+        int32_t header[256] = {};
+        auto *fheader = reinterpret_cast<float *>(header);
+
+        /* Sizes, mode and start of the map (in voxels) */
+        header[0] = mesh.dim_x;
+        header[1] = mesh.dim_y;
+        header[2] = mesh.dim_z;
+        header[3] = mode;
+        header[4] = static_cast<int32_t>(lround(mesh.globalDisplacement.x * mesh.grain)) -
+                    mesh.internalDisplacement;
+        header[5] = static_cast<int32_t>(lround(mesh.globalDisplacement.y * mesh.grain)) -
+                    mesh.internalDisplacement;
+        header[6] = static_cast<int32_t>(lround(mesh.globalDisplacement.z * mesh.grain)) -
+                    mesh.internalDisplacement;
+
+        /* Sampling and unit cell */
+        header[7] = mesh.dim_x;
+        header[8] = mesh.dim_y;
+        header[9] = mesh.dim_z;
+        fheader[10] = static_cast<float>(mesh.dim_x) / static_cast<float>(mesh.grain);
+        fheader[11] = static_cast<float>(mesh.dim_y) / static_cast<float>(mesh.grain);
+        fheader[12] = static_cast<float>(mesh.dim_z) / static_cast<float>(mesh.grain);
+        fheader[13] = fheader[14] = fheader[15] = 90.0f;
+
+        /* Axis order (x fastest), density statistics, space group */
+        header[16] = 1;
+        header[17] = 2;
+        header[18] = 3;
+        fheader[19] = dmin;
+        fheader[20] = dmax;
+        fheader[21] = dmean;
+        header[22] = 1;
+
+        /* Format identification (version 2014, little-endian machine stamp) */
+        header[27] = 20140;
+        memcpy(&header[52], "MAP ", 4);
+        header[53] = 0x00004444;
+
+        /* Labels */
+        header[55] = static_cast<int32_t>(std::min<size_t>(labels.size(), 10));
+        for (size_t i = 0; i < labels.size() && i < 10; ++i)
+            memcpy(reinterpret_cast<char *>(&header[56]) + 80 * i, labels[i].c_str(),
+                   std::min<size_t>(labels[i].size(), 80));
+
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+    }
+
+    /**
+     * The box of an occupancy map, in the form of the discrete spaces the map header is written from
+     */
+    struct OccupancyBox {
+        int dim_x, dim_y, dim_z;
+        RDGeom::Point3D globalDisplacement;
+        int internalDisplacement;
+        int grain;
+
+        explicit OccupancyBox(const OccupancyMap &map) :
+                dim_x(map.getDimX()), dim_y(map.getDimY()), dim_z(map.getDimZ()),
+                globalDisplacement(map.getOrigin()), internalDisplacement(0), grain(map.grain) {}
+    };
+
+    /**
+     * This function returns the position of the center of voxel (0, 0, 0) of a mesh
+     */
+    RDGeom::Point3D meshOrigin(const MoleculeMesh &mesh) {
+        double internal = static_cast<double>(mesh.internalDisplacement) / mesh.grain;
+        return {mesh.globalDisplacement.x - internal,
+                mesh.globalDisplacement.y - internal,
+                mesh.globalDisplacement.z - internal};
+    }
+
+    /**
+     * This function calculates the run-length description of a mesh, runs alternate empty/set voxels
+     */
+    std::vector<uint32_t> encodeRuns(const MoleculeMesh &mesh) {
+        std::vector<uint32_t> runs;
+        bool current = false;
+        uint32_t length = 0;
+
+        for (int z = 0; z < mesh.dim_z; ++z) {
+            for (int y = 0; y < mesh.dim_y; ++y) {
+                const MoleculeMesh::data_t *row = MoleculeMesh::row(mesh.getData(), y, z, mesh.words_x, mesh.dim_y);
+                for (int w = 0; w < mesh.words_x; ++w) {
+                    int bits = mesh.dim_x - w * MoleculeMesh::wordBits;
+                    if (bits > MoleculeMesh::wordBits) bits = MoleculeMesh::wordBits;
+
+                    /* Jump from one run boundary to the next one */
+                    MoleculeMesh::data_t word = row[w];
+                    int b = 0;
+                    while (b < bits) {
+                        MoleculeMesh::data_t diff = (current ? ~word : word) & MoleculeMesh::rangeMask(0, b, bits);
+                        if (diff == 0) {
+                            length += bits - b;
+                            break;
+                        }
+                        int t = __builtin_ctzll(diff);
+                        length += t - b;
+                        runs.push_back(length);
+                        current = !current;
+                        length = 0;
+                        b = t;
+                    }
+                }
+            }
+        }
+        runs.push_back(length);
+        return runs;
+    }
+}
+
+size_t MeshIO::writeBinary(const MoleculeMesh &mesh, const std::string &path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("cannot open grid file: " + path);
+
+    /* Choose the smaller encoding */
+    std::vector<uint32_t> runs = encodeRuns(mesh);
+    uint64_t packedSize = mesh.getDataSize() * sizeof(MoleculeMesh::data_t);
+    uint64_t runsSize = runs.size() * sizeof(uint32_t);
+    Encoding encoding = runsSize < packedSize ? RUN_LENGTH : PACKED_BITS;
+    uint64_t payloadSize = encoding == RUN_LENGTH ? runsSize : packedSize;
+
+    /* Header */
+    out.write(gridMagic, sizeof(gridMagic));
+    put(out, gridVersion);
+    put(out, static_cast<int32_t>(mesh.dim_x));
+    put(out, static_cast<int32_t>(mesh.dim_y));
+    put(out, static_cast<int32_t>(mesh.dim_z));
+    put(out, mesh.globalDisplacement.x);
+    put(out, mesh.globalDisplacement.y);
+    put(out, mesh.globalDisplacement.z);
+    put(out, static_cast<int32_t>(mesh.internalDisplacement));
+    put(out, static_cast<int32_t>(mesh.grain));
+    put(out, static_cast<uint32_t>(encoding));
+    put(out, payloadSize);
+
+    /* Payload */
+    if (encoding == RUN_LENGTH) out.write(reinterpret_cast<const char *>(runs.data()), static_cast<std::streamsize>(runsSize));
+    else out.write(reinterpret_cast<const char *>(mesh.getData()), static_cast<std::streamsize>(packedSize));
+
+    if (!out) throw std::runtime_error("cannot write grid file: " + path);
+    return static_cast<size_t>(out.tellp());
+}
+
+std::unique_ptr<MoleculeMesh> MeshIO::readBinary(const std::string &path, int *grain) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("cannot open grid file: " + path);
+
+    /* Header */
+    char magic[4];
+    uint32_t version, encoding;
+    int32_t dim_x, dim_y, dim_z, internalDisplacement, fileGrain;
+    RDGeom::Point3D globalDisplacement;
+    uint64_t payloadSize;
+
+    in.read(magic, sizeof(magic));
+    get(in, version);
+    if (!in || memcmp(magic, gridMagic, sizeof(gridMagic)) != 0 || version != gridVersion)
+        throw std::runtime_error("not a grid file: " + path);
+
+    get(in, dim_x);
+    get(in, dim_y);
+    get(in, dim_z);
+    get(in, globalDisplacement.x);
+    get(in, globalDisplacement.y);
+    get(in, globalDisplacement.z);
+    get(in, internalDisplacement);
+    get(in, fileGrain);
+    get(in, encoding);
+    get(in, payloadSize);
+    if (!in || dim_x < 0 || dim_y < 0 || dim_z < 0 || fileGrain < 1)
+        throw std::runtime_error("corrupted grid file header: " + path);
+
+    auto mesh = std::make_unique<MoleculeMesh>(dim_x, dim_y, dim_z, globalDisplacement, internalDisplacement,
+                                               fileGrain);
+
+    /* Payload */
+    if (encoding == PACKED_BITS) {
+        if (payloadSize != mesh->getDataSize() * sizeof(MoleculeMesh::data_t))
+            throw std::runtime_error("corrupted grid file payload: " + path);
+        in.read(reinterpret_cast<char *>(mesh->getData()), static_cast<std::streamsize>(payloadSize));
+    } else if (encoding == RUN_LENGTH) {
+        std::vector<uint32_t> runs(payloadSize / sizeof(uint32_t));
+        in.read(reinterpret_cast<char *>(runs.data()), static_cast<std::streamsize>(payloadSize));
+
+        /* Walk the runs over the voxels ordered by z, then y, then x */
+        uint64_t voxel = 0, total = static_cast<uint64_t>(dim_x) * dim_y * dim_z;
+        for (size_t i = 0; i < runs.size(); ++i) {
+            uint64_t end = voxel + runs[i];
+            if (end > total) throw std::runtime_error("corrupted grid file payload: " + path);
+            if (i % 2 == 1) {
+                while (voxel < end) {
+                    int x = static_cast<int>(voxel % dim_x);
+                    uint64_t rowId = voxel / dim_x;
+                    int rowEnd = static_cast<int>(std::min<uint64_t>(dim_x, x + (end - voxel)));
+                    MoleculeMesh::fillRow(MoleculeMesh::row(mesh->getData(), static_cast<int>(rowId % dim_y),
+                                                            static_cast<int>(rowId / dim_y), mesh->words_x, dim_y),
+                                          x, rowEnd);
+                    voxel += rowEnd - x;
+                }
+            }
+            voxel = end;
+        }
+    } else {
+        throw std::runtime_error("unknown grid file encoding: " + path);
+    }
+
+    if (!in) throw std::runtime_error("truncated grid file: " + path);
+    if (grain != nullptr) *grain = fileGrain;
+    return mesh;
+}
+
+size_t MeshIO::writeMRC(const MoleculeMesh &mesh, const std::string &path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("cannot open map file: " + path);
+
+    /* Unpack one x-row at a time into map values */
+    std::vector<int8_t> values(mesh.dim_x);
+    size_t count = 0;
+    std::streampos dataStart = 1024;
+    out.seekp(dataStart);
+    for (int z = 0; z < mesh.dim_z; ++z) {
+        for (int y = 0; y < mesh.dim_y; ++y) {
+            for (int x = 0; x < mesh.dim_x; ++x) {
+                values[x] = mesh.at(x, y, z);
+                count += values[x];
+            }
+            out.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size()));
+        }
+    }
+
+    /* The header comes last, once density statistics are known */
+    size_t total = static_cast<size_t>(mesh.dim_x) * mesh.dim_y * mesh.dim_z;
+    float mean = total > 0 ? static_cast<float>(count) / static_cast<float>(total) : 0;
+    out.seekp(0);
+    putMRCHeader(out, mesh, 0, 0, count > 0 ? 1 : 0, mean, {"ProLIF_Coloring discrete mesh"});
+
+    if (!out) throw std::runtime_error("cannot write map file: " + path);
+    out.seekp(0, std::ios::end);
+    return static_cast<size_t>(out.tellp());
+}
+
+size_t MeshIO::writeMRC(const std::vector<std::pair<std::string, const MoleculeMesh *>> &channels,
+                        const std::string &path) {
+    if (channels.empty() || channels.size() > 16)
+        throw std::runtime_error("multi-channel map needs 1 to 16 channels: " + path);
+
+    const MoleculeMesh &reference = *channels.front().second;
+    for (const auto &channel: channels)
+        if (channel.second->dim_x != reference.dim_x || channel.second->dim_y != reference.dim_y ||
+            channel.second->dim_z != reference.dim_z ||
+            channel.second->internalDisplacement != reference.internalDisplacement)
+            throw std::runtime_error("multi-channel map needs meshes of the same space: " + path);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("cannot open map file: " + path);
+
+    /* Merge the channels one x-row at a time into bitmask values */
+    std::vector<int16_t> values(reference.dim_x);
+    int16_t maxValue = 0;
+    double sum = 0;
+    out.seekp(1024);
+    for (int z = 0; z < reference.dim_z; ++z) {
+        for (int y = 0; y < reference.dim_y; ++y) {
+            std::fill(values.begin(), values.end(), 0);
+            for (size_t c = 0; c < channels.size(); ++c) {
+                const MoleculeMesh &mesh = *channels[c].second;
+                for (int x = 0; x < reference.dim_x; ++x)
+                    if (mesh.at(x, y, z)) values[x] = static_cast<int16_t>(values[x] | (1 << c));
+            }
+            for (int16_t value: values) {
+                if (value > maxValue) maxValue = value;
+                sum += value;
+            }
+            out.write(reinterpret_cast<const char *>(values.data()),
+                      static_cast<std::streamsize>(values.size() * sizeof(int16_t)));
+        }
+    }
+
+    /* Channel names are stored as labels: "channel <bit> <name>" */
+    std::vector<std::string> labels = {"ProLIF_Coloring multi-channel mesh (voxel = channel bitmask)"};
+    for (size_t c = 0; c < channels.size(); ++c)
+        labels.push_back("channel " + std::to_string(c) + " " + channels[c].first);
+
+    size_t total = static_cast<size_t>(reference.dim_x) * reference.dim_y * reference.dim_z;
+    out.seekp(0);
+    putMRCHeader(out, reference, 1, 0, maxValue,
+                 total > 0 ? static_cast<float>(sum / static_cast<double>(total)) : 0, labels);
+
+    if (!out) throw std::runtime_error("cannot write map file: " + path);
+    out.seekp(0, std::ios::end);
+    return static_cast<size_t>(out.tellp());
+}
+
+size_t MeshIO::writeMRC(const LabelMesh &mesh, const std::vector<std::string> &names, const std::string &path) {
+    if (names.size() > LabelMesh::maxChannels)
+        throw std::runtime_error("multi-channel map needs 1 to 16 channels: " + path);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("cannot open map file: " + path);
+
+    /* Labels are already channel bitmasks, write them one x-row at a time */
+    std::vector<int16_t> values(mesh.dim_x);
+    int16_t maxValue = 0;
+    double sum = 0;
+    out.seekp(1024);
+    const LabelMesh::label_t *labels = mesh.getData();
+    for (size_t r = 0; r < static_cast<size_t>(mesh.dim_y) * mesh.dim_z; ++r) {
+        for (int x = 0; x < mesh.dim_x; ++x) {
+            values[x] = static_cast<int16_t>(labels[r * mesh.dim_x + x]);
+            if (values[x] > maxValue) maxValue = values[x];
+            sum += values[x];
+        }
+        out.write(reinterpret_cast<const char *>(values.data()),
+                  static_cast<std::streamsize>(values.size() * sizeof(int16_t)));
+    }
+
+    /* Channel names are stored as labels: "channel <bit> <name>" */
+    std::vector<std::string> mapLabels = {"ProLIF_Coloring multi-channel mesh (voxel = channel bitmask)"};
+    for (size_t c = 0; c < names.size(); ++c)
+        mapLabels.push_back("channel " + std::to_string(c) + " " + names[c]);
+
+    size_t total = static_cast<size_t>(mesh.dim_x) * mesh.dim_y * mesh.dim_z;
+    out.seekp(0);
+    putMRCHeader(out, mesh, 1, 0, maxValue,
+                 total > 0 ? static_cast<float>(sum / static_cast<double>(total)) : 0, mapLabels);
+
+    if (!out) throw std::runtime_error("cannot write map file: " + path);
+    out.seekp(0, std::ios::end);
+    return static_cast<size_t>(out.tellp());
+}
+
+size_t MeshIO::writeDX(const MoleculeMesh &mesh, const std::string &path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("cannot open dx file: " + path);
+
+    RDGeom::Point3D origin = meshOrigin(mesh);
+    double delta = 1.0 / mesh.grain;
+    size_t total = static_cast<size_t>(mesh.dim_x) * mesh.dim_y * mesh.dim_z;
+
+    out << std::setprecision(8);
+    out << "# ProLIF_Coloring discrete mesh\n";
+    out << "object 1 class gridpositions counts " << mesh.dim_x << " " << mesh.dim_y << " " << mesh.dim_z << "\n";
+    out << "origin " << origin.x << " " << origin.y << " " << origin.z << "\n";
+    out << "delta " << delta << " 0 0\n";
+    out << "delta 0 " << delta << " 0\n";
+    out << "delta 0 0 " << delta << "\n";
+    out << "object 2 class gridconnections counts " << mesh.dim_x << " " << mesh.dim_y << " " << mesh.dim_z << "\n";
+    out << "object 3 class array type double rank 0 items " << total << " data follows\n";
+
+    /* OpenDX data are ordered with z varying fastest, three values per line */
+    std::string line;
+    size_t written = 0;
+    for (int x = 0; x < mesh.dim_x; ++x) {
+        for (int y = 0; y < mesh.dim_y; ++y) {
+            for (int z = 0; z < mesh.dim_z; ++z) {
+                line += mesh.at(x, y, z) ? '1' : '0';
+                line += (++written % 3 == 0) ? '\n' : ' ';
+            }
+            out << line;
+            line.clear();
+        }
+    }
+    if (written % 3 != 0) out << "\n";
+
+    out << "attribute \"dep\" string \"positions\"\n";
+    out << "object \"discrete mesh\" class field\n";
+    out << "component \"positions\" value 1\n";
+    out << "component \"connections\" value 2\n";
+    out << "component \"data\" value 3\n";
+
+    if (!out) throw std::runtime_error("cannot write dx file: " + path);
+    return static_cast<size_t>(out.tellp());
+}
+
+size_t MeshIO::writeMRC(const OccupancyMap &map, size_t frames, const std::string &path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("cannot open map file: " + path);
+
+    /* Normalize the counts one x-row at a time into frame fractions */
+    const OccupancyBox box(map);
+    const float scale = frames > 0 ? 1.0f / static_cast<float>(frames) : 0;
+    std::vector<float> values(box.dim_x);
+    float maxValue = 0;
+    double sum = 0;
+    out.seekp(1024);
+    const OccupancyMap::count_t *counts = map.getData();
+    for (size_t r = 0; r < static_cast<size_t>(box.dim_y) * box.dim_z; ++r) {
+        for (int x = 0; x < box.dim_x; ++x) {
+            values[x] = static_cast<float>(counts[r * box.dim_x + x]) * scale;
+            if (values[x] > maxValue) maxValue = values[x];
+            sum += values[x];
+        }
+        out.write(reinterpret_cast<const char *>(values.data()),
+                  static_cast<std::streamsize>(values.size() * sizeof(float)));
+    }
+
+    std::vector<std::string> labels = {"ProLIF_Coloring occupancy map (voxel = fraction of frames)",
+                                       "frames " + std::to_string(frames)};
+    size_t total = static_cast<size_t>(box.dim_x) * box.dim_y * box.dim_z;
+    out.seekp(0);
+    putMRCHeader(out, box, 2, 0, maxValue, total > 0 ? static_cast<float>(sum / static_cast<double>(total)) : 0,
+                 labels);
+
+    if (!out) throw std::runtime_error("cannot write map file: " + path);
+    out.seekp(0, std::ios::end);
+    return static_cast<size_t>(out.tellp());
+}
+
+size_t MeshIO::writeDX(const OccupancyMap &map, size_t frames, const std::string &path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("cannot open dx file: " + path);
+
+    const OccupancyBox box(map);
+    RDGeom::Point3D origin = box.globalDisplacement;
+    double delta = 1.0 / box.grain;
+    double scale = frames > 0 ? 1.0 / static_cast<double>(frames) : 0;
+    size_t total = static_cast<size_t>(box.dim_x) * box.dim_y * box.dim_z;
+
+    out << std::setprecision(8);
+    out << "# ProLIF_Coloring occupancy map (" << frames << " frames)\n";
+    out << "object 1 class gridpositions counts " << box.dim_x << " " << box.dim_y << " " << box.dim_z << "\n";
+    out << "origin " << origin.x << " " << origin.y << " " << origin.z << "\n";
+    out << "delta " << delta << " 0 0\n";
+    out << "delta 0 " << delta << " 0\n";
+    out << "delta 0 0 " << delta << "\n";
+    out << "object 2 class gridconnections counts " << box.dim_x << " " << box.dim_y << " " << box.dim_z << "\n";
+    out << "object 3 class array type double rank 0 items " << total << " data follows\n";
+
+    /* OpenDX data are ordered with z varying fastest, three values per line */
+    size_t written = 0;
+    for (int x = 0; x < box.dim_x; ++x) {
+        for (int y = 0; y < box.dim_y; ++y) {
+            for (int z = 0; z < box.dim_z; ++z) {
+                out << static_cast<double>(map.at(x, y, z)) * scale;
+                out << ((++written % 3 == 0) ? '\n' : ' ');
+            }
+        }
+    }
+    if (written % 3 != 0) out << "\n";
+
+    out << "attribute \"dep\" string \"positions\"\n";
+    out << "object \"occupancy map\" class field\n";
+    out << "component \"positions\" value 1\n";
+    out << "component \"connections\" value 2\n";
+    out << "component \"data\" value 3\n";
+
+    if (!out) throw std::runtime_error("cannot write dx file: " + path);
+    return static_cast<size_t>(out.tellp());
+}
@@ -0,0 +1,189 @@
+#include "Metrics.hpp"
+#include <cstdio>
+
+std::atomic<bool> Metrics::enabled{false};
+
+/**
+ * This function returns the seconds elapsed from a timestamp
+ */
+static double secondsSince(const timespec &startTime) {
+    timespec endTime;
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    auto elapsed = static_cast<double>((endTime.tv_sec - startTime.tv_sec));
+    elapsed += static_cast<double>((endTime.tv_nsec - startTime.tv_nsec)) / 1000000000.0;
+    return elapsed;
+}
+
+Metrics &Metrics::local() {
+    thread_local Metrics threadMetrics;
+    return threadMetrics;
+}
+
+void Metrics::clear() {
+    *this = Metrics();
+}
+
+void Metrics::merge(const Metrics &other) {
+    for (int i = 0; i < N_STAGES; ++i) {
+        seconds[i] += other.seconds[i];
+        calls[i] += other.calls[i];
+    }
+    for (int i = 0; i < N_COUNTERS; ++i) {
+        if (i == PEAK_MESH_BYTES) {
+            if (other.counters[i] > counters[i]) counters[i] = other.counters[i];
+        } else {
+            counters[i] += other.counters[i];
+        }
+    }
+
+    for (const InteractionEntry &entry: other.interactions) {
+        auto it = interactions.begin();
+        while (it != interactions.end() && it->name != entry.name) ++it;
+        if (it == interactions.end()) {
+            interactions.push_back(entry);
+            continue;
+        }
+        it->seconds += entry.seconds;
+        it->matches += entry.matches;
+        it->voxelsStamped += entry.voxelsStamped;
+        it->voxelsSubtracted += entry.voxelsSubtracted;
+    }
+}
+
+double Metrics::getTotalSeconds() const {
+    double total = 0;
+    for (double stageSeconds: seconds)
+        total += stageSeconds;
+    return total;
+}
+
+void Metrics::writeJSON(std::ostream &out, int indent) const {
+    const std::string pad(indent, ' '), inner(indent + 2, ' '), closing(indent > 2 ? indent - 2 : 0, ' ');
+
+    out << "{\n" << pad << "\"total_seconds\": " << getTotalSeconds() << ",\n";
+
+    out << pad << "\"stages\": {";
+    for (int i = 0; i < N_STAGES; ++i) {
+        out << (i ? ",\n" : "\n") << inner << "\"" << name(static_cast<Stage>(i)) << "\": {\"seconds\": "
+            << seconds[i] << ", \"calls\": " << calls[i] << "}";
+    }
+    out << "\n" << pad << "},\n";
+
+    out << pad << "\"counters\": {";
+    for (int i = 0; i < N_COUNTERS; ++i)
+        out << (i ? ",\n" : "\n") << inner << "\"" << name(static_cast<Counter>(i)) << "\": " << counters[i];
+    out << "\n" << pad << "},\n";
+
+    out << pad << "\"interactions\": [";
+    for (size_t i = 0; i < interactions.size(); ++i) {
+        const InteractionEntry &entry = interactions[i];
+        out << (i ? ",\n" : "\n") << inner << "{\"name\": ";
+        writeJSONString(out, entry.name);
+        out << ", \"seconds\": " << entry.seconds << ", \"matches\": " << entry.matches
+            << ", \"voxels_stamped\": " << entry.voxelsStamped
+            << ", \"voxels_subtracted\": " << entry.voxelsSubtracted << "}";
+    }
+    out << (interactions.empty() ? "" : "\n" + pad) << "]\n" << closing << "}";
+}
+
+const char *Metrics::name(Stage stage) {
+    switch (stage) {
+        case DISCRETIZE:
+            return "discretize";
+        case MATCH:
+            return "match";
+        case STENCIL:
+            return "stencil";
+        case STAMP:
+            return "stamp";
+        case SUBTRACT:
+            return "subtract";
+        case SINTETIZE:
+            return "sintetize";
+        case WRITE:
+            return "write";
+        case N_STAGES:
+            break;
+    }
+    return "unknown";
+}
+
+const char *Metrics::name(Counter counter) {
+    switch (counter) {
+        case MATCHES:
+            return "matches";
+        case STENCILS_BUILT:
+            return "stencils_built";
+        case VOXELS_STAMPED:
+            return "voxels_stamped";
+        case VOXELS_SUBTRACTED:
+            return "voxels_subtracted";
+        case BYTES_WRITTEN:
+            return "bytes_written";
+        case PEAK_MESH_BYTES:
+            return "peak_mesh_bytes";
+        case N_COUNTERS:
+            break;
+    }
+    return "unknown";
+}
+
+void Metrics::writeJSONString(std::ostream &out, const std::string &value) {
+    out << '"';
+    for (char c: value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+Metrics::Timer::Timer(Stage stage) : metrics(nullptr), stage(stage), startTime(), outerNestedSeconds(0) {
+    if (!isEnabled()) return;
+    metrics = &local();
+
+    /* The nested time of the enclosing timer is set aside, this timer collects its own */
+    outerNestedSeconds = metrics->nestedSeconds;
+    metrics->nestedSeconds = 0;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+Metrics::Timer::~Timer() {
+    if (!metrics) return;
+    double elapsed = secondsSince(startTime);
+
+    metrics->seconds[stage] += elapsed - metrics->nestedSeconds;
+    metrics->calls[stage]++;
+
+    /* The whole lifetime of this timer is nested time of the enclosing one */
+    metrics->nestedSeconds = outerNestedSeconds + elapsed;
+}
+
+Metrics::InteractionScope::InteractionScope(const std::string &name) :
+        metrics(nullptr), name(name), startTime(), startMatches(0), startStamped(0), startSubtracted(0) {
+    if (!isEnabled()) return;
+    metrics = &local();
+
+    startMatches = metrics->counters[MATCHES];
+    startStamped = metrics->counters[VOXELS_STAMPED];
+    startSubtracted = metrics->counters[VOXELS_SUBTRACTED];
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+Metrics::InteractionScope::~InteractionScope() {
+    if (!metrics) return;
+
+    InteractionEntry entry;
+    entry.name = name;
+    entry.seconds = secondsSince(startTime);
+    entry.matches = metrics->counters[MATCHES] - startMatches;
+    entry.voxelsStamped = metrics->counters[VOXELS_STAMPED] - startStamped;
+    entry.voxelsSubtracted = metrics->counters[VOXELS_SUBTRACTED] - startSubtracted;
+    metrics->interactions.push_back(std::move(entry));
+}
@@ -0,0 +1,73 @@
+#include "MoleculeReader.hpp"
+#include <filesystem>
+#include <stdexcept>
+#include "GraphMol/FileParsers/FileParsers.h"
+
+MoleculeReader::MoleculeReader(const std::string &path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    sdf = extension == ".sdf" || extension == ".mol" || extension == ".SDF" || extension == ".MOL";
+
+    /* Both formats fail the same way on a missing (or unreadable) file */
+    if (sdf) {
+        if (!std::ifstream(path).is_open()) throw std::runtime_error("unable to open " + path);
+        try {
+            sdfSupplier = std::make_unique<RDKit::SDMolSupplier>(path, true, false);
+        } catch (const std::exception &) {
+            throw std::runtime_error("unable to open " + path);
+        }
+    } else {
+        pdbStream.open(path);
+        if (!pdbStream.is_open()) throw std::runtime_error("unable to open " + path);
+    }
+}
+
+bool MoleculeReader::nextPDBBlock(std::string &block) {
+    block.clear();
+    bool hasAtoms = false;
+    std::string line;
+
+    while (std::getline(pdbStream, line)) {
+        std::string record = line.substr(0, 6);
+        record.erase(record.find_last_not_of(' ') + 1);
+
+        /* A model (or the whole file) ends at ENDMDL/END */
+        if (record == "ENDMDL" || record == "END") {
+            if (hasAtoms) return true;
+            block.clear();
+            continue;
+        }
+
+        if (record == "ATOM" || record == "HETATM") hasAtoms = true;
+        block += line;
+        block += '\n';
+    }
+
+    return hasAtoms;
+}
+
+bool MoleculeReader::next(std::unique_ptr<RDKit::ROMol> &molecule) {
+    molecule.reset();
+
+    if (sdf) {
+        if (sdfSupplier->atEnd()) return false;
+        try {
+            molecule.reset(sdfSupplier->next());
+        } catch (const std::exception &) {
+            molecule.reset();
+        }
+    } else {
+        std::string block;
+        if (!nextPDBBlock(block)) return false;
+        try {
+            molecule.reset(RDKit::PDBBlockToMol(block, true, false));
+        } catch (const std::exception &) {
+            molecule.reset();
+        }
+    }
+
+    /* Molecules without coordinates cannot be discretized */
+    if (molecule && molecule->getNumConformers() == 0) molecule.reset();
+
+    records++;
+    return true;
+}
@@ -0,0 +1,181 @@
+#include "Morphology.hpp"
+#include "Backend.hpp"
+#include "DistanceTransform.hpp"
+#include <algorithm>
+#include <cmath>
+
+void Morphology::transform(MoleculeMesh &mesh, double scaledRadius, bool erode) {
+    // Only the voxel itself lies within a radius shorter than a voxel, the mesh is left as it is
+    if (scaledRadius < 1 || mesh.getDataSize() == 0) return;
+
+    /*
+     * The widened rows cost a pass over the packed words per run, and per level twice the number of doublings of the
+     * run length, the distance transform about as much as a dozen of such passes per voxel
+     */
+    std::vector<Run> runs;
+    std::vector<int> widths;
+    sphereRuns(scaledRadius, runs, widths);
+    size_t passes = runs.size() + 2 * widths.size() * static_cast<size_t>(std::ilogb(widths.back() + 1) + 1);
+    bool combine = passes * mesh.words_x <= transformCost * static_cast<size_t>(mesh.dim_x);
+
+    // The work is estimated as the rows of the mesh
+    switch (Backend::resolve(static_cast<size_t>(mesh.dim_y) * mesh.dim_z)) {
+#ifdef USEOMP
+        case Backend::OMP:
+            if (combine) combineOmp(mesh, runs, widths, erode);
+            else transformOmp(mesh, scaledRadius, erode);
+            break;
+#endif
+        default:
+            if (combine) combineSerial(mesh, runs, widths, erode);
+            else transformSerial(mesh, scaledRadius, erode);
+            break;
+    }
+}
+
+void Morphology::dilate(MoleculeMesh &mesh, double radius) {
+    transform(mesh, radius * mesh.grain, false);
+}
+
+void Morphology::erode(MoleculeMesh &mesh, double radius) {
+    transform(mesh, radius * mesh.grain, true);
+}
+
+void Morphology::open(MoleculeMesh &mesh, double radius) {
+    transform(mesh, radius * mesh.grain, true);
+    transform(mesh, radius * mesh.grain, false);
+}
+
+void Morphology::close(MoleculeMesh &mesh, double radius) {
+    transform(mesh, radius * mesh.grain, false);
+    transform(mesh, radius * mesh.grain, true);
+}
+
+void Morphology::sphereRuns(double scaledRadius, std::vector<Run> &runs, std::vector<int> &widths) {
+    const double ds = scaledRadius * scaledRadius;
+    const int reach = static_cast<int>(floor(scaledRadius));
+
+    // The half length of the run at (dy, dz) is the largest dx having dx^2 + dy^2 + dz^2 <= radius^2
+    std::vector<int> halfLengths;
+    for (int dz = -reach; dz <= reach; ++dz) {
+        for (int dy = -reach; dy <= reach; ++dy) {
+            double rest = ds - dy * dy - dz * dz;
+            if (rest < 0) continue;
+            int width = static_cast<int>(floor(sqrt(rest)));
+            while (static_cast<double>(width + 1) * (width + 1) <= rest) ++width;
+            while (static_cast<double>(width) * width > rest) --width;
+            runs.push_back({dy, dz, 0});
+            halfLengths.push_back(width);
+        }
+    }
+
+    widths = halfLengths;
+    std::sort(widths.begin(), widths.end());
+    widths.erase(std::unique(widths.begin(), widths.end()), widths.end());
+    for (size_t i = 0; i < runs.size(); ++i)
+        runs[i].level = static_cast<int>(std::lower_bound(widths.begin(), widths.end(), halfLengths[i]) -
+                                          widths.begin());
+}
+
+void Morphology::widenRow(const MoleculeMesh::data_t *row, MoleculeMesh::data_t *out, int words_x, int width,
+                          bool erode) {
+    std::copy(row, row + words_x, out);
+
+    /*
+     * Each voxel is combined with the one at distance s past it (then before it), doubling the covered distance at
+     * every step: words are updated in the order that reads the neighbouring word before it is updated
+     */
+    for (int covered = 0, s; covered < width; covered += s) {
+        s = std::min(covered + 1, width - covered);
+        for (int w = 0; w < words_x; ++w) {
+            MoleculeMesh::data_t next = MoleculeMesh::fetchWord(out, w * MoleculeMesh::wordBits + s, words_x);
+            out[w] = erode ? out[w] & next : out[w] | next;
+        }
+    }
+    for (int covered = 0, s; covered < width; covered += s) {
+        s = std::min(covered + 1, width - covered);
+        for (int w = words_x - 1; w >= 0; --w) {
+            MoleculeMesh::data_t previous = MoleculeMesh::fetchWord(out, w * MoleculeMesh::wordBits - s, words_x);
+            out[w] = erode ? out[w] & previous : out[w] | previous;
+        }
+    }
+}
+
+void Morphology::combineRow(const MoleculeMesh::data_t *widened, MoleculeMesh &mesh, const std::vector<Run> &runs,
+                            int y, int z, bool erode) {
+    const int words_x = mesh.words_x;
+    const size_t block = mesh.getDataSize();
+    MoleculeMesh::data_t *out = MoleculeMesh::row(mesh.getData(), y, z, words_x, mesh.dim_y);
+
+    if (erode) {
+        std::fill(out, out + words_x, ~MoleculeMesh::data_t(0));
+        for (const Run &run: runs) {
+            int sy = y + run.dy, sz = z + run.dz;
+            if (sy < 0 || sy >= mesh.dim_y || sz < 0 || sz >= mesh.dim_z) {
+                // A row out of the mesh is empty, so is the eroded one
+                std::fill(out, out + words_x, 0);
+                return;
+            }
+            const MoleculeMesh::data_t *source = MoleculeMesh::row(widened + run.level * block, sy, sz, words_x,
+                                                                   mesh.dim_y);
+            for (int w = 0; w < words_x; ++w)
+                out[w] &= source[w];
+        }
+    } else {
+        std::fill(out, out + words_x, 0);
+        for (const Run &run: runs) {
+            int sy = y + run.dy, sz = z + run.dz;
+            if (sy < 0 || sy >= mesh.dim_y || sz < 0 || sz >= mesh.dim_z) continue;
+            const MoleculeMesh::data_t *source = MoleculeMesh::row(widened + run.level * block, sy, sz, words_x,
+                                                                   mesh.dim_y);
+            for (int w = 0; w < words_x; ++w)
+                out[w] |= source[w];
+        }
+    }
+
+    // The padding bits past the row stay empty
+    out[words_x - 1] &= MoleculeMesh::rangeMask(words_x - 1, 0, mesh.dim_x);
+}
+
+bool Morphology::seedRow(const MoleculeMesh::data_t *row, int dim_x, bool erode, double ds, int32_t *f) {
+    /*
+     * Every voxel takes the distance from the nearer of the seeds around it, the seed on the left of the row is the
+     * voxel out of it for an erosion (none for a dilation), the same for the one on the right
+     */
+    const int64_t none = int64_t(1) << 40;
+    int64_t previous = erode ? -1 : -none;
+    int x = 0;
+    auto fill = [&](int end, int64_t next) {
+        for (; x < end; ++x) {
+            auto d = static_cast<double>(std::min(x - previous, next - x));
+            f[x] = d * d <= ds ? static_cast<int32_t>(d * d) : DistanceTransform::infinity;
+        }
+    };
+
+    // Walk the seeds a word at a time (the empty words of a dilation and the full ones of an erosion are skipped)
+    const MoleculeMesh::data_t flip = erode ? ~MoleculeMesh::data_t(0) : 0;
+    bool seeded = erode;
+    for (int w = 0; w < MoleculeMesh::rowWords(dim_x); ++w) {
+        for (MoleculeMesh::data_t word = (row[w] ^ flip) & MoleculeMesh::rangeMask(w, 0, dim_x); word;
+             word &= word - 1) {
+            int seed = w * MoleculeMesh::wordBits + __builtin_ctzll(word);
+            fill(seed, seed);
+            f[x++] = 0;
+            previous = seed;
+            seeded = true;
+        }
+    }
+    fill(dim_x, erode ? dim_x : none);
+    return seeded;
+}
+
+void Morphology::writeRow(const int32_t *f, MoleculeMesh::data_t *row, int dim_x, bool erode, double ds) {
+    // Pack the voxels within the radius one word at a time, the erosion keeps the others (in the row only)
+    for (int w = 0; w < MoleculeMesh::rowWords(dim_x); ++w) {
+        int x = w * MoleculeMesh::wordBits, wordEnd = std::min(dim_x, x + MoleculeMesh::wordBits);
+        MoleculeMesh::data_t word = 0;
+        for (; x < wordEnd; ++x)
+            word |= static_cast<MoleculeMesh::data_t>(f[x] <= ds) << (x % MoleculeMesh::wordBits);
+        row[w] = erode ? ~word & MoleculeMesh::rangeMask(w, 0, dim_x) : word;
+    }
+}
@@ -0,0 +1,128 @@
+#include "OccupancyMap.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+void OccupancyMap::fit(int begin_x, int begin_y, int begin_z, int size_x, int size_y, int size_z) {
+    if (size_x <= 0 || size_y <= 0 || size_z <= 0) return;
+
+    if (counts.empty()) {
+        origin_x = begin_x;
+        origin_y = begin_y;
+        origin_z = begin_z;
+        dim_x = size_x;
+        dim_y = size_y;
+        dim_z = size_z;
+        counts.assign(static_cast<size_t>(dim_x) * dim_y * dim_z, 0);
+        return;
+    }
+
+    /* The union of the two boxes */
+    int new_x = std::min(origin_x, begin_x), new_y = std::min(origin_y, begin_y), new_z = std::min(origin_z, begin_z);
+    int new_dim_x = std::max(origin_x + dim_x, begin_x + size_x) - new_x;
+    int new_dim_y = std::max(origin_y + dim_y, begin_y + size_y) - new_y;
+    int new_dim_z = std::max(origin_z + dim_z, begin_z + size_z) - new_z;
+    if (new_dim_x == dim_x && new_dim_y == dim_y && new_dim_z == dim_z) return;
+
+    /* Move the counts into the grown map one x-row at a time */
+    std::vector<count_t> grown(static_cast<size_t>(new_dim_x) * new_dim_y * new_dim_z, 0);
+    const int shift_x = origin_x - new_x, shift_y = origin_y - new_y, shift_z = origin_z - new_z;
+    for (int z = 0; z < dim_z; ++z) {
+        for (int y = 0; y < dim_y; ++y) {
+            const count_t *source = row(y, z);
+            size_t target = static_cast<size_t>(new_dim_x) *
+                            (static_cast<size_t>(z + shift_z) * new_dim_y + (y + shift_y)) + shift_x;
+            std::copy(source, source + dim_x, grown.begin() + static_cast<std::ptrdiff_t>(target));
+        }
+    }
+
+    counts.swap(grown);
+    origin_x = new_x;
+    origin_y = new_y;
+    origin_z = new_z;
+    dim_x = new_dim_x;
+    dim_y = new_dim_y;
+    dim_z = new_dim_z;
+}
+
+template<typename Mesh>
+void OccupancyMap::fit(const Mesh &mesh, int &offset_x, int &offset_y, int &offset_z) {
+    if (mesh.grain != grain)
+        throw std::runtime_error("occupancy map needs meshes of grain " + std::to_string(grain));
+
+    int begin_x = latticeOrigin(mesh.globalDisplacement.x, mesh.internalDisplacement, grain);
+    int begin_y = latticeOrigin(mesh.globalDisplacement.y, mesh.internalDisplacement, grain);
+    int begin_z = latticeOrigin(mesh.globalDisplacement.z, mesh.internalDisplacement, grain);
+    fit(begin_x, begin_y, begin_z, mesh.dim_x, mesh.dim_y, mesh.dim_z);
+
+    offset_x = begin_x - origin_x;
+    offset_y = begin_y - origin_y;
+    offset_z = begin_z - origin_z;
+}
+
+void OccupancyMap::add(const MoleculeMesh &mesh) {
+    int offset_x, offset_y, offset_z;
+    fit(mesh, offset_x, offset_y, offset_z);
+
+    /* Visit only the set voxels of the packed x-rows */
+    for (int z = 0; z < mesh.dim_z; ++z) {
+        for (int y = 0; y < mesh.dim_y; ++y) {
+            const MoleculeMesh::data_t *meshRow = MoleculeMesh::row(mesh.getData(), y, z, mesh.words_x, mesh.dim_y);
+            count_t *countRow = row(y + offset_y, z + offset_z) + offset_x;
+            for (int w = 0; w < mesh.words_x; ++w) {
+                MoleculeMesh::data_t word = meshRow[w];
+                while (word) {
+                    countRow[w * MoleculeMesh::wordBits + __builtin_ctzll(word)]++;
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+}
+
+void OccupancyMap::add(const SparseMesh &mesh) {
+    int offset_x, offset_y, offset_z;
+    fit(mesh, offset_x, offset_y, offset_z);
+
+    mesh.forEachVoxel([&](int x, int y, int z) {
+        row(y + offset_y, z + offset_z)[x + offset_x]++;
+    });
+}
+
+void OccupancyMap::add(const LabelMesh &mesh, int channel) {
+    const auto bit = static_cast<LabelMesh::label_t>(1u << channel);
+    if (!(mesh.getChannels() & bit)) return;
+
+    int offset_x, offset_y, offset_z;
+    fit(mesh, offset_x, offset_y, offset_z);
+
+    const LabelMesh::label_t *labels = mesh.getData();
+    for (int z = 0; z < mesh.dim_z; ++z) {
+        for (int y = 0; y < mesh.dim_y; ++y) {
+            const LabelMesh::label_t *labelRow = &labels[static_cast<size_t>(mesh.dim_x) *
+                                                         (static_cast<size_t>(z) * mesh.dim_y + y)];
+            count_t *countRow = row(y + offset_y, z + offset_z) + offset_x;
+            for (int x = 0; x < mesh.dim_x; ++x)
+                countRow[x] += (labelRow[x] & bit) != 0;
+        }
+    }
+}
+
+void OccupancyMap::merge(const OccupancyMap &other) {
+    if (other.grain != grain)
+        throw std::runtime_error("occupancy map needs maps of grain " + std::to_string(grain));
+    if (other.empty()) return;
+
+    fit(other.origin_x, other.origin_y, other.origin_z, other.dim_x, other.dim_y, other.dim_z);
+    const int offset_x = other.origin_x - origin_x, offset_y = other.origin_y - origin_y,
+            offset_z = other.origin_z - origin_z;
+    for (int z = 0; z < other.dim_z; ++z) {
+        for (int y = 0; y < other.dim_y; ++y) {
+            const count_t *source = &other.counts[static_cast<size_t>(other.dim_x) *
+                                                  (static_cast<size_t>(z) * other.dim_y + y)];
+            count_t *target = row(y + offset_y, z + offset_z) + offset_x;
+            for (int x = 0; x < other.dim_x; ++x)
+                target[x] += source[x];
+        }
+    }
+}
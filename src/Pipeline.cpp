@@ -0,0 +1,738 @@
+#include "Pipeline.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include "GraphMol/FileParsers/FileParsers.h"
+#include "Transformer.hpp"
+#include "Backend.hpp"
+#include "BoundedQueue.hpp"
+#include "MeshIO.hpp"
+#include "Morphology.hpp"
+#include "ScratchArena.hpp"
+#include "TrajectoryMesh.hpp"
+
+double Pipeline::elapsedTime(const timespec &startTime, const timespec &endTime) {
+    auto elapsed = static_cast<double>((endTime.tv_sec - startTime.tv_sec));
+    elapsed += static_cast<double>((endTime.tv_nsec - startTime.tv_nsec)) / 1000000000.0;
+    return elapsed;
+}
+
+int Pipeline::maskPadding(const Options &options) {
+    if (options.mask == VDW) return meshPadding;
+    return std::max(meshPadding, static_cast<int>(ceil(Transformer::getAtomRadius() + options.probeRadius)) + 1);
+}
+
+void Pipeline::applyMask(MoleculeMesh &mesh, const Options &options) {
+    if (options.mask == VDW) return;
+
+    Metrics::Timer timer(Metrics::DISCRETIZE);
+    if (options.mask == SAS) Morphology::dilate(mesh, options.probeRadius);
+    else Morphology::close(mesh, options.probeRadius);
+}
+
+std::unique_ptr<Pipeline::Result> Pipeline::compute(const RDKit::ROMol &molecule,
+                                                    const InteractionCollection::list_t &interactions,
+                                                    const Options &options, bool verbose, int confId) {
+    timespec startTime, endTime;
+    auto result = std::make_unique<Result>();
+    result->confId = confId;
+
+    /* Temporaries (and metrics) of the previous molecule (or conformer) are released at once */
+    ScratchArena::local().reset();
+    Metrics &metrics = Metrics::local();
+    metrics.clear();
+
+    /* Atom coordinates are extracted once, for the discretization and all the interactions */
+    MoleculeContext context(molecule, confId, ScratchArena::resource());
+
+    if (verbose) std::cout << "Discretizing molecule" << std::endl;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    result->moleculeMesh = Transformer::discretize(context, maskPadding(options), options.grain);
+    applyMask(*result->moleculeMesh, options);
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+    if (verbose) std::cout << "\t-> elapsed time : " << elapsedTime(startTime, endTime) << std::endl;
+
+    const MoleculeMesh &moleculeMesh = *result->moleculeMesh;
+
+    if (options.labeled) {
+        computeLabeled(context, interactions, *result, verbose);
+        result->metrics = metrics;
+        return result;
+    }
+
+    /* Memory held by the meshes of the molecule, the support-mesh of the running interaction aside */
+    size_t meshBytes = moleculeMesh.getMemoryUsage();
+
+    /* Iterate over interaction list */
+    for (const std::pair<std::string, std::unique_ptr<Interaction>> &interaction: interactions) {
+        Interaction *inter = interaction.second.get();
+        const std::string &desc = interaction.first;
+        Metrics::InteractionScope scope(desc);
+
+        /* Generate a support-mesh for interaction as large as molecule one */
+        auto interactionMesh = std::make_unique<MoleculeMesh>(moleculeMesh.dim_x, moleculeMesh.dim_y,
+                                                              moleculeMesh.dim_z, moleculeMesh.globalDisplacement,
+                                                              moleculeMesh.internalDisplacement, moleculeMesh.grain);
+
+        if (verbose) std::cout << "Calculating interaction: " << desc << std::endl;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        bool succeed = inter->getInteraction(context, *interactionMesh, *result->moleculeMesh);
+        clock_gettime(CLOCK_MONOTONIC, &endTime);
+        Metrics::peak(Metrics::PEAK_MESH_BYTES, meshBytes + interactionMesh->getMemoryUsage());
+
+        /* Keep the interaction mesh only if its generation has succeeded */
+        if (succeed) {
+            if (verbose) std::cout << "\t-> elapsed time : " << elapsedTime(startTime, endTime) << std::endl;
+            if (options.sparse) {
+                result->sparseMeshes.emplace_back(desc, std::make_unique<SparseMesh>(*interactionMesh));
+                meshBytes += result->sparseMeshes.back().second->getMemoryUsage();
+                Metrics::peak(Metrics::PEAK_MESH_BYTES, meshBytes + interactionMesh->getMemoryUsage());
+            } else {
+                meshBytes += interactionMesh->getMemoryUsage();
+                result->interactionMeshes.emplace_back(desc, std::move(interactionMesh));
+            }
+        } else {
+            if (verbose) std::cout << "\t-> no interaction found" << std::endl;
+        }
+    }
+
+    result->metrics = metrics;
+    return result;
+}
+
+std::vector<std::unique_ptr<Pipeline::Result>> Pipeline::computeAll(const RDKit::ROMol &molecule,
+                                                                   const InteractionCollection::list_t &interactions,
+                                                                   const Options &options, bool verbose) {
+    std::vector<std::unique_ptr<Result>> results;
+
+    if (!options.allConformers || molecule.getNumConformers() <= 1) {
+        results.push_back(compute(molecule, interactions, options, verbose));
+        return results;
+    }
+
+    if (options.incremental) return computeIncremental(molecule, interactions, options, verbose);
+
+    for (auto conformer = molecule.beginConformers(); conformer != molecule.endConformers(); ++conformer) {
+        int confId = static_cast<int>((*conformer)->getId());
+        if (verbose) std::cout << "Processing conformer " << confId << std::endl;
+        results.push_back(compute(molecule, interactions, options, verbose, confId));
+    }
+
+    return results;
+}
+
+std::vector<std::unique_ptr<Pipeline::Result>> Pipeline::computeIncremental(
+        const RDKit::ROMol &molecule, const InteractionCollection::list_t &interactions, const Options &options,
+        bool verbose) {
+    if (options.labeled && interactions.size() > LabelMesh::maxChannels)
+        throw std::runtime_error("labeled mesh supports at most 16 interactions");
+
+    std::vector<std::unique_ptr<Result>> results;
+    TrajectoryMesh trajectory(interactions, options.grain, maskPadding(options));
+
+    for (auto conformer = molecule.beginConformers(); conformer != molecule.endConformers(); ++conformer) {
+        timespec startTime, endTime;
+        auto result = std::make_unique<Result>();
+        result->confId = static_cast<int>((*conformer)->getId());
+
+        /* Temporaries (and metrics) of the previous conformer are released at once */
+        ScratchArena::local().reset();
+        Metrics &metrics = Metrics::local();
+        metrics.clear();
+
+        if (verbose) std::cout << "Updating conformer " << result->confId << std::endl;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        MoleculeContext context(molecule, result->confId, ScratchArena::resource());
+        trajectory.update(context);
+        clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+        if (verbose) {
+            if (trajectory.isRebuilt()) std::cout << "\t-> discretized from scratch";
+            else std::cout << "\t-> moved atoms : " << trajectory.getMovedAtoms()
+                           << ", moved matches : " << trajectory.getMovedMatches();
+            std::cout << ", elapsed time : " << elapsedTime(startTime, endTime) << std::endl;
+        }
+
+        /* The meshes of the conformer are copied out of the reference-counted ones, the mask model is applied anew */
+        result->moleculeMesh = std::make_unique<MoleculeMesh>(trajectory.getMoleculeMesh());
+        applyMask(*result->moleculeMesh, options);
+        const MoleculeMesh &moleculeMesh = *result->moleculeMesh;
+
+        if (options.labeled) {
+            result->labelMesh = std::make_unique<LabelMesh>(moleculeMesh.dim_x, moleculeMesh.dim_y,
+                                                            moleculeMesh.dim_z, moleculeMesh.globalDisplacement,
+                                                            moleculeMesh.internalDisplacement, moleculeMesh.grain);
+            for (size_t i = 0; i < interactions.size(); ++i) {
+                result->labelNames.push_back(interactions[i].first);
+                if (trajectory.isFound(i)) result->labelMesh->merge(trajectory.getCoverage(i), static_cast<int>(i));
+            }
+            result->labelMesh->sub(moleculeMesh);
+        } else {
+            for (size_t i = 0; i < interactions.size(); ++i) {
+                if (!trajectory.isFound(i)) continue;
+                auto interactionMesh = std::make_unique<MoleculeMesh>(trajectory.getCoverage(i));
+                interactionMesh->sub(moleculeMesh, 0, 0, 0);
+                if (options.sparse)
+                    result->sparseMeshes.emplace_back(interactions[i].first,
+                                                      std::make_unique<SparseMesh>(*interactionMesh));
+                else
+                    result->interactionMeshes.emplace_back(interactions[i].first, std::move(interactionMesh));
+            }
+        }
+
+        Metrics::peak(Metrics::PEAK_MESH_BYTES, trajectory.getMemoryUsage());
+        result->metrics = metrics;
+        results.push_back(std::move(result));
+    }
+
+    return results;
+}
+
+void Pipeline::computeLabeled(const MoleculeContext &context, const InteractionCollection::list_t &interactions,
+                              Result &result, bool verbose) {
+    if (interactions.size() > LabelMesh::maxChannels)
+        throw std::runtime_error("labeled mesh supports at most 16 interactions");
+
+    timespec startTime, endTime;
+    const MoleculeMesh &moleculeMesh = *result.moleculeMesh;
+    result.labelMesh = std::make_unique<LabelMesh>(moleculeMesh.dim_x, moleculeMesh.dim_y, moleculeMesh.dim_z,
+                                                   moleculeMesh.globalDisplacement,
+                                                   moleculeMesh.internalDisplacement, moleculeMesh.grain);
+
+    /* A single support-mesh is reused by all interactions, the molecule is subtracted once at the end */
+    MoleculeMesh interactionMesh(moleculeMesh.dim_x, moleculeMesh.dim_y, moleculeMesh.dim_z,
+                                 moleculeMesh.globalDisplacement, moleculeMesh.internalDisplacement,
+                                 moleculeMesh.grain);
+    MoleculeMesh noSubtraction(0, 0, 0);
+    Metrics::peak(Metrics::PEAK_MESH_BYTES, moleculeMesh.getMemoryUsage() + result.labelMesh->getMemoryUsage() +
+                                            interactionMesh.getMemoryUsage());
+
+    for (size_t i = 0; i < interactions.size(); ++i) {
+        const std::string &desc = interactions[i].first;
+        result.labelNames.push_back(desc);
+        Metrics::InteractionScope scope(desc);
+
+        if (verbose) std::cout << "Calculating interaction: " << desc << std::endl;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        interactionMesh.clear();
+        bool succeed = interactions[i].second->getInteraction(context, interactionMesh, noSubtraction);
+        if (succeed) result.labelMesh->merge(interactionMesh, static_cast<int>(i));
+        clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+        if (verbose) {
+            if (succeed) std::cout << "\t-> elapsed time : " << elapsedTime(startTime, endTime) << std::endl;
+            else std::cout << "\t-> no interaction found" << std::endl;
+        }
+    }
+
+    result.labelMesh->sub(moleculeMesh);
+}
+
+/**
+ * This function accounts the size of a saved file into the metrics
+ */
+static void countWritten(const std::string &path) {
+    if (!Metrics::isEnabled()) return;
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(path, error);
+    if (!error) Metrics::count(Metrics::BYTES_WRITTEN, size);
+}
+
+/**
+ * This function saves a discrete mesh in the requested output format
+ * @return The path of the saved file
+ */
+static std::string writeMesh(const MoleculeMesh &mesh, const std::string &basePath, Pipeline::OutputFormat format) {
+    Metrics::Timer timer(Metrics::WRITE);
+    std::string path;
+    switch (format) {
+        case Pipeline::GRID:
+            path = basePath + ".grid";
+            MeshIO::writeBinary(mesh, path);
+            break;
+        case Pipeline::MRC:
+        case Pipeline::MRC_CHANNELS:
+            path = basePath + ".mrc";
+            MeshIO::writeMRC(mesh, path);
+            break;
+        case Pipeline::DX:
+            path = basePath + ".dx";
+            MeshIO::writeDX(mesh, path);
+            break;
+        case Pipeline::PDB: {
+            std::unique_ptr<RDKit::RWMol> discrMolecule = Transformer::sintetize(mesh);
+            path = basePath + ".pdb";
+            RDKit::MolToPDBFile(*discrMolecule, path);
+            break;
+        }
+    }
+    countWritten(path);
+    return path;
+}
+
+/**
+ * This function saves a sparse discrete mesh in the requested output format
+ * (only the PDB output visits the set voxels directly, grid formats are written from its dense form)
+ * @return The path of the saved file
+ */
+static std::string writeMesh(const SparseMesh &mesh, const std::string &basePath, Pipeline::OutputFormat format) {
+    Metrics::Timer timer(Metrics::WRITE);
+    if (format != Pipeline::PDB) return writeMesh(mesh.toDense(), basePath, format);
+
+    std::unique_ptr<RDKit::RWMol> discrMolecule = Transformer::sintetize(mesh);
+    std::string path = basePath + ".pdb";
+    RDKit::MolToPDBFile(*discrMolecule, path);
+    countWritten(path);
+    return path;
+}
+
+void Pipeline::write(const Result &result, const std::string &outDir, const Options &options, bool verbose) {
+    OutputFormat format = options.format;
+
+    /* Save discrete molecule from molecule-mesh */
+    if (verbose) std::cout << "\t-> saving discrete molecule file -> ";
+    std::string discrMoleculePath = writeMesh(*result.moleculeMesh, outDir + "Molecule", format);
+    if (verbose) std::cout << discrMoleculePath << std::endl;
+
+    if (result.labelMesh) {
+        writeLabeled(result, outDir, format, verbose);
+        return;
+    }
+
+    if (!result.sparseMeshes.empty()) {
+        writeSparse(result, outDir, format, verbose);
+        return;
+    }
+
+    /* Save all discrete interactions into a single multi-channel map */
+    if (format == MRC_CHANNELS) {
+        if (result.interactionMeshes.empty()) return;
+
+        std::vector<std::pair<std::string, const MoleculeMesh *>> channels;
+        for (const auto &interaction: result.interactionMeshes)
+            channels.emplace_back(interaction.first, interaction.second.get());
+
+        std::string interactionsPath = outDir + "Interactions.mrc";
+        if (verbose) std::cout << "\t-> saving discrete interactions multi-channel file -> ";
+        {
+            Metrics::Timer timer(Metrics::WRITE);
+            MeshIO::writeMRC(channels, interactionsPath);
+        }
+        countWritten(interactionsPath);
+        if (verbose) std::cout << interactionsPath << std::endl;
+        return;
+    }
+
+    /* Save discrete interactions from interaction-meshes */
+    for (const auto &interaction: result.interactionMeshes) {
+        if (verbose) std::cout << "\t-> saving discrete interaction file -> ";
+        std::string interactionPath = writeMesh(*interaction.second, outDir + interaction.first, format);
+        if (verbose) std::cout << interactionPath << std::endl;
+    }
+}
+
+Metrics Pipeline::writeAll(const std::vector<std::unique_ptr<Result>> &results, const std::string &outDir,
+                           const Options &options, bool verbose) {
+    /* The output of the molecule is collected by this thread, its calculation is carried by the results */
+    Metrics &writeMetrics = Metrics::local();
+    writeMetrics.clear();
+
+    for (const std::unique_ptr<Result> &result: results) {
+        std::string resultDir = outDir;
+        if (result->confId >= 0) {
+            resultDir += "conf_" + std::to_string(result->confId) + "/";
+            std::filesystem::create_directories(resultDir);
+        }
+        write(*result, resultDir, options, verbose);
+    }
+
+    Metrics metrics;
+    if (!Metrics::isEnabled()) return metrics;
+
+    for (const std::unique_ptr<Result> &result: results)
+        metrics.merge(result->metrics);
+    metrics.merge(writeMetrics);
+
+    /* Save the instrumentation of the molecule */
+    std::string metricsPath = outDir + "metrics.json";
+    if (verbose) std::cout << "\t-> saving metrics file -> ";
+    std::ofstream out(metricsPath);
+    out << "{\n  \"output\": ";
+    Metrics::writeJSONString(out, outDir);
+    out << ",\n  \"conformers\": " << results.size() << ",\n  \"metrics\": ";
+    metrics.writeJSON(out, 4);
+    out << "\n}\n";
+    if (verbose) std::cout << metricsPath << std::endl;
+
+    return metrics;
+}
+
+void Pipeline::writeMetricsSummary(const Metrics &metrics, size_t processed, size_t failed, double elapsed,
+                                   const std::string &path) {
+    std::ofstream out(path);
+    out << "{\n  \"molecules\": " << processed + failed << ",\n  \"processed\": " << processed
+        << ",\n  \"failed\": " << failed << ",\n  \"wall_seconds\": " << elapsed
+        << ",\n  \"molecules_per_second\": " << (elapsed > 0 ? static_cast<double>(processed) / elapsed : 0)
+        << ",\n  \"metrics\": ";
+    metrics.writeJSON(out, 4);
+    out << "\n}\n";
+}
+
+void Pipeline::writeSparse(const Result &result, const std::string &outDir, OutputFormat format, bool verbose) {
+    /* Save all discrete interactions into a single multi-channel map (the map writer needs dense channels) */
+    if (format == MRC_CHANNELS) {
+        std::vector<MoleculeMesh> denseMeshes;
+        std::vector<std::pair<std::string, const MoleculeMesh *>> channels;
+        denseMeshes.reserve(result.sparseMeshes.size());
+        for (const auto &interaction: result.sparseMeshes) {
+            denseMeshes.push_back(interaction.second->toDense());
+            channels.emplace_back(interaction.first, &denseMeshes.back());
+        }
+
+        std::string interactionsPath = outDir + "Interactions.mrc";
+        if (verbose) std::cout << "\t-> saving discrete interactions multi-channel file -> ";
+        {
+            Metrics::Timer timer(Metrics::WRITE);
+            MeshIO::writeMRC(channels, interactionsPath);
+        }
+        countWritten(interactionsPath);
+        if (verbose) std::cout << interactionsPath << std::endl;
+        return;
+    }
+
+    /* Save discrete interactions from sparse interaction-meshes */
+    for (const auto &interaction: result.sparseMeshes) {
+        if (verbose) std::cout << "\t-> saving discrete interaction file -> ";
+        std::string interactionPath = writeMesh(*interaction.second, outDir + interaction.first, format);
+        if (verbose) std::cout << interactionPath << std::endl;
+    }
+}
+
+void Pipeline::writeLabeled(const Result &result, const std::string &outDir, OutputFormat format, bool verbose) {
+    const LabelMesh &labelMesh = *result.labelMesh;
+    if (labelMesh.getChannels() == 0) return;
+
+    /* Labels are already a multi-channel map */
+    if (format == MRC_CHANNELS) {
+        std::string interactionsPath = outDir + "Interactions.mrc";
+        if (verbose) std::cout << "\t-> saving discrete interactions multi-channel file -> ";
+        {
+            Metrics::Timer timer(Metrics::WRITE);
+            MeshIO::writeMRC(labelMesh, result.labelNames, interactionsPath);
+        }
+        countWritten(interactionsPath);
+        if (verbose) std::cout << interactionsPath << std::endl;
+        return;
+    }
+
+    /* Otherwise each channel found is saved as a discrete interaction file */
+    for (size_t i = 0; i < result.labelNames.size(); ++i) {
+        if (!(labelMesh.getChannels() & (1u << i))) continue;
+        if (verbose) std::cout << "\t-> saving discrete interaction file -> ";
+        std::string interactionPath = writeMesh(labelMesh.extract(static_cast<int>(i)),
+                                                outDir + result.labelNames[i], format);
+        if (verbose) std::cout << interactionPath << std::endl;
+    }
+}
+
+/**
+ * This function returns a file-system friendly name of a record (its title if present, "model" otherwise)
+ */
+static std::string recordName(const RDKit::ROMol &molecule) {
+    std::string name;
+    molecule.getPropIfPresent<std::string>("_Name", name);
+    for (char &c: name)
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '.') c = '_';
+    return name.empty() ? "model" : name;
+}
+
+size_t Pipeline::stream(MoleculeReader &reader, const InteractionCollection::list_t &interactions,
+                        const std::string &outRoot, const Options &options,
+                        unsigned int numWorkers, size_t queueCapacity) {
+    if (numWorkers == 0) numWorkers = std::thread::hardware_concurrency();
+    if (numWorkers == 0) numWorkers = 1;
+
+    /* A record travelling through the pipeline, molecule (or result) is null if the record failed */
+    struct Job {
+        size_t index = 0;
+        std::unique_ptr<RDKit::ROMol> molecule;
+        std::vector<std::unique_ptr<Result>> results;
+    };
+
+    BoundedQueue<Job> parsed(queueCapacity);
+    BoundedQueue<Job> computed(queueCapacity);
+
+    /* Parse stage */
+    std::thread parser([&]() {
+        Job job;
+        while (reader.next(job.molecule)) {
+            job.index = reader.getRecordCount() - 1;
+            if (!parsed.push(std::move(job))) break;
+            job = Job();
+        }
+        parsed.close();
+    });
+
+    /* Compute stage (discretization and interactions) */
+    std::atomic<unsigned int> runningWorkers{numWorkers};
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back([&]() {
+            Backend::WorkerScope scope(numWorkers > 1);
+            Job job;
+            while (parsed.pop(job)) {
+                if (job.molecule) {
+                    try {
+                        job.results = computeAll(*job.molecule, interactions, options);
+                        for (std::unique_ptr<Result> &result: job.results)
+                            result->name = recordName(*job.molecule);
+                    } catch (const std::exception &) {
+                        job.results.clear();
+                    }
+                    job.molecule.reset();
+                }
+                computed.push(std::move(job));
+                job = Job();
+            }
+            if (--runningWorkers == 0) computed.close();
+        });
+    }
+
+    /* Write stage */
+    timespec startTime, endTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    auto join = [&]() {
+        parser.join();
+        for (std::thread &worker: workers)
+            worker.join();
+    };
+
+    size_t processed = 0, failed = 0;
+    Metrics batchMetrics;
+    try {
+        Job job;
+        while (computed.pop(job)) {
+            bool written = false;
+            if (!job.results.empty()) {
+                std::string outDir = outRoot + std::to_string(job.index) + "_" + job.results.front()->name + "/";
+                /* A record that cannot be written fails alone, the following ones are still written */
+                try {
+                    std::filesystem::create_directories(outDir);
+                    batchMetrics.merge(writeAll(job.results, outDir, options));
+                    written = true;
+                    std::cout << "\t-> done : record " << job.index << " -> " << outDir << std::endl;
+                } catch (const std::exception &e) {
+                    std::cout << "\t-> failed : record " << job.index << " (" << e.what() << ")" << std::endl;
+                }
+            } else {
+                std::cout << "\t-> failed : record " << job.index << std::endl;
+            }
+            if (written) processed++;
+            else failed++;
+            job = Job();
+        }
+    } catch (...) {
+        /* The other stages are stopped (their queues closed) and joined before leaving */
+        parsed.close();
+        computed.close();
+        join();
+        throw;
+    }
+    join();
+
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    double elapsed = elapsedTime(startTime, endTime);
+    std::cout << "Processed " << processed << "/" << processed + failed << " records in " << elapsed << " s"
+              << " -> " << (elapsed > 0 ? static_cast<double>(processed) / elapsed : 0) << " molecules/s"
+              << std::endl;
+
+    if (Metrics::isEnabled()) {
+        std::string summaryPath = outRoot + "metrics_summary.json";
+        writeMetricsSummary(batchMetrics, processed, failed, elapsed, summaryPath);
+        std::cout << "Metrics summary -> " << summaryPath << std::endl;
+    }
+
+    return failed;
+}
+
+Pipeline::Occupancy::Occupancy(const InteractionCollection::list_t &interactions, int grain) : moleculeMap(grain) {
+    for (const auto &interaction: interactions)
+        interactionMaps.emplace_back(interaction.first, OccupancyMap(grain));
+}
+
+void Pipeline::Occupancy::add(const Result &result) {
+    auto mapOf = [this](const std::string &name) -> OccupancyMap & {
+        for (auto &interactionMap: interactionMaps)
+            if (interactionMap.first == name) return interactionMap.second;
+        throw std::runtime_error("occupancy of an unknown interaction: " + name);
+    };
+
+    frames++;
+    moleculeMap.add(*result.moleculeMesh);
+
+    if (result.labelMesh) {
+        for (size_t i = 0; i < result.labelNames.size(); ++i)
+            mapOf(result.labelNames[i]).add(*result.labelMesh, static_cast<int>(i));
+    }
+    for (const auto &interaction: result.sparseMeshes)
+        mapOf(interaction.first).add(*interaction.second);
+    for (const auto &interaction: result.interactionMeshes)
+        mapOf(interaction.first).add(*interaction.second);
+}
+
+void Pipeline::Occupancy::merge(const Occupancy &other) {
+    frames += other.frames;
+    moleculeMap.merge(other.moleculeMap);
+    for (size_t i = 0; i < interactionMaps.size(); ++i)
+        interactionMaps[i].second.merge(other.interactionMaps[i].second);
+}
+
+Pipeline::Occupancy Pipeline::accumulate(const RDKit::ROMol &molecule,
+                                         const InteractionCollection::list_t &interactions, const Options &options,
+                                         unsigned int numWorkers) {
+    if (numWorkers == 0) numWorkers = std::thread::hardware_concurrency();
+    if (numWorkers == 0) numWorkers = 1;
+
+    std::vector<int> confIds;
+    for (auto conformer = molecule.beginConformers(); conformer != molecule.endConformers(); ++conformer)
+        confIds.push_back(static_cast<int>((*conformer)->getId()));
+    if (confIds.size() < numWorkers) numWorkers = static_cast<unsigned int>(std::max<size_t>(confIds.size(), 1));
+
+    /* Each worker adds the conformers it takes into its own occupancy */
+    std::vector<Occupancy> partials(numWorkers, Occupancy(interactions, options.grain));
+    std::vector<std::exception_ptr> errors(numWorkers);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < numWorkers; ++w) {
+        workers.emplace_back([&, w]() {
+            Backend::WorkerScope scope(numWorkers > 1);
+            try {
+                for (size_t i = next++; i < confIds.size(); i = next++)
+                    partials[w].add(*compute(molecule, interactions, options, false, confIds[i]));
+            } catch (...) {
+                errors[w] = std::current_exception();
+            }
+        });
+    }
+    for (std::thread &worker: workers)
+        worker.join();
+    for (const std::exception_ptr &error: errors)
+        if (error) std::rethrow_exception(error);
+
+    /* Reduce the occupancies of the workers */
+    Occupancy occupancy(interactions, options.grain);
+    for (const Occupancy &partial: partials)
+        occupancy.merge(partial);
+    return occupancy;
+}
+
+size_t Pipeline::accumulate(MoleculeReader &reader, const InteractionCollection::list_t &interactions,
+                            const std::string &outRoot, const Options &options,
+                            unsigned int numWorkers, size_t queueCapacity) {
+    if (numWorkers == 0) numWorkers = std::thread::hardware_concurrency();
+    if (numWorkers == 0) numWorkers = 1;
+
+    BoundedQueue<std::unique_ptr<RDKit::ROMol>> parsed(queueCapacity);
+
+    /* Parse stage */
+    std::atomic<size_t> failed{0};
+    std::thread parser([&]() {
+        std::unique_ptr<RDKit::ROMol> molecule;
+        while (reader.next(molecule)) {
+            if (!molecule) failed++;
+            else if (!parsed.push(std::move(molecule))) break;
+        }
+        parsed.close();
+    });
+
+    timespec startTime, endTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    /* Compute stage, each worker adds the frames of the records it takes into its own occupancy */
+    std::vector<Occupancy> partials(numWorkers, Occupancy(interactions, options.grain));
+    std::vector<Metrics> partialMetrics(numWorkers);
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < numWorkers; ++w) {
+        workers.emplace_back([&, w]() {
+            Backend::WorkerScope scope(numWorkers > 1);
+            std::unique_ptr<RDKit::ROMol> molecule;
+            while (parsed.pop(molecule)) {
+                try {
+                    for (const std::unique_ptr<Result> &result: computeAll(*molecule, interactions, options)) {
+                        partials[w].add(*result);
+                        partialMetrics[w].merge(result->metrics);
+                    }
+                } catch (const std::exception &) {
+                    failed++;
+                }
+                molecule.reset();
+            }
+        });
+    }
+
+    parser.join();
+    for (std::thread &worker: workers)
+        worker.join();
+
+    /* Reduce the occupancies of the workers */
+    Occupancy occupancy(interactions, options.grain);
+    Metrics batchMetrics;
+    for (unsigned int w = 0; w < numWorkers; ++w) {
+        occupancy.merge(partials[w]);
+        batchMetrics.merge(partialMetrics[w]);
+    }
+
+    std::string outDir = outRoot + "occupancy/";
+    std::filesystem::create_directories(outDir);
+    Metrics &writeMetrics = Metrics::local();
+    writeMetrics.clear();
+    writeOccupancy(occupancy, outDir, options.format, true);
+    batchMetrics.merge(writeMetrics);
+
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    double elapsed = elapsedTime(startTime, endTime);
+    size_t processed = reader.getRecordCount() - failed;
+    std::cout << "Accumulated " << occupancy.frames << " frames of " << processed << "/" << reader.getRecordCount()
+              << " records in " << elapsed << " s -> "
+              << (elapsed > 0 ? static_cast<double>(occupancy.frames) / elapsed : 0) << " frames/s" << std::endl;
+
+    if (Metrics::isEnabled()) {
+        std::string summaryPath = outRoot + "metrics_summary.json";
+        writeMetricsSummary(batchMetrics, processed, failed, elapsed, summaryPath);
+        std::cout << "Metrics summary -> " << summaryPath << std::endl;
+    }
+
+    return failed;
+}
+
+void Pipeline::writeOccupancy(const Occupancy &occupancy, const std::string &outDir, OutputFormat format,
+                              bool verbose) {
+    auto writeMap = [&](const OccupancyMap &map, const std::string &basePath) {
+        Metrics::Timer timer(Metrics::WRITE);
+        std::string path = basePath + (format == DX ? ".dx" : ".mrc");
+        if (format == DX) MeshIO::writeDX(map, occupancy.frames, path);
+        else MeshIO::writeMRC(map, occupancy.frames, path);
+        countWritten(path);
+        return path;
+    };
+
+    if (occupancy.moleculeMap.empty()) return;
+
+    if (verbose) std::cout << "\t-> saving molecule occupancy file -> ";
+    std::string moleculePath = writeMap(occupancy.moleculeMap, outDir + "Molecule");
+    if (verbose) std::cout << moleculePath << std::endl;
+
+    for (const auto &interactionMap: occupancy.interactionMaps) {
+        if (interactionMap.second.empty()) continue;
+        if (verbose) std::cout << "\t-> saving interaction occupancy file -> ";
+        std::string interactionPath = writeMap(interactionMap.second, outDir + interactionMap.first);
+        if (verbose) std::cout << interactionPath << std::endl;
+    }
+}
@@ -0,0 +1,56 @@
+#include "RestrictedBasePIStackingInteraction.hpp"
+#include "Backend.hpp"
+
+bool RestrictedBasePIStackingInteraction::getInteraction(const MoleculeContext &context, MoleculeMesh &interactionMask,
+                                                         MoleculeMesh &subtractionMask) {
+    return stampMatches(context, interactionMask, [&](const MatchCache::matches_t &matches) {
+        // The work is estimated as the rows of the pattern windows stamped, one per match
+        switch (Backend::resolve(matches->size() * Backend::patternRows(distance, interactionMask.grain))) {
+#ifdef USEOMP
+            case Backend::OMP:
+                return getInteractionOmp(context, matches, interactionMask, subtractionMask);
+#endif
+#ifdef USECUDA
+            case Backend::CUDA:
+                return getInteractionCuda(context, matches, interactionMask, subtractionMask);
+#endif
+            default:
+                return getInteractionSerial(context, matches, interactionMask, subtractionMask);
+        }
+    });
+}
+
+void RestrictedBasePIStackingInteraction::placeMatches(const MoleculeContext &context,
+                                                       const std::vector<RDKit::MatchVectType> &matches,
+                                                       const std::vector<size_t> &sites,
+                                                       const MoleculeMesh &interactionMask,
+                                                       std::vector<MatchStamp> &stamps) {
+    // Pattern rasterizer at the grain of the support-mesh
+    const int grain = interactionMask.grain;
+    const RingStencil ring(distance, {min_angle_ring, max_angle_ring}, {min_angle_cent, max_angle_cent},
+                           intersect, intersect_radius, grain);
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - ring.getCenter());
+
+    for (size_t site: sites) {
+        MatchStamp &stamp = stamps[site];
+        stamp.stencil = nullptr;
+
+        // Degenerate rings have no pattern
+        RDGeom::Point3D center, normal;
+        if (!RingStencil::ringFrame(context, matches[site], center, normal)) continue;
+
+        // Generate the own pattern-mesh runs around the ring centroid
+        ring.build(normal, stamp.runs);
+
+        // Find the zero-point displacement of pattern from the zero-point of support-mask
+        double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+        double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+        double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+        // Discretize the displacement
+        stamp.displ_x = static_cast<int>(round(px));
+        stamp.displ_y = static_cast<int>(round(py));
+        stamp.displ_z = static_cast<int>(round(pz));
+        stamp.stencil = &stamp.runs;
+    }
+}
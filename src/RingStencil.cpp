@@ -0,0 +1,226 @@
+#include "RingStencil.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "StencilCache.hpp"
+
+namespace {
+    /**
+     * This function returns the cosine of an angle bound, right angles get an exact zero
+     * (the voxels at 90 degrees must keep matching the bound)
+     */
+    double boundCos(double angle) {
+        double c = cos(angle);
+        return fabs(c) < 1e-12 ? 0 : c;
+    }
+
+    /**
+     * This function folds an angle bound into [0, PI / 2]
+     */
+    double fold(double angle) {
+        return std::min(std::max(angle, 0.0), M_PI / 2);
+    }
+
+    /**
+     * The classification of a cell of voxels
+     */
+    enum CellState : uint8_t {
+        UNKNOWN = 0,
+        OUTSIDE,
+        INSIDE,
+        MIXED
+    };
+
+    /**
+     * The margin kept between a cell angular range and an angle bound, so that rounding never misclassifies a cell
+     */
+    constexpr double angleMargin = 1e-7;
+}
+
+RingStencil::RingStencil(double distance, std::pair<double, double> plane_angle,
+                         std::pair<double, double> normal_to_centroid_angle,
+                         bool intersect, double intersect_radius, int grain) :
+        sphere(StencilCache::sphere(distance, grain)),
+        scaledMaskCenter(static_cast<int>(ceil(distance * grain))),
+        grain(grain),
+        intersect(intersect),
+        intersect_radius(intersect_radius) {
+    double min_plane = fold(plane_angle.first), max_plane = fold(plane_angle.second);
+    double min_cent = fold(normal_to_centroid_angle.first), max_cent = fold(normal_to_centroid_angle.second);
+
+    /*
+     * Theta intervals:
+     *      - the ring normal satisfies the normal-to-centroid restriction itself
+     *      - a partner normal tilted by [min_plane, max_plane] from n satisfies it
+     */
+    double lower[2] = {min_cent, std::max(min_plane - max_cent, min_cent - max_plane)};
+    double upper[2] = {max_cent, std::min(max_plane + max_cent, M_PI / 2)};
+    for (int i = 0; i < 2; ++i) {
+        lower[i] = fold(lower[i]);
+        theta_lower[i] = lower[i];
+        theta_upper[i] = upper[i];
+        double cos_upper = boundCos(upper[i]), cos_lower = boundCos(lower[i]);
+        band_lower[i] = upper[i] >= M_PI / 2 ? 0 : cos_upper * cos_upper;
+        band_upper[i] = lower[i] <= 0 ? 2 : cos_lower * cos_lower;
+        if (lower[i] > upper[i]) band_lower[i] = 3;
+    }
+
+    // Ring-plane angle bounds for the intersection restriction (a zero min angle leaves the planes free)
+    bounded_min_plane = min_plane > 0;
+    cot_min_plane = bounded_min_plane ? boundCos(min_plane) / sin(min_plane) : 0;
+    cot_max_plane = max_plane > 0 ? boundCos(max_plane) / sin(max_plane) : 0;
+    sin_max_plane = sin(max_plane);
+}
+
+bool RingStencil::ringFrame(const MoleculeContext &context, const RDKit::MatchVectType &match,
+                            RDGeom::Point3D &centroid, RDGeom::Point3D &normal) {
+    if (match.size() < 3) return false;
+
+    centroid = RDGeom::Point3D(0, 0, 0);
+    normal = RDGeom::Point3D(0, 0, 0);
+    for (size_t i = 0; i < match.size(); ++i) {
+        RDGeom::Point3D cur = context.getAtomPos(match[i].second);
+        RDGeom::Point3D next = context.getAtomPos(match[(i + 1) % match.size()].second);
+        centroid += cur;
+
+        // Newell's method, robust to slightly non planar rings
+        normal.x += (cur.y - next.y) * (cur.z + next.z);
+        normal.y += (cur.z - next.z) * (cur.x + next.x);
+        normal.z += (cur.x - next.x) * (cur.y + next.y);
+    }
+    centroid /= static_cast<double>(match.size());
+
+    double length = normal.length();
+    if (length == 0) return false;
+    normal /= length;
+    return true;
+}
+
+void RingStencil::build(const RDGeom::Point3D &normal, SpanStencil &stencil) const {
+    Grain::dispatch(grain, [&](auto g) { buildKernel(normal, stencil, g); });
+}
+
+template<typename G>
+void RingStencil::buildKernel(const RDGeom::Point3D &normal, SpanStencil &stencil, G grain) const {
+    stencil.clear();
+    stencil.dim_x = sphere.dim_x;
+    stencil.dim_y = sphere.dim_y;
+    stencil.dim_z = sphere.dim_z;
+
+    const int C = scaledMaskCenter;
+    const double r = intersect_radius, r_sq = r * r;
+    const double max_h_sq = r_sq * sin_max_plane * sin_max_plane;
+
+    /*
+     * Coarse pass: the points of a cell lie within #reach of its center, so their angles with n lie within
+     * asin(reach / |u|) of the center one, cells are classified lazily as rows reach them (at coarse grains cells span
+     * too much of the pattern to be classified, so all of them are left mixed)
+     */
+    const int cells = (sphere.dim_x + cellEdge - 1) / cellEdge;
+    // The states are rebuilt for every pattern, into a buffer each thread keeps across patterns
+    thread_local std::vector<uint8_t> cellStates;
+    cellStates.assign(grain < minCellGrain ? 0 : static_cast<size_t>(cells) * cells * cells, UNKNOWN);
+    const double reach = sqrt(3.0) * (cellEdge - 1) / 2 / grain;
+    const double cellOffset = (cellEdge - 1) / 2.0 - C;
+    auto classify = [&](int cx, int cy, int cz) -> uint8_t {
+        double vx = (cx * cellEdge + cellOffset) / grain;
+        double vy = (cy * cellEdge + cellOffset) / grain;
+        double vz = (cz * cellEdge + cellOffset) / grain;
+        double cross_x = normal.y * vz - normal.z * vy, cross_y = normal.z * vx - normal.x * vz,
+                cross_z = normal.x * vy - normal.y * vx;
+        double length = sqrt(vx * vx + vy * vy + vz * vz);
+        if (length <= reach * (1 + angleMargin)) return MIXED;
+
+        // Theta range of the cell, folded into [0, 90]
+        double theta = atan2(sqrt(cross_x * cross_x + cross_y * cross_y + cross_z * cross_z),
+                             normal.x * vx + normal.y * vy + normal.z * vz);
+        double spread = asin(reach / length);
+        double low = std::max(theta - spread, 0.0), high = std::min(theta + spread, M_PI);
+        if (low >= M_PI / 2) {
+            double folded = M_PI - high;
+            high = M_PI - low;
+            low = folded;
+        } else if (high > M_PI / 2) {
+            low = std::min(low, M_PI - high);
+            high = M_PI / 2;
+        }
+
+        bool outside = true;
+        for (int i = 0; i < 2; ++i) {
+            if (theta_lower[i] > theta_upper[i]) continue;
+            bool lowerOk = theta_lower[i] <= 0 || low > theta_lower[i] + angleMargin;
+            bool upperOk = theta_upper[i] >= M_PI / 2 || high < theta_upper[i] - angleMargin;
+            if (lowerOk && upperOk) return intersect ? MIXED : INSIDE;
+            outside = outside && (high < theta_lower[i] - angleMargin || low > theta_upper[i] + angleMargin);
+        }
+        return outside ? OUTSIDE : MIXED;
+    };
+
+    // Over all the rows of the sphere keep the x-runs of voxels that satisfy the restrictions
+    for (const SpanStencil::Span &span: sphere.spans) {
+        double uy = static_cast<double>(span.y - C) / grain;
+        double uz = static_cast<double>(span.z - C) / grain;
+        double yz = uy * uy + uz * uz;
+        double dyz = normal.y * uy + normal.z * uz;
+
+        // Fine pass: runs are grown cell by cell, only the voxels of the mixed cells are tested one by one
+        const size_t rowCells = static_cast<size_t>(cells) * (span.z / cellEdge * cells + span.y / cellEdge);
+        int runBegin = -1;
+        auto mark = [&](int x, bool inside) {
+            if (inside) {
+                if (runBegin < 0) runBegin = x;
+            } else if (runBegin >= 0) {
+                stencil.push(span.y, span.z, runBegin, x);
+                runBegin = -1;
+            }
+        };
+
+        for (int x = span.x_begin; x < span.x_end;) {
+            int cellEnd = span.x_end;
+            if (grain >= minCellGrain) {
+                int cx = x / cellEdge;
+                uint8_t &state = cellStates[rowCells + cx];
+                cellEnd = std::min(span.x_end, (cx + 1) * cellEdge);
+                if (state == UNKNOWN) state = classify(cx, span.y / cellEdge, span.z / cellEdge);
+                if (state != MIXED) {
+                    mark(x, state == INSIDE);
+                    x = cellEnd;
+                    continue;
+                }
+            }
+
+            for (; x < cellEnd; ++x) {
+                double ux = static_cast<double>(x - C) / grain;
+
+                // d = |u| cos(theta) is the height above the ring plane, rho^2 = |u|^2 - d^2 the in-plane distance
+                double d = normal.x * ux + dyz;
+                double uu = ux * ux + yz;
+                double d2 = d * d;
+
+                bool angleOk = (d2 >= band_lower[0] * uu && d2 <= band_upper[0] * uu) ||
+                               (d2 >= band_lower[1] * uu && d2 <= band_upper[1] * uu);
+
+                bool intersectOk = true;
+                if (intersect) {
+                    /*
+                     * The planes intersection crosses the ring plane at rho + h * cot(phi), phi the signed tilt:
+                     *      - near the ring centroid: |rho + h * cot(phi)| <= r for some |phi| in [min_plane, max_plane]
+                     *      - near the partner centroid: h / sin(phi) <= r, that is h <= r * sin(max_plane)
+                     */
+                    double h = fabs(d);
+                    double rho_sq = std::max(uu - d2, 0.0);
+                    double near_max = r + h * cot_min_plane, far_min = h * cot_max_plane - r;
+                    bool nearRing = (!bounded_min_plane || rho_sq <= near_max * near_max) &&
+                                    (far_min <= 0 || rho_sq >= far_min * far_min);
+                    double back = r - h * cot_max_plane;
+                    nearRing = nearRing || (back >= 0 && rho_sq <= back * back);
+                    intersectOk = nearRing || d2 <= max_h_sq;
+                }
+
+                mark(x, uu > 0 && angleOk && intersectOk);
+            }
+        }
+        if (runBegin >= 0) stencil.push(span.y, span.z, runBegin, span.x_end);
+    }
+}
@@ -0,0 +1,34 @@
+#include "ScratchArena.hpp"
+#include <algorithm>
+
+ScratchArena::ScratchArena(size_t capacity) :
+        buffer(new std::byte[capacity]), capacity(capacity), used(0), peak(0) {
+    arena.emplace(buffer.get(), capacity, std::pmr::new_delete_resource());
+}
+
+ScratchArena &ScratchArena::local() {
+    thread_local ScratchArena threadArena;
+    return threadArena;
+}
+
+void *ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+    // Alignment padding is accounted as the worst case
+    used += bytes + alignment - 1;
+    return arena->allocate(bytes, alignment);
+}
+
+void ScratchArena::reset() {
+    peak = std::max(peak, used);
+    used = 0;
+
+    if (peak <= capacity) {
+        arena->release();
+        return;
+    }
+
+    // The last molecule overflowed into the system allocator: enlarge the buffer (with some headroom)
+    capacity = peak + peak / 4;
+    arena.reset();
+    buffer.reset(new std::byte[capacity]);
+    arena.emplace(buffer.get(), capacity, std::pmr::new_delete_resource());
+}
@@ -0,0 +1,56 @@
+#include "SingleAngleInteraction.hpp"
+#include "Backend.hpp"
+
+bool SingleAngleInteraction::getInteraction(const MoleculeContext &context, MoleculeMesh &interactionMask,
+                                            MoleculeMesh &subtractionMask) {
+    return stampMatches(context, interactionMask, [&](const MatchCache::matches_t &matches) {
+        // The work is estimated as the rows of the pattern windows stamped, one per match
+        switch (Backend::resolve(matches->size() * Backend::patternRows(distance, interactionMask.grain))) {
+#ifdef USEOMP
+            case Backend::OMP:
+                return getInteractionOmp(context, matches, interactionMask, subtractionMask);
+#endif
+#ifdef USECUDA
+            case Backend::CUDA:
+                return getInteractionCuda(context, matches, interactionMask, subtractionMask);
+#endif
+            default:
+                return getInteractionSerial(context, matches, interactionMask, subtractionMask);
+        }
+    });
+}
+
+void SingleAngleInteraction::placeMatches(const MoleculeContext &context,
+                                          const std::vector<RDKit::MatchVectType> &matches,
+                                          const std::vector<size_t> &sites, const MoleculeMesh &interactionMask,
+                                          std::vector<MatchStamp> &stamps) {
+    // Pattern rasterizer at the grain of the support-mesh
+    const int grain = interactionMask.grain;
+    const ConeStencil cone({min_angle, max_angle}, distance, grain);
+    auto paddingDisplacement = static_cast<double>(interactionMask.internalDisplacement - cone.getCenter());
+
+    for (size_t site: sites) {
+        MatchStamp &stamp = stamps[site];
+        stamp.stencil = nullptr;
+        if (matches[site].size() < 2) continue;
+
+        // Get molecule match centroids position
+        RDGeom::Point3D p1 = context.getAtomPos(matches[site][0].second);
+        RDGeom::Point3D p2 = context.getAtomPos(matches[site][1].second);
+        RDGeom::Point3D center = cp ? p1 : p2;
+
+        // Generate the own pattern-mesh runs of the match
+        cone.build(center, p1, p2, stamp.runs);
+
+        // Find the zero-point displacement of pattern from the zero-point of support-mask
+        double px = (center.x - interactionMask.globalDisplacement.x) * grain + paddingDisplacement;
+        double py = (center.y - interactionMask.globalDisplacement.y) * grain + paddingDisplacement;
+        double pz = (center.z - interactionMask.globalDisplacement.z) * grain + paddingDisplacement;
+
+        // Discretize the displacement
+        stamp.displ_x = static_cast<int>(round(px));
+        stamp.displ_y = static_cast<int>(round(py));
+        stamp.displ_z = static_cast<int>(round(pz));
+        stamp.stencil = &stamp.runs;
+    }
+}
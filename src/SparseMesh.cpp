@@ -0,0 +1,166 @@
+#include "SparseMesh.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    /**
+     * This function returns the 8-voxel row of a brick at a given dense packed x-row
+     * (bricks are aligned to 8 voxels, so a brick row never straddles two dense words)
+     */
+    inline MoleculeMesh::data_t denseByte(const MoleculeMesh::data_t *row, int x) {
+        return (row[x / MoleculeMesh::wordBits] >> (x % MoleculeMesh::wordBits)) & 0xFF;
+    }
+}
+
+SparseMesh::SparseMesh(int p_dim_x, int p_dim_y, int p_dim_z, const RDGeom::Point3D &globalDisplacement,
+                       int internalDisplacement, int grain) :
+        bricks_x((p_dim_x + brickEdge - 1) / brickEdge),
+        bricks_y((p_dim_y + brickEdge - 1) / brickEdge),
+        bricks_z((p_dim_z + brickEdge - 1) / brickEdge),
+        dim_x(p_dim_x),
+        dim_y(p_dim_y),
+        dim_z(p_dim_z),
+        globalDisplacement(globalDisplacement),
+        internalDisplacement(internalDisplacement),
+        grain(grain) {
+    table = std::vector<int32_t>(static_cast<size_t>(bricks_x) * bricks_y * bricks_z, -1);
+}
+
+SparseMesh::SparseMesh(const MoleculeMesh &mesh) :
+        SparseMesh(mesh.dim_x, mesh.dim_y, mesh.dim_z, mesh.globalDisplacement, mesh.internalDisplacement,
+                   mesh.grain) {
+    /* Only the non-empty rows of the bricks are copied */
+    for (int z = 0; z < dim_z; ++z) {
+        for (int y = 0; y < dim_y; ++y) {
+            const MoleculeMesh::data_t *row = MoleculeMesh::row(mesh.getData(), y, z, mesh.words_x, mesh.dim_y);
+            for (int w = 0; w < mesh.words_x; ++w) {
+                if (!row[w]) continue;
+                for (int x = w * MoleculeMesh::wordBits; x < (w + 1) * MoleculeMesh::wordBits; x += brickEdge) {
+                    MoleculeMesh::data_t byte = denseByte(row, x);
+                    if (byte)
+                        touch(brickKey(x / brickEdge, y / brickEdge, z / brickEdge))[z % brickEdge] |=
+                                byte << (brickEdge * (y % brickEdge));
+                }
+            }
+        }
+    }
+}
+
+MoleculeMesh SparseMesh::toDense() const {
+    MoleculeMesh mesh(dim_x, dim_y, dim_z, globalDisplacement, internalDisplacement, grain);
+
+    for (size_t i = 0; i < bricks.size(); ++i) {
+        int x = static_cast<int>(keys[i] % bricks_x) * brickEdge;
+        int by = static_cast<int>(keys[i] / bricks_x % bricks_y) * brickEdge;
+        int bz = static_cast<int>(keys[i] / bricks_x / bricks_y) * brickEdge;
+        for (int l = 0; l < brickEdge && bz + l < dim_z; ++l) {
+            for (int r = 0; r < brickEdge && by + r < dim_y; ++r) {
+                MoleculeMesh::data_t byte = (bricks[i][l] >> (brickEdge * r)) & 0xFF;
+                if (byte)
+                    MoleculeMesh::row(mesh.getData(), by + r, bz + l, mesh.words_x, mesh.dim_y)
+                    [x / MoleculeMesh::wordBits] |= byte << (x % MoleculeMesh::wordBits);
+            }
+        }
+    }
+
+    return mesh;
+}
+
+void SparseMesh::checkShape(int o_dim_x, int o_dim_y, int o_dim_z) const {
+    if (o_dim_x != dim_x || o_dim_y != dim_y || o_dim_z != dim_z)
+        throw std::runtime_error("sparse mesh operands must have the same size");
+}
+
+size_t SparseMesh::getVoxelCount() const {
+    size_t count = 0;
+    for (const brick_t &brick: bricks)
+        for (MoleculeMesh::data_t word: brick)
+            count += __builtin_popcountll(word);
+    return count;
+}
+
+void SparseMesh::clear() {
+    for (uint32_t key: keys)
+        table[key] = -1;
+    bricks.clear();
+    keys.clear();
+}
+
+void SparseMesh::prune() {
+    size_t kept = 0;
+    for (size_t i = 0; i < bricks.size(); ++i) {
+        bool empty = true;
+        for (MoleculeMesh::data_t word: bricks[i])
+            empty = empty && word == 0;
+
+        if (empty) {
+            table[keys[i]] = -1;
+            continue;
+        }
+        bricks[kept] = bricks[i];
+        keys[kept] = keys[i];
+        table[keys[kept]] = static_cast<int32_t>(kept);
+        kept++;
+    }
+    bricks.resize(kept);
+    keys.resize(kept);
+}
+
+void SparseMesh::add(const SparseMesh &addend) {
+    checkShape(addend.dim_x, addend.dim_y, addend.dim_z);
+
+    for (size_t i = 0; i < addend.bricks.size(); ++i) {
+        brick_t &brick = touch(addend.keys[i]);
+        for (int l = 0; l < brickEdge; ++l)
+            brick[l] |= addend.bricks[i][l];
+    }
+}
+
+void SparseMesh::sub(const SparseMesh &mask) {
+    checkShape(mask.dim_x, mask.dim_y, mask.dim_z);
+
+    for (size_t i = 0; i < bricks.size(); ++i) {
+        int32_t index = mask.table[keys[i]];
+        if (index < 0) continue;
+        for (int l = 0; l < brickEdge; ++l)
+            bricks[i][l] &= ~mask.bricks[index][l];
+    }
+}
+
+void SparseMesh::sub(const MoleculeMesh &mask) {
+    checkShape(mask.dim_x, mask.dim_y, mask.dim_z);
+
+    for (size_t i = 0; i < bricks.size(); ++i) {
+        int x = static_cast<int>(keys[i] % bricks_x) * brickEdge;
+        int by = static_cast<int>(keys[i] / bricks_x % bricks_y) * brickEdge;
+        int bz = static_cast<int>(keys[i] / bricks_x / bricks_y) * brickEdge;
+        for (int l = 0; l < brickEdge && bz + l < dim_z; ++l) {
+            MoleculeMesh::data_t cleared = 0;
+            for (int r = 0; r < brickEdge && by + r < dim_y; ++r)
+                cleared |= denseByte(MoleculeMesh::row(mask.getData(), by + r, bz + l, mask.words_x, mask.dim_y), x)
+                        << (brickEdge * r);
+            bricks[i][l] &= ~cleared;
+        }
+    }
+}
+
+void SparseMesh::stamp(const SpanStencil &stencil, int displ_x, int displ_y, int displ_z) {
+    /* Fill each run clipped onto the space, one brick row at a time */
+    for (const SpanStencil::Span &span: stencil.spans) {
+        int y = span.y + displ_y;
+        int z = span.z + displ_z;
+        if (y < 0 || y >= dim_y || z < 0 || z >= dim_z) continue;
+
+        int sx = std::max(span.x_begin + displ_x, 0);
+        int ex = std::min(span.x_end + displ_x, dim_x);
+        if (sx >= ex) continue;
+
+        int shift = brickEdge * (y % brickEdge);
+        for (int bx = sx / brickEdge; bx <= (ex - 1) / brickEdge; ++bx) {
+            int lo = std::max(sx - bx * brickEdge, 0);
+            int hi = std::min(ex - bx * brickEdge, brickEdge);
+            MoleculeMesh::data_t byte = ((MoleculeMesh::data_t(1) << hi) - 1) & ~((MoleculeMesh::data_t(1) << lo) - 1);
+            touch(brickKey(bx, y / brickEdge, z / brickEdge))[z % brickEdge] |= byte << shift;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#include "StencilCache.hpp"
+#include "Metrics.hpp"
+#include <cmath>
+
+std::mutex StencilCache::mutex;
+std::map<StencilCache::sphere_key_t, std::unique_ptr<const SpanStencil>> StencilCache::spheres;
+
+std::unique_ptr<const SpanStencil> StencilCache::buildSphere(double radius, int grain) {
+    Metrics::Timer timer(Metrics::STENCIL);
+    Metrics::count(Metrics::STENCILS_BUILT, 1);
+
+    // Discretize mask radius and calculate mask dimension
+    int scaledMaskRadius = static_cast<int>(ceil(radius * grain));
+    int maskDim = 2 * scaledMaskRadius;
+
+    // Generate an empty pattern
+    auto bubble = std::make_unique<SpanStencil>(maskDim, maskDim, maskDim);
+
+    // For each row of the pattern find the x-run of points with (point-distance <= #radius) from the center
+    double scaledDistance = radius * grain;
+    double ds = scaledDistance * scaledDistance;
+    for (int z = 0; z < maskDim; ++z) {
+        int dz = z - scaledMaskRadius;
+        int z_res = dz * dz;
+        for (int y = 0; y < maskDim; ++y) {
+            int dy = y - scaledMaskRadius;
+            int y_res = dy * dy;
+
+            double x_res = ds - y_res - z_res;
+            if (x_res < 0) continue;
+
+            // Largest |dx| such that dx * dx <= x_res (fixed up against sqrt rounding)
+            int dx = static_cast<int>(floor(sqrt(x_res)));
+            while ((dx + 1) * (dx + 1) <= x_res) ++dx;
+            while (dx > 0 && dx * dx > x_res) --dx;
+
+            int x_begin = scaledMaskRadius - dx;
+            int x_end = scaledMaskRadius + dx + 1;
+            if (x_end > maskDim) x_end = maskDim;
+            bubble->push(y, z, x_begin, x_end);
+        }
+    }
+
+    return bubble;
+}
+
+const SpanStencil &StencilCache::sphere(double radius, int grain) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto &cached = spheres[{radius, grain}];
+    if (!cached) cached = buildSphere(radius, grain);
+
+    return *cached;
+}
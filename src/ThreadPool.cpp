@@ -0,0 +1,107 @@
+#include "ThreadPool.hpp"
+#include "Backend.hpp"
+
+namespace {
+    /**
+     * The pool and worker index the current thread belongs to (if any)
+     */
+    thread_local const ThreadPool *currentPool = nullptr;
+    thread_local unsigned int currentWorker = 0;
+}
+
+ThreadPool::ThreadPool(unsigned int numThreads) {
+    if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+    if (numThreads == 0) numThreads = 1;
+
+    for (unsigned int i = 0; i < numThreads; ++i)
+        queues.push_back(std::make_unique<WorkerQueue>());
+
+    for (unsigned int i = 0; i < numThreads; ++i)
+        workers.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread &worker: workers)
+        worker.join();
+}
+
+void ThreadPool::submit(task_t task) {
+    unsigned int target;
+    if (currentPool == this) target = currentWorker;
+    else target = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++queued;
+        ++pending;
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return pending == 0; });
+}
+
+bool ThreadPool::tryPop(unsigned int self, task_t &task) {
+    /* Newest task of the own queue */
+    {
+        WorkerQueue &own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    /* Oldest task of another queue */
+    for (size_t i = 1; i < queues.size(); ++i) {
+        WorkerQueue &victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(unsigned int self) {
+    currentPool = this;
+    currentWorker = self;
+    Backend::WorkerScope scope(queues.size() > 1);
+
+    for (;;) {
+        /* Reserve one of the queued tasks, or leave if the pool is stopping */
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            taskAvailable.wait(lock, [this] { return queued > 0 || stopping; });
+            if (queued == 0) return;
+            --queued;
+        }
+
+        /* A reserved task is always somewhere in the queues */
+        task_t task;
+        while (!tryPop(self, task))
+            std::this_thread::yield();
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (--pending == 0) allDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,185 @@
+#include "TrajectoryMesh.hpp"
+#include "Metrics.hpp"
+#include "Transformer.hpp"
+
+TrajectoryMesh::TrajectoryMesh(const InteractionCollection::list_t &interactions, int grain, int padding, int margin,
+                               double tolerance) :
+        interactions(interactions),
+        grain(Grain::check(grain)),
+        padding(padding),
+        margin(margin),
+        squaredTolerance(tolerance * tolerance) {}
+
+bool TrajectoryMesh::fits(const MoleculeContext &context) const {
+    const MoleculeMesh &mesh = molecule->getMesh();
+    const int scaledPadding = padding * grain;
+    const double *atoms[3] = {context.x.data(), context.y.data(), context.z.data()};
+    const double origin[3] = {mesh.globalDisplacement.x, mesh.globalDisplacement.y, mesh.globalDisplacement.z};
+    const int dims[3] = {mesh.dim_x, mesh.dim_y, mesh.dim_z};
+
+    for (int axis = 0; axis < 3; ++axis) {
+        for (size_t i = 0; i < context.getNumAtoms(); ++i) {
+            double c = Transformer::meshCoordinate(atoms[axis][i], origin[axis], mesh.internalDisplacement, grain);
+            if (c < scaledPadding || c > dims[axis] - scaledPadding) return false;
+        }
+    }
+    return true;
+}
+
+void TrajectoryMesh::rebuild(const MoleculeContext &context, const std::vector<MatchCache::matches_t> &matches) {
+    Metrics::Timer timer(Metrics::DISCRETIZE);
+
+    /* The support-mesh of the frame, enlarged so that the next frames fit it too */
+    std::unique_ptr<MoleculeMesh> support = Transformer::supportMesh(context, padding + margin, grain);
+    const int dim_x = support->dim_x, dim_y = support->dim_y, dim_z = support->dim_z;
+
+    molecule = std::make_unique<CountMesh>(dim_x, dim_y, dim_z, support->globalDisplacement,
+                                           support->internalDisplacement, grain);
+
+    /* Stamp every atom sphere */
+    const size_t n_atoms = context.getNumAtoms();
+    const double radius = Transformer::getAtomRadius() * grain;
+    atomAnchors.resize(3 * n_atoms);
+    for (size_t i = 0; i < n_atoms; ++i) {
+        double *anchor = &atomAnchors[3 * i];
+        anchor[0] = Transformer::meshCoordinate(context.x[i], support->globalDisplacement.x,
+                                                support->internalDisplacement, grain);
+        anchor[1] = Transformer::meshCoordinate(context.y[i], support->globalDisplacement.y,
+                                                support->internalDisplacement, grain);
+        anchor[2] = Transformer::meshCoordinate(context.z[i], support->globalDisplacement.z,
+                                                support->internalDisplacement, grain);
+        molecule->stampSphere(anchor[0], anchor[1], anchor[2], radius);
+    }
+
+    /* Place and stamp the pattern of every match */
+    channels.resize(interactions.size());
+    for (size_t c = 0; c < interactions.size(); ++c) {
+        Channel &channel = channels[c];
+        channel.interaction = interactions[c].second.get();
+        channel.matches = matches[c];
+        channel.coverage = std::make_unique<CountMesh>(dim_x, dim_y, dim_z, support->globalDisplacement,
+                                                       support->internalDisplacement, grain);
+
+        const size_t n_matches = channel.matches->size();
+        channel.stamps.clear();
+        channel.stamps.resize(n_matches);
+        channel.offsets.resize(n_matches);
+        size_t n_anchors = 0;
+        for (size_t i = 0; i < n_matches; ++i) {
+            channel.offsets[i] = n_anchors;
+            n_anchors += (*channel.matches)[i].size();
+        }
+        channel.anchors.resize(3 * n_anchors);
+
+        std::vector<size_t> sites(n_matches);
+        for (size_t i = 0; i < n_matches; ++i)
+            sites[i] = i;
+        place(channel, context, sites);
+    }
+
+    rebuilt = true;
+    movedAtoms = n_atoms;
+}
+
+void TrajectoryMesh::place(Channel &channel, const MoleculeContext &context, const std::vector<size_t> &sites) {
+    channel.interaction->placeMatches(context, *channel.matches, sites, channel.coverage->getMesh(), channel.stamps);
+
+    for (size_t site: sites) {
+        const Interaction::MatchStamp &stamp = channel.stamps[site];
+        if (stamp.stencil) channel.coverage->stamp(*stamp.stencil, stamp.displ_x, stamp.displ_y, stamp.displ_z);
+
+        /* The motion of the match is measured from here on */
+        double *anchor = &channel.anchors[3 * channel.offsets[site]];
+        for (const std::pair<int, int> &atom: (*channel.matches)[site]) {
+            *anchor++ = context.x[atom.second] * grain;
+            *anchor++ = context.y[atom.second] * grain;
+            *anchor++ = context.z[atom.second] * grain;
+        }
+    }
+
+    channel.placed = 0;
+    for (const Interaction::MatchStamp &stamp: channel.stamps)
+        channel.placed += stamp.stencil != nullptr;
+}
+
+void TrajectoryMesh::update(const MoleculeContext &context) {
+    /* Matches are cached by topology, so a frame of the same molecule finds the very same ones */
+    std::vector<MatchCache::matches_t> matches;
+    matches.reserve(interactions.size());
+    for (const auto &interaction: interactions)
+        matches.push_back(interaction.second->getMatches(context));
+
+    bool sameTopology = molecule && atomAnchors.size() == 3 * context.getNumAtoms();
+    for (size_t c = 0; sameTopology && c < channels.size(); ++c)
+        sameTopology = channels[c].matches == matches[c];
+
+    if (!sameTopology || !fits(context)) {
+        rebuild(context, matches);
+        return;
+    }
+
+    rebuilt = false;
+    movedAtoms = 0;
+    movedMatches = 0;
+
+    auto moved = [this](double x, double y, double z, const double *anchor) {
+        double dx = x - anchor[0], dy = y - anchor[1], dz = z - anchor[2];
+        return dx * dx + dy * dy + dz * dz >= squaredTolerance;
+    };
+
+    /* Move the spheres of the atoms that moved */
+    {
+        Metrics::Timer timer(Metrics::DISCRETIZE);
+        const MoleculeMesh &mesh = molecule->getMesh();
+        const double radius = Transformer::getAtomRadius() * grain;
+        const RDGeom::Point3D origin = mesh.globalDisplacement;
+        const int scaledPadding = mesh.internalDisplacement;
+        for (size_t i = 0; i < context.getNumAtoms(); ++i) {
+            double *anchor = &atomAnchors[3 * i];
+            double cx = Transformer::meshCoordinate(context.x[i], origin.x, scaledPadding, grain);
+            double cy = Transformer::meshCoordinate(context.y[i], origin.y, scaledPadding, grain);
+            double cz = Transformer::meshCoordinate(context.z[i], origin.z, scaledPadding, grain);
+            if (!moved(cx, cy, cz, anchor)) continue;
+
+            molecule->unstampSphere(anchor[0], anchor[1], anchor[2], radius);
+            molecule->stampSphere(cx, cy, cz, radius);
+            anchor[0] = cx;
+            anchor[1] = cy;
+            anchor[2] = cz;
+            movedAtoms++;
+        }
+    }
+
+    /* Move the patterns of the matches having an atom that moved */
+    Metrics::Timer timer(Metrics::STAMP);
+    std::vector<size_t> sites;
+    for (Channel &channel: channels) {
+        sites.clear();
+        for (size_t i = 0; i < channel.matches->size(); ++i) {
+            const double *anchor = &channel.anchors[3 * channel.offsets[i]];
+            for (const std::pair<int, int> &atom: (*channel.matches)[i]) {
+                if (moved(context.x[atom.second] * grain, context.y[atom.second] * grain,
+                          context.z[atom.second] * grain, anchor)) {
+                    sites.push_back(i);
+                    break;
+                }
+                anchor += 3;
+            }
+        }
+        if (sites.empty()) continue;
+
+        for (size_t site: sites) {
+            const Interaction::MatchStamp &stamp = channel.stamps[site];
+            if (stamp.stencil) channel.coverage->unstamp(*stamp.stencil, stamp.displ_x, stamp.displ_y, stamp.displ_z);
+        }
+        place(channel, context, sites);
+        movedMatches += sites.size();
+    }
+}
+
+size_t TrajectoryMesh::getMemoryUsage() const {
+    size_t bytes = molecule ? molecule->getMemoryUsage() : 0;
+    for (const Channel &channel: channels)
+        bytes += channel.coverage->getMemoryUsage();
+    return bytes;
+}
@@ -0,0 +1,387 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Backend.hpp"
+#include "ConeStencil.hpp"
+#include "DistanceTransform.hpp"
+#include "Morphology.hpp"
+#include "RingStencil.hpp"
+#include "SparseMesh.hpp"
+#include "StencilCache.hpp"
+
+/*
+ * Randomized equivalence checks of the kernels against their reference implementations: each check runs a fixed
+ * seeded set of cases and counts the voxels (or operations) where the kernel and the reference disagree
+ */
+
+/**
+ * This function counts the voxels two meshes of the same size disagree on
+ */
+static size_t countDiff(const MoleculeMesh &a, const MoleculeMesh &b) {
+    size_t diff = 0;
+    for (size_t i = 0; i < a.getDataSize(); ++i)
+        diff += __builtin_popcountll(a.getData()[i] ^ b.getData()[i]);
+    return diff;
+}
+
+/**
+ * This function counts the voxels a dense and a sparse mesh of the same size disagree on
+ */
+static size_t countDiff(const MoleculeMesh &a, const SparseMesh &b) {
+    size_t diff = 0;
+    for (int z = 0; z < a.dim_z; ++z)
+        for (int y = 0; y < a.dim_y; ++y)
+            for (int x = 0; x < a.dim_x; ++x)
+                diff += a.at(x, y, z) != b.at(x, y, z);
+    return diff;
+}
+
+/**
+ * This function returns the pattern of a stencil rasterized into a mesh of its window
+ */
+static MoleculeMesh rasterize(const SpanStencil &stencil) {
+    MoleculeMesh mesh(stencil.dim_x, stencil.dim_y, stencil.dim_z);
+    mesh.stamp(stencil, 0, 0, 0);
+    return mesh;
+}
+
+/**
+ * The reference single-angle pattern: the voxels of the sphere window whose angle p2p1-p2l1 (computed by acos) lies
+ * within the bounds
+ */
+static MoleculeMesh coneReference(const RDGeom::Point3D &center, const RDGeom::Point3D &p1, const RDGeom::Point3D &p2,
+                                  std::pair<double, double> angle, double distance, int grain) {
+    int C = static_cast<int>(ceil(distance * grain));
+    MoleculeMesh bubble(2 * C, 2 * C, 2 * C);
+    RDGeom::Point3D p2p1 = p2.directionVector(p1);
+    double ds = distance * grain * distance * grain;
+    for (int z = 0; z < 2 * C; ++z) {
+        for (int y = 0; y < 2 * C; ++y) {
+            for (int x = 0; x < 2 * C; ++x) {
+                int dx = x - C, dy = y - C, dz = z - C;
+                if (dx * dx + dy * dy + dz * dz > ds) continue;
+                RDGeom::Point3D l1(static_cast<double>(dx) / grain + center.x,
+                                   static_cast<double>(dy) / grain + center.y,
+                                   static_cast<double>(dz) / grain + center.z);
+                double theta = p2p1.angleTo(p2.directionVector(l1));
+                if (theta >= angle.first && theta <= angle.second) bubble.at(x, y, z) = true;
+            }
+        }
+    }
+    return bubble;
+}
+
+/**
+ * This function checks the cone patterns (see ConeStencil) against the per-voxel acos rule
+ */
+static size_t checkCone(std::mt19937 &rng) {
+    const std::pair<double, double> angles[] = {{M_PI * 130 / 180, M_PI}, {0, M_PI}, {0, M_PI / 3},
+                                                {M_PI / 6, M_PI * 2 / 3}, {M_PI / 2, M_PI}, {0, M_PI / 2},
+                                                {M_PI * 100 / 180, M_PI * 150 / 180}};
+    std::uniform_real_distribution<double> coordinate(-5, 5);
+    size_t diff = 0;
+    for (int t = 0; t < 300; ++t) {
+        int grain = 1 + t % 10;
+        std::pair<double, double> angle = angles[t % 7];
+        double distance = t % 3 == 0 ? 3.5 : (t % 3 == 1 ? 4.1 : 2.7);
+        RDGeom::Point3D p1(coordinate(rng), coordinate(rng), coordinate(rng));
+        RDGeom::Point3D p2(coordinate(rng), coordinate(rng), coordinate(rng));
+
+        // Degenerate frames: the voxel on p2 itself, p2 == p1 and axis-aligned p2 --> p1
+        if (t % 50 == 0) p2 = RDGeom::Point3D(1.0 / 3, 2.0 / 3, 1);
+        if (t % 10 == 3) p1 = p2 + RDGeom::Point3D(1, 0, 0);
+        if (t % 97 == 0) p1 = p2;
+        RDGeom::Point3D center = t % 2 ? p1 : p2;
+
+        ConeStencil cone(angle, distance, grain);
+        SpanStencil stencil(0, 0, 0);
+        cone.build(center, p1, p2, stencil);
+        diff += countDiff(rasterize(stencil), coneReference(center, p1, p2, angle, distance, grain));
+    }
+    return diff;
+}
+
+/**
+ * The reference ring pattern: every voxel of the sphere window tested one by one by the restrictions of RingStencil
+ * (the flat scan the cells are classified against)
+ */
+static MoleculeMesh ringReference(const RDGeom::Point3D &normal, double distance, std::pair<double, double> plane,
+                                  std::pair<double, double> cent, bool intersect, double r, int grain) {
+    auto fold = [](double angle) { return std::min(std::max(angle, 0.0), M_PI / 2); };
+    auto boundCos = [](double angle) { return fabs(cos(angle)) < 1e-12 ? 0 : cos(angle); };
+
+    double min_plane = fold(plane.first), max_plane = fold(plane.second);
+    double min_cent = fold(cent.first), max_cent = fold(cent.second);
+    double lower[2] = {min_cent, fold(std::max(min_plane - max_cent, min_cent - max_plane))};
+    double upper[2] = {max_cent, std::min(max_plane + max_cent, M_PI / 2)};
+    double band_lower[2], band_upper[2];
+    for (int i = 0; i < 2; ++i) {
+        band_lower[i] = upper[i] >= M_PI / 2 ? 0 : boundCos(upper[i]) * boundCos(upper[i]);
+        band_upper[i] = lower[i] <= 0 ? 2 : boundCos(lower[i]) * boundCos(lower[i]);
+        if (lower[i] > upper[i]) band_lower[i] = 3;
+    }
+    double cot_min_plane = min_plane > 0 ? boundCos(min_plane) / sin(min_plane) : 0;
+    double cot_max_plane = max_plane > 0 ? boundCos(max_plane) / sin(max_plane) : 0;
+    double max_h_sq = r * r * sin(max_plane) * sin(max_plane);
+
+    const SpanStencil &sphere = StencilCache::sphere(distance, grain);
+    const int C = static_cast<int>(ceil(distance * grain));
+    MoleculeMesh bubble(sphere.dim_x, sphere.dim_y, sphere.dim_z);
+    for (const SpanStencil::Span &span: sphere.spans) {
+        double uy = static_cast<double>(span.y - C) / grain, uz = static_cast<double>(span.z - C) / grain;
+        for (int x = span.x_begin; x < span.x_end; ++x) {
+            double ux = static_cast<double>(x - C) / grain;
+            double d = normal.x * ux + (normal.y * uy + normal.z * uz);
+            double uu = ux * ux + (uy * uy + uz * uz);
+            double d2 = d * d;
+            bool angleOk = (d2 >= band_lower[0] * uu && d2 <= band_upper[0] * uu) ||
+                           (d2 >= band_lower[1] * uu && d2 <= band_upper[1] * uu);
+
+            bool intersectOk = true;
+            if (intersect) {
+                double h = fabs(d), rho_sq = std::max(uu - d2, 0.0);
+                double near_max = r + h * cot_min_plane, far_min = h * cot_max_plane - r;
+                bool nearRing = (min_plane <= 0 || rho_sq <= near_max * near_max) &&
+                                (far_min <= 0 || rho_sq >= far_min * far_min);
+                double back = r - h * cot_max_plane;
+                nearRing = nearRing || (back >= 0 && rho_sq <= back * back);
+                intersectOk = nearRing || d2 <= max_h_sq;
+            }
+            if (uu > 0 && angleOk && intersectOk) bubble.at(x, span.y, span.z) = true;
+        }
+    }
+    return bubble;
+}
+
+/**
+ * This function checks the ring patterns (see RingStencil), whose cells are classified coarse to fine from grain 6,
+ * against the flat scan of their voxels
+ */
+static size_t checkRing(std::mt19937 &rng) {
+    const double bounds[][4] = {{0, M_PI / 6, 0, M_PI / 6}, {M_PI / 3, M_PI / 2, 0, M_PI / 6}, {0, 0.5, 0.3, 0.9},
+                                {0, M_PI / 2, 0, M_PI / 2}, {0.2, 0.2, 0, 0.1}, {M_PI / 2, M_PI / 2, 0, M_PI / 2},
+                                {0.8, 0.5, 0, 1}};
+    std::uniform_real_distribution<double> component(-1, 1);
+    size_t diff = 0;
+    for (int t = 0; t < 200; ++t) {
+        int grain = 1 + t % 10;
+        const double *b = bounds[t % 7];
+        bool intersect = t % 2;
+        double distance = t % 3 == 0 ? 4.0 : (t % 3 == 1 ? 5.5 : 6.5);
+        RDGeom::Point3D normal(component(rng), component(rng), component(rng));
+        if (t % 11 == 0) normal = RDGeom::Point3D(0, 0, 1);
+        if (t % 13 == 0) normal = RDGeom::Point3D(1, 1, 0);
+        normal /= normal.length();
+
+        RingStencil ring(distance, {b[0], b[1]}, {b[2], b[3]}, intersect, 1.5, grain);
+        SpanStencil stencil(0, 0, 0);
+        ring.build(normal, stencil);
+        diff += countDiff(rasterize(stencil), ringReference(normal, distance, {b[0], b[1]}, {b[2], b[3]},
+                                                            intersect, 1.5, grain));
+    }
+    return diff;
+}
+
+/**
+ * This function checks the operations of the sparse mesh (see SparseMesh) against the dense mesh
+ */
+static size_t checkSparse(std::mt19937 &rng) {
+    size_t diff = 0;
+    for (int t = 0; t < 30; ++t) {
+        int dx = 1 + static_cast<int>(rng() % 150), dy = 1 + static_cast<int>(rng() % 70);
+        int dz = 1 + static_cast<int>(rng() % 60);
+        MoleculeMesh a(dx, dy, dz), b(dx, dy, dz);
+        SparseMesh sparseA(dx, dy, dz, {0, 0, 0}, 0), sparseB(dx, dy, dz, {0, 0, 0}, 0);
+        for (int k = 0; k < 10; ++k) {
+            const SpanStencil &sphere = StencilCache::sphere(1 + static_cast<double>(rng() % 6), 3);
+            int px = static_cast<int>(rng() % dx) - 10, py = static_cast<int>(rng() % dy) - 10;
+            int pz = static_cast<int>(rng() % dz) - 10;
+            if (k % 2) {
+                a.stamp(sphere, px, py, pz);
+                sparseA.stamp(sphere, px, py, pz);
+            } else {
+                b.stamp(sphere, px, py, pz);
+                sparseB.stamp(sphere, px, py, pz);
+            }
+        }
+        diff += countDiff(a, sparseA) + countDiff(b, sparseB);
+
+        // Conversions
+        diff += countDiff(a, SparseMesh(a));
+        MoleculeMesh dense = sparseA.toDense();
+        diff += countDiff(dense, sparseA);
+        diff += dense.getVoxelCount() != sparseA.getVoxelCount();
+
+        // Addition, subtraction of a sparse and of a dense mask, pruning and iteration
+        MoleculeMesh sum = a;
+        sum.add(b, 0, 0, 0);
+        SparseMesh sparseSum(sparseA);
+        sparseSum.add(sparseB);
+        diff += countDiff(sum, sparseSum);
+
+        MoleculeMesh difference = sum;
+        difference.sub(b, 0, 0, 0);
+        SparseMesh sparseSparseDifference(sparseSum);
+        sparseSparseDifference.sub(sparseB);
+        diff += countDiff(difference, sparseSparseDifference);
+        SparseMesh sparseDifference(sparseSum);
+        sparseDifference.sub(b);
+        diff += countDiff(difference, sparseDifference);
+        sparseDifference.prune();
+        diff += countDiff(difference, sparseDifference);
+
+        size_t visited = 0;
+        sparseDifference.forEachVoxel([&](int x, int y, int z) {
+            diff += !difference.at(x, y, z);
+            visited++;
+        });
+        diff += visited != difference.getVoxelCount();
+
+        sparseDifference.clear();
+        diff += sparseDifference.getVoxelCount() != 0 || sparseDifference.getBrickCount() != 0;
+    }
+    return diff;
+}
+
+/**
+ * This function checks the thresholded distance transform (see DistanceTransform) against the spherical patterns
+ * stamped around the seeds, whole radii included
+ */
+static size_t checkTransform(std::mt19937 &rng) {
+    size_t diff = 0;
+    for (int t = 0; t < 200; ++t) {
+        int grain = 1 + t % 6;
+        double radius = static_cast<double>(rng() % 40 + 1) / 8;
+        int dx = 10 + static_cast<int>(rng() % 50), dy = 10 + static_cast<int>(rng() % 50);
+        int dz = 10 + static_cast<int>(rng() % 50);
+        int n = 1 + static_cast<int>(rng() % 80);
+
+        // Seeds scattered over (and around) the mesh, or clustered so that they share pole voxels
+        std::vector<int> seeds;
+        for (int i = 0; i < n; ++i) {
+            if (t % 4 == 0 && i > 0) {
+                for (int axis = 0; axis < 3; ++axis)
+                    seeds.push_back(seeds[axis] + static_cast<int>(rng() % 9) - 4);
+                continue;
+            }
+            seeds.push_back(static_cast<int>(rng() % (dx + 10)) - 5);
+            seeds.push_back(static_cast<int>(rng() % (dy + 10)) - 5);
+            seeds.push_back(static_cast<int>(rng() % (dz + 10)) - 5);
+        }
+
+        MoleculeMesh stamped(dx, dy, dz, {0, 0, 0}, 0, grain), transformed(dx, dy, dz, {0, 0, 0}, 0, grain);
+        int C = static_cast<int>(ceil(radius * grain));
+        const SpanStencil &sphere = StencilCache::sphere(radius, grain);
+        for (int i = 0; i < n; ++i)
+            stamped.stamp(sphere, seeds[3 * i] - C, seeds[3 * i + 1] - C, seeds[3 * i + 2] - C);
+        DistanceTransform::threshold(seeds.data(), n, radius * grain, transformed);
+        diff += countDiff(stamped, transformed);
+    }
+    return diff;
+}
+
+/**
+ * The reference morphological operation: every voxel tested against the voxels of the ball around it
+ */
+static MoleculeMesh morphologyReference(const MoleculeMesh &mesh, double scaledRadius, bool erode) {
+    MoleculeMesh result(mesh.dim_x, mesh.dim_y, mesh.dim_z, {0, 0, 0}, 0, 1);
+    const double ds = scaledRadius * scaledRadius;
+    const int reach = static_cast<int>(scaledRadius);
+    for (int z = 0; z < mesh.dim_z; ++z) {
+        for (int y = 0; y < mesh.dim_y; ++y) {
+            for (int x = 0; x < mesh.dim_x; ++x) {
+                // A dilation looks for a set voxel within the radius, an erosion for an empty one (out of the mesh too)
+                bool found = false;
+                for (int dz = -reach; dz <= reach && !found; ++dz) {
+                    for (int dy = -reach; dy <= reach && !found; ++dy) {
+                        for (int dx = -reach; dx <= reach && !found; ++dx) {
+                            if (dx * dx + dy * dy + dz * dz > ds) continue;
+                            int sx = x + dx, sy = y + dy, sz = z + dz;
+                            bool set = sx >= 0 && sy >= 0 && sz >= 0 && sx < mesh.dim_x && sy < mesh.dim_y &&
+                                       sz < mesh.dim_z && mesh.at(sx, sy, sz);
+                            found = erode ? !set : set;
+                        }
+                    }
+                }
+                if (erode != found) result.at(x, y, z) = true;
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * This function checks the dilation and the erosion (see Morphology), by widened rows and by distance transform,
+ * against the ball of every voxel
+ */
+static size_t checkMorphology(std::mt19937 &rng) {
+    size_t diff = 0;
+    for (int t = 0; t < 30; ++t) {
+        /*
+         * The short rows of every third mesh make the larger radii run the distance transform instead, their voxels
+         * are nearly all empty or all set so that the result is not the whole (or the empty) mesh
+         */
+        int dx = t % 3 ? 5 + static_cast<int>(rng() % 100) : 3 + static_cast<int>(rng() % 6);
+        int dy = 5 + static_cast<int>(rng() % 30), dz = 5 + static_cast<int>(rng() % 30);
+        MoleculeMesh mesh(dx, dy, dz, {0, 0, 0}, 0, 1);
+        double density = static_cast<double>(rng() % 100) / 100 * 0.3 + (t % 2 ? 0.6 : 0);
+        if (t % 3 == 0) density = t % 2 ? 0.99 : 0.01;
+        for (int z = 0; z < dz; ++z)
+            for (int y = 0; y < dy; ++y)
+                for (int x = 0; x < dx; ++x)
+                    if (static_cast<double>(rng() % 1000) / 1000 < density) mesh.at(x, y, z) = true;
+
+        double scaledRadius = 0.5 + static_cast<double>(rng() % 56) / 10;
+        for (bool erode: {false, true}) {
+            MoleculeMesh result = mesh;
+            if (erode) Morphology::erode(result, scaledRadius);
+            else Morphology::dilate(result, scaledRadius);
+            diff += countDiff(result, morphologyReference(mesh, scaledRadius, erode));
+        }
+    }
+    return diff;
+}
+
+/**
+ * A named check, and whether it runs on every available backend
+ */
+struct Check {
+    const char *name;
+    size_t (*run)(std::mt19937 &rng);
+    bool perBackend;
+};
+
+int main(int argc, char *argv[]) {
+    const Check checks[] = {{"cone",       checkCone,       false},
+                            {"ring",       checkRing,       false},
+                            {"sparse",     checkSparse,     false},
+                            {"transform",  checkTransform,  true},
+                            {"morphology", checkMorphology, true}};
+
+    std::string selected = argc > 1 ? argv[1] : "";
+    bool found = false, passed = true;
+    for (const Check &check: checks) {
+        if (!selected.empty() && selected != check.name) continue;
+        found = true;
+
+        std::vector<Backend::Type> backends = {Backend::SERIAL};
+        if (check.perBackend && Backend::isAvailable(Backend::OMP)) backends.push_back(Backend::OMP);
+        for (Backend::Type backend: backends) {
+            Backend::select(backend);
+            std::mt19937 rng(7);
+            size_t diff = check.run(rng);
+            std::cout << check.name << " (" << Backend::name(backend) << "): " << diff << " mismatches" << std::endl;
+            passed = passed && diff == 0;
+        }
+    }
+
+    if (!found) {
+        std::cout << "Usage: ProLIF_Coloring_tests [cone|ring|sparse|transform|morphology]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}